@@ -0,0 +1,201 @@
+/*
+ * bench-projection - measure gnomonic projection speed.
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <math.h>
+
+#include <opencv2/opencv.hpp>
+
+#include "../src/detectors/detector.hpp"
+#include "../src/detectors/progressive.hpp"
+#include "../src/detectors/reader.hpp"
+
+
+/*
+ * Program arguments.
+ *
+ */
+
+#define OPTION_WIDTH                0
+#define OPTION_SIZE                 1
+#define OPTION_ITERATIONS           2
+
+static int image_width = 4096;
+static int object_size = 200;
+static int iterations = 5;
+static const char *golden_file = NULL;
+
+
+static struct option options[] = {
+    {"width",                required_argument, 0,                  0 },
+    {"size",                 required_argument, 0,                  0 },
+    {"iterations",           required_argument, 0,                  0 },
+    {0, 0, 0, 0}
+};
+
+
+/**
+ * Display program usage.
+ *
+ */
+void usage() {
+    printf("yafdb-bench-blur [options] [golden-image.tiff]\n\n");
+
+    printf("Compare progressive blur on summed-area tables with the original per-pixel box loop,\n");
+    printf("on a golden image (or a synthetic one), for several object sizes.\n\n");
+
+    printf("--width 4096      : synthetic image width\n");
+    printf("--size 200        : largest object size in pixels\n");
+    printf("--iterations 5    : blurs per measure\n");
+}
+
+
+/**
+ * Program entry-point.
+ *
+ */
+int main(int argc, char **argv) {
+    // parse arguments
+    while (true) {
+        int index = -1;
+
+        getopt_long(argc, argv, "", options, &index);
+        if (index == -1) {
+            if (argc > optind + 1) {
+                usage();
+                return 1;
+            }
+            if (argc == optind + 1) {
+                golden_file = argv[optind++];
+            }
+            break;
+        }
+
+        switch (index) {
+        case OPTION_WIDTH:
+            image_width = atoi(optarg);
+            break;
+
+        case OPTION_SIZE:
+            object_size = atoi(optarg);
+            break;
+
+        case OPTION_ITERATIONS:
+            iterations = atoi(optarg);
+            break;
+
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    // golden or synthetic source (smooth gradients with noise)
+    cv::Mat source;
+
+    if (golden_file != NULL) {
+        source = ImageReader::read(golden_file, CV_LOAD_IMAGE_COLOR);
+        if (source.rows <= 0 || source.cols <= 0) {
+            fprintf(stderr, "Error: cannot read image in golden file: %s\n", golden_file);
+            return 2;
+        }
+    } else {
+        source.create(image_width / 2, image_width, CV_8UC3);
+        for (int y = 0; y < source.rows; y++) {
+            unsigned char *row = source.ptr<unsigned char>(y);
+
+            for (int x = 0; x < source.cols; x++) {
+                row[3 * x] = x * 223 / source.cols + rand() % 32;
+                row[3 * x + 1] = y * 223 / source.rows + rand() % 32;
+                row[3 * x + 2] = (x + y) % 224 + rand() % 32;
+            }
+        }
+    }
+
+    printf("source: %dx%d\n\n", source.cols, source.rows);
+    printf("  size   reference    integral   speedup   max diff   mean diff\n");
+
+    // blur objects of growing size at image center
+    for (int size = 25; size <= object_size; size *= 2) {
+        int x1 = source.cols / 2 - size / 2;
+        int y1 = source.rows / 2 - size / 2;
+        double times[2];
+        cv::Mat results[2];
+
+        if (2 * size + 2 > source.rows) {
+            break;
+        }
+        for (int mode = 0; mode < 2; mode++) {
+            int64 start = cv::getTickCount();
+
+            for (int j = 0; j < iterations; j++) {
+                results[mode] = source.clone();
+                if (mode == 0) {
+                    ProgressiveBlur::reference(results[mode], x1, y1, x1 + size, y1 + size);
+                } else {
+                    ProgressiveBlur::blur(results[mode], x1, y1, x1 + size, y1 + size);
+                }
+            }
+            times[mode] = (cv::getTickCount() - start) / cv::getTickFrequency() / iterations;
+        }
+
+        // differences within blurred square
+        cv::Rect square(x1 + size / 2 - size, y1 + size / 2 - size, 2 * size + 1, 2 * size + 1);
+        int maxDiff = 0;
+        double sumDiff = 0;
+
+        for (int y = square.y; y < square.y + square.height; y++) {
+            const unsigned char *a = results[0].ptr<unsigned char>(y) + 3 * square.x;
+            const unsigned char *b = results[1].ptr<unsigned char>(y) + 3 * square.x;
+
+            for (int x = 0; x < 3 * square.width; x++) {
+                int diff = abs(a[x] - b[x]);
+
+                maxDiff = MAX(maxDiff, diff);
+                sumDiff += diff;
+            }
+        }
+        printf("%6d   %6.2f ms   %6.2f ms   %6.2fx   %8d   %9.3f\n", size, times[0] * 1000.0, times[1] * 1000.0, times[0] / times[1], maxDiff, sumDiff / (3.0 * square.area()));
+    }
+    return 0;
+}
@@ -0,0 +1,223 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <math.h>
+
+#include <new>
+
+#include <opencv2/opencv.hpp>
+
+#include "../src/detectors/detector.hpp"
+
+
+/*
+ * Program arguments.
+ *
+ */
+
+#define OPTION_TILES                0
+#define OPTION_OBJECTS              1
+#define OPTION_CHILDREN             2
+
+static int tiles = 200;
+static int tile_objects = 50;
+static int children_count = 2;
+
+
+static struct option options[] = {
+    {"tiles",                required_argument, 0,                  0 },
+    {"objects",              required_argument, 0,                  0 },
+    {"children",             required_argument, 0,                  0 },
+    {0, 0, 0, 0}
+};
+
+
+/*
+ * Allocation counter.
+ *
+ */
+
+static long allocations = 0;
+
+void* operator new(size_t size) {
+    void *ptr = malloc(size > 0 ? size : 1);
+
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    allocations++;
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+
+/**
+ * Build objects detected in one tile (as the hierarchical detector would).
+ *
+ * \param tile tile index
+ * \param objects output list of detected objects
+ */
+static void tileObjects(int tile, std::list<DetectedObject> &objects) {
+    for (int i = 0; i < tile_objects; i++) {
+        double x = (tile * 7919 + i * 104729) % 2000;
+        double y = (tile * 104729 + i * 7919) % 1000;
+        DetectedObject object("frontal-face:profile-face", BoundingBox(BoundingBox::CARTESIAN, x, y, x + 24, y + 24), "No", "None", "None");
+        std::list<DetectedObject> children;
+
+        for (int j = 0; j < children_count; j++) {
+            children.push_back(DetectedObject("eye-left:eye-right", BoundingBox(BoundingBox::CARTESIAN, x + j, y, x + j + 6, y + 6), "No", "None", "None"));
+        }
+        object.addChildren(std::move(children));
+        objects.push_back(std::move(object));
+    }
+}
+
+
+/**
+ * Display program usage.
+ *
+ */
+void usage() {
+    printf("yafdb-bench-objects [options]\n\n");
+
+    printf("Count allocations of detected objects plumbing, copying objects between lists versus moving them.\n\n");
+
+    printf("--tiles 200    : number of simulated tiles\n");
+    printf("--objects 50   : objects detected per tile\n");
+    printf("--children 2   : children per object\n");
+}
+
+
+/**
+ * Program entry-point.
+ *
+ */
+int main(int argc, char **argv) {
+    // parse arguments
+    while (true) {
+        int index = -1;
+
+        getopt_long(argc, argv, "", options, &index);
+        if (index == -1) {
+            if (argc != optind) {
+                usage();
+                return 1;
+            }
+            break;
+        }
+
+        switch (index) {
+        case OPTION_TILES:
+            tiles = atoi(optarg);
+            break;
+
+        case OPTION_OBJECTS:
+            tile_objects = atoi(optarg);
+            break;
+
+        case OPTION_CHILDREN:
+            children_count = atoi(optarg);
+            break;
+
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    printf("%d tiles, %d objects per tile, %d children per object\n\n", tiles, tile_objects, children_count);
+    printf("step              copy allocs   move allocs\n");
+
+    // collect tile objects into the result list
+    std::list<DetectedObject> objects[2];
+    long counts[2];
+
+    for (int mode = 0; mode < 2; mode++) {
+        counts[mode] = 0;
+        for (int i = 0; i < tiles; i++) {
+            std::list<DetectedObject> window;
+
+            tileObjects(i, window);
+
+            long before = allocations;
+
+            if (mode == 0) {
+                std::for_each(window.begin(), window.end(), [&] (const DetectedObject &object) {
+                    objects[mode].push_back(object);
+                });
+            } else {
+                objects[mode].splice(objects[mode].end(), window);
+            }
+            counts[mode] += allocations - before;
+        }
+    }
+    printf("collect         %12ld  %12ld\n", counts[0], counts[1]);
+
+    // attach children to parent objects
+    for (int mode = 0; mode < 2; mode++) {
+        counts[mode] = 0;
+        for (auto it = objects[mode].begin(); it != objects[mode].end(); ++it) {
+            std::list<DetectedObject> children((*it).children);
+
+            long before = allocations;
+
+            if (mode == 0) {
+                (*it).addChildren(children);
+            } else {
+                (*it).addChildren(std::move(children));
+            }
+            counts[mode] += allocations - before;
+        }
+    }
+    printf("attach children %12ld  %12ld\n", counts[0], counts[1]);
+
+    // merge overlapping objects
+    long before = allocations;
+
+    ObjectDetector::merge(objects[1]);
+    printf("merge                        -  %12ld\n", allocations - before);
+    return 0;
+}
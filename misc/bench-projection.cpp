@@ -0,0 +1,177 @@
+/*
+ * bench-projection - measure gnomonic projection speed.
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <math.h>
+
+#include <opencv2/opencv.hpp>
+
+#include "../src/detectors/detector.hpp"
+#include "../src/detectors/sampler.hpp"
+
+
+/*
+ * Program arguments.
+ *
+ */
+
+#define OPTION_WIDTH                0
+#define OPTION_TILE_WIDTH           1
+#define OPTION_APERTURE             2
+#define OPTION_ITERATIONS           3
+#define OPTION_COLOR                4
+
+static int eqr_width = 16384;
+static int tile_width = 2048;
+static double aperture = 60;
+static int iterations = 5;
+static int color_enabled = 0;
+
+
+static struct option options[] = {
+    {"width",                required_argument, 0,                  0 },
+    {"tile-width",           required_argument, 0,                  0 },
+    {"aperture",             required_argument, 0,                  0 },
+    {"iterations",           required_argument, 0,                  0 },
+    {"color",                no_argument,       &color_enabled,     1 },
+    {0, 0, 0, 0}
+};
+
+
+/**
+ * Display program usage.
+ *
+ */
+void usage() {
+    printf("yafdb-bench-projection [options]\n\n");
+
+    printf("Measure gnomonic projection time of tiles at several latitudes, from row-major and cache-blocked sources.\n\n");
+
+    printf("--width 16384     : synthetic eqr image width\n");
+    printf("--tile-width 2048 : projection window width\n");
+    printf("--aperture 60     : projection aperture\n");
+    printf("--iterations 5    : projections per measure\n");
+    printf("--color           : use 3 channels image\n");
+}
+
+
+/**
+ * Program entry-point.
+ *
+ */
+int main(int argc, char **argv) {
+    // parse arguments
+    while (true) {
+        int index = -1;
+
+        getopt_long(argc, argv, "", options, &index);
+        if (index == -1) {
+            if (argc != optind) {
+                usage();
+                return 1;
+            }
+            break;
+        }
+
+        switch (index) {
+        case OPTION_WIDTH:
+            eqr_width = atoi(optarg);
+            break;
+
+        case OPTION_TILE_WIDTH:
+            tile_width = atoi(optarg);
+            break;
+
+        case OPTION_APERTURE:
+            aperture = atof(optarg);
+            break;
+
+        case OPTION_ITERATIONS:
+            iterations = atoi(optarg);
+            break;
+
+        case OPTION_COLOR:
+            break;
+
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    // synthetic source
+    cv::Mat source(eqr_width / 2, eqr_width, color_enabled ? CV_8UC3 : CV_8UC1);
+
+    cv::randu(source, cv::Scalar::all(0), cv::Scalar::all(255));
+
+    int64 start = cv::getTickCount();
+    EqrBlocks blocks(source);
+    double blockTime = (cv::getTickCount() - start) / cv::getTickFrequency();
+
+    printf("source: %dx%d, %d channel(s), blocked copy built in %.1f ms\n", source.cols, source.rows, source.channels(), blockTime * 1000.0);
+    printf("tile: %dx%d, %.0f degrees\n\n", tile_width, tile_width, aperture);
+    printf("latitude   row-major   blocked   speedup\n");
+
+    // project tiles from equator to pole
+    double latitudes[] = { 0, 30, 60, 75, 85, 90 };
+    cv::Mat window(tile_width, tile_width, source.type());
+
+    for (size_t i = 0; i < sizeof(latitudes) / sizeof(latitudes[0]); i++) {
+        GnomonicTransform transform(window.cols, window.rows, aperture / 180.0 * M_PI, aperture / 180.0 * M_PI, M_PI / 3, -latitudes[i] / 180.0 * M_PI);
+        double times[2];
+
+        transform.setInterpolation(GnomonicTransform::BILINEAR);
+        for (int mode = 0; mode < 2; mode++) {
+            start = cv::getTickCount();
+            for (int j = 0; j < iterations; j++) {
+                if (mode == 0) {
+                    transform.toGnomonic(source, window);
+                } else {
+                    transform.toGnomonic(blocks, window);
+                }
+            }
+            times[mode] = (cv::getTickCount() - start) / cv::getTickFrequency() / iterations;
+        }
+        printf("%8.0f   %6.2f ms   %6.2f ms   %5.2fx\n", latitudes[i], times[0] * 1000.0, times[1] * 1000.0, times[0] / times[1]);
+    }
+    return 0;
+}
@@ -47,6 +47,15 @@
 #include <math.h>
 
 #include "detectors/detector.hpp"
+#include "detectors/reader.hpp"
+#include "detectors/store.hpp"
+#include "detectors/progressive.hpp"
+#include "detectors/regions.hpp"
+#include "detectors/mask.hpp"
+#include "detectors/recursive.hpp"
+#include "detectors/downsampled.hpp"
+#include "detectors/spherical.hpp"
+#include "detectors/rewriter.hpp"
 
 
 /*
@@ -57,6 +66,7 @@
 #define ALGORITHM_NONE         0
 #define ALGORITHM_GAUSSIAN     1
 #define ALGORITHM_PROGRESSIVE  2
+#define ALGORITHM_DOWNSAMPLE   3
 
 
 /*
@@ -72,12 +82,26 @@
 #define OPTION_MAGNIFY_FACTOR         5
 #define OPTION_RESIZE_WIDTH           6
 #define OPTION_RESIZE_HEIGHT          7
+#define OPTION_PARALLEL_DISABLE       8
+#define OPTION_MASK_COMPOSITE         9
+#define OPTION_MASK_FEATHER           10
+#define OPTION_GAUSSIAN_RECURSIVE     11
+#define OPTION_DOWNSAMPLE_FACTOR      12
+#define OPTION_SPHERICAL_FOOTPRINT    13
+#define OPTION_STREAM_TIFF            14
 
 static int resize_width = 0;
 static int resize_height = 0;
 static int algorithm = ALGORITHM_GAUSSIAN;
 static int merge_min_overlap = 1;
 static int merge_enabled = 1;
+static int parallel_enabled = 1;
+static int mask_enabled = 0;
+static int mask_feather = 16;
+static int gaussian_recursive = 0;
+static int downsample_factor = 0;
+static int spherical_footprint = 0;
+static int stream_tiff = 0;
 static double gaussian_kernel_size = 65;
 static double gaussian_steps = 1;
 static double magnify_factor = 1.0;
@@ -95,148 +119,16 @@ static struct option options[] = {
     {"magnify-factor",      required_argument, 0,                  0 },
     {"resize-width",        required_argument, 0,                  0 },
     {"resize-height",       required_argument, 0,                  0 },
+    {"parallel-disable",    no_argument,       &parallel_enabled,  0 },
+    {"mask-composite",      no_argument,       &mask_enabled,      1 },
+    {"mask-feather",        required_argument, 0,                  0 },
+    {"gaussian-recursive",  no_argument,       &gaussian_recursive, 1 },
+    {"downsample-factor",   required_argument, 0,                  0 },
+    {"spherical-footprint", no_argument,       &spherical_footprint, 1 },
+    {"stream-tiff",         no_argument,       &stream_tiff,       1 },
     {0, 0, 0, 0}
 };
 
-//! Progressive rectangular blurring
-
-//! Apply a progresive blur on the desired rectangle.
-//!
-//! @param pbBitmap Bitmap array pointer to result image
-//! @param pbSource Bitmap array pointer to source image
-//! @param pbWidth Bitmap width, in pixels
-//! @param pbHeight Bitmap height, in pixels
-//! @param pbChannel Layer on which blur apply
-//! @param pbRx1 Rectangle upper left corner x coordinates
-//! @param pbRy1 Rectangle upper left corner y coordinates
-//! @param pbRx2 Rectangle lower right corner x coordinates
-//! @param pbRy2 Rectangle lower right corner y coordinates
-
-void progblur ( unsigned char * pbBitmap, int pbWidth, int pbHeight, int pbChannel, int pbRx1, int pbRy1, int pbRx2, int pbRy2 ) {
-
-    /* Parsing variables */
-    int pbX = 0;
-    int pbY = 0;
-    int pbI = 0;
-    int pbJ = 0;
-
-    /* Function parameters */
-    float pbU = 0.0;
-    float pbV = 0.0;
-
-    /* Area boudaries */
-    int pbAX1 = 0;
-    int pbAY1 = 0;
-    int pbAX2 = 0;
-    int pbAY2 = 0;
-
-    /* Compute rectangle size */
-    int pbrWidth  = ( pbRx2 - pbRx1 );
-    int pbrHeight = ( pbRy2 - pbRy1 );
-
-    /* Compute rectangle center */
-    float pbCX = ( float ) pbrWidth  / 2.0 + pbRx1;
-    float pbCY = ( float ) pbrHeight / 2.0 + pbRy1;
-
-    /* Compute automatic factor */
-    float pbFactor = pbrWidth < pbrHeight ? pbrWidth : pbrHeight;
-
-    /* Chromaitc accumulator */
-    float pbAccumR = 0.0;
-    float pbAccumG = 0.0;
-    float pbAccumB = 0.0;
-    int   pbForce  = 0;
-    int   pbCount  = 0;
-
-    /* Optimization for bitmap offset */
-    unsigned char * pbOffset = NULL;
-
-    /* Optimization for bitmap sub-offset */
-    int pbYOffset = 0;
-    int pbJOffset = 0;
-
-    /* Increase rectangle size */
-    pbRx1 = pbCX - pbFactor;
-    pbRx2 = pbCX + pbFactor;
-    pbRy1 = pbCY - pbFactor;
-    pbRy2 = pbCY + pbFactor;
-
-    /* Recompute adapted width and height */
-    pbrWidth  = ( pbRx2 - pbRx1 );
-    pbrHeight = ( pbRy2 - pbRy1 );
-
-    /* Optimization operation */
-    pbFactor *= 0.2;
-
-    /* Blurring y-component loop */
-    for ( pbY = pbRy1; pbY <= pbRy2; pbY ++ ) {
-
-        /* Compute optimization sub-offset */
-        pbYOffset = pbChannel * pbWidth * pbY;
-
-        /* Compute coordinates v-parameters */
-        pbV = ( ( float ) ( pbY - pbRy1 ) / pbrHeight ) * 2.0 - 1.0;
-
-        /* Blurring x-component loop */
-        for ( pbX = pbRx1; pbX <= pbRx2; pbX ++ ) {
-
-            /* Reset chromatic accumulator */
-            pbAccumR = 0.0;
-            pbAccumG = 0.0;
-            pbAccumB = 0.0;
-
-            /* Compute coordinates u-parameters */
-            pbU = ( ( float ) ( pbX - pbRx1 ) / pbrWidth  ) * 2.0 - 1.0;
-
-            /* Compute recursive condition value */
-            pbForce = int( exp( - pbU * pbU * 3.5 ) * exp( - pbV * pbV * 3.5 ) * pbFactor );
-
-            pbForce = ( pbForce > 32 ) ? 32 : pbForce;
-
-            /* Create area boundaries */
-            pbAX1 = pbX - pbForce; pbAX1 = ( pbAX1 <         0 ) ?            0 : pbAX1;
-            pbAX2 = pbX + pbForce; pbAX2 = ( pbAX2 >=  pbWidth ) ? pbWidth  - 1 : pbAX2;
-            pbAY1 = pbY - pbForce; pbAY1 = ( pbAY1 <         0 ) ?            0 : pbAY1;
-            pbAY2 = pbY + pbForce; pbAY2 = ( pbAY2 >= pbHeight ) ? pbHeight - 1 : pbAY2;
-
-            /* Accumulates y-components */
-            for ( pbJ = pbAY1; pbJ <= pbAY2; pbJ ++ ) {
-
-                /* Compute optimization sub-offset */
-                pbJOffset = pbChannel * pbWidth * pbJ;
-
-                /* Accumulates x-components */
-                for ( pbI = pbAX1; pbI <= pbAX2; pbI ++ ) {
-
-                    /* Compute optimiztion offset */
-                    pbOffset = pbBitmap + pbJOffset + pbChannel * pbI;
-
-                    /* Accumulate chromatic value */
-                    pbAccumR += * ( pbOffset ++ );
-                    pbAccumG += * ( pbOffset ++ );
-                    pbAccumB += * ( pbOffset    );
-
-                }
-
-            }
-
-            /* Compute number of considered pixels */
-            pbCount = ( pbAX2 - pbAX1 + 1 ) * ( pbAY2 - pbAY1 + 1 );
-
-            /* Compute optimization offset */
-            pbOffset = pbBitmap + pbYOffset + pbChannel * pbX;
-
-            /* Assign mean value */
-            * ( pbOffset ++ ) = pbAccumR / pbCount;
-            * ( pbOffset ++ ) = pbAccumG / pbCount;
-            * ( pbOffset    ) = pbAccumB / pbCount;
-
-        }
-
-    }
-
-}
-
 //! Rectangle magnifier
 
 //! Magnify specified rectangle by a multiplier
@@ -290,14 +182,24 @@ void usage() {
     printf("Blurs detected objects and write modified image as output.\n\n");
 
     printf("General options:\n\n");
-    printf("--algorithm algo : algorithm to use for blurring ('gaussian', 'progressive')\n");
+    printf("--algorithm algo : algorithm to use for blurring ('gaussian', 'progressive', 'downsample')\n");
     printf("--merge-disable : don't merge overlapping rectangles\n");
     printf("--merge-min-overlap 1 : minimum occurrence of overlap to keep detected objects\n");
+    printf("--parallel-disable : blur objects one after the other on a single thread\n");
+    printf("--spherical-footprint : blur spherical objects in a gnomonic patch around their footprint\n");
+    printf("--stream-tiff : rewrite only the tiff strips touched by objects\n");
     printf("\n");
 
     printf("Gaussian options:\n\n");
     printf("--gaussian-kernel 65 : gaussian kernel size\n");
     printf("--gaussian-steps 1 : gaussian blurring steps\n");
+    printf("--gaussian-recursive : recursive gaussian whose cost does not depend on kernel size\n");
+    printf("--mask-composite : blur all objects at once through a feathered mask\n");
+    printf("--mask-feather 16 : width of the mask fading border\n");
+    printf("\n");
+
+    printf("Downsample options:\n\n");
+    printf("--downsample-factor 0 : downsampling factor (0 for automatic)\n");
     printf("\n");
 
     printf("Progressive options:\n\n");
@@ -355,6 +257,8 @@ int main(int argc, char **argv) {
                 algorithm = ALGORITHM_GAUSSIAN;
             } else if (strcmp(optarg, "progressive") == 0) {
                 algorithm = ALGORITHM_PROGRESSIVE;
+            } else if (strcmp(optarg, "downsample") == 0) {
+                algorithm = ALGORITHM_DOWNSAMPLE;
             } else {
                 fprintf(stderr, "Error: unsupported algorithm: %s\n", optarg);
             }
@@ -380,6 +284,22 @@ int main(int argc, char **argv) {
         case OPTION_RESIZE_HEIGHT:
             resize_height = atoi(optarg);
             break;
+        case OPTION_PARALLEL_DISABLE:
+            break;
+        case OPTION_MASK_COMPOSITE:
+            break;
+        case OPTION_MASK_FEATHER:
+            mask_feather = atoi(optarg);
+            break;
+        case OPTION_GAUSSIAN_RECURSIVE:
+            break;
+        case OPTION_DOWNSAMPLE_FACTOR:
+            downsample_factor = atoi(optarg);
+            break;
+        case OPTION_SPHERICAL_FOOTPRINT:
+            break;
+        case OPTION_STREAM_TIFF:
+            break;
 
         default:
             usage();
@@ -387,134 +307,493 @@ int main(int argc, char **argv) {
         }
     }
 
-    // read source file
-    cv::Mat source = cv::imread(source_file);
-
-    if (source.rows <= 0 || source.cols <= 0) {
-        fprintf(stderr, "Error: cannot read image in source file: %s\n", source_file);
-        return 2;
-    }
-
     // read detected objects
-    std::list<DetectedObject> objects;
+    DetectionStore objects;
 
-    if (!ObjectDetector::load(objects_file, objects)) {
+    if (!objects.load(objects_file)) {
         fprintf(stderr, "Error: cannot read objects in file: %s\n", objects_file);
         return 2;
     }
 
     // merge detected objects
     if (merge_enabled) {
-        ObjectDetector::merge(objects, merge_min_overlap);
+        objects.merge(merge_min_overlap);
     }
 
-    // apply blur operation
-    for (int i = 0; i < gaussian_steps; ++i)
-    {
-        std::for_each(objects.begin(), objects.end(), [&] (const DetectedObject &object) {
-            if(object.falsePositive != "Yes")
-            {
-                auto rects = object.area.rects(source.cols, source.rows);
-
-                std::for_each(rects.begin(), rects.end(), [&] (const cv::Rect &rect) {
-                    cv::Mat region(source, rect);
-
-                    switch (algorithm) {
-                    case ALGORITHM_NONE:
-                        break;
-
-                    case ALGORITHM_GAUSSIAN:
-                    {
-                        GaussianBlur(
-                            region,
-                            region,
-                            cv::Size(gaussian_kernel_size, gaussian_kernel_size),
-                            0,
-                            0
-                        );
-                    }
+    // false positives are left untouched
+    objects.filter([&] (unsigned int entry) {
+        return !objects.isFalsePositive(entry);
+    });
+
+    // tiff strips are streamed when the output keeps the source layout
+    TiffRewriter rewriter;
+    bool streamed = false;
+
+    if (stream_tiff) {
+        streamed = !(resize_width > 0 && resize_height > 0) && !spherical_footprint && rewriter.open(source_file, target_file);
+        if (!streamed) {
+            fprintf(stderr, "Warning: cannot stream tiff strips, blurring whole image: %s\n", source_file);
+        }
+    }
+
+    // read source file (tiff files are decoded later, straight into the
+    // wrap-padded buffer)
+    cv::Mat source;
+    cv::Size size;
+    int type = 0;
+    bool direct = !streamed && ImageReader::header(source_file, size, type);
+
+    if (!streamed && !direct) {
+        source = ImageReader::read(source_file);
+        if (source.rows <= 0 || source.cols <= 0) {
+            fprintf(stderr, "Error: cannot read image in source file: %s\n", source_file);
+            return 2;
+        }
+        size = source.size();
+        type = source.type();
+    }
+
+    // a reduced output is blurred at output resolution: objects are scaled
+    // from eqr size (width x height) to the resized image, as are the
+    // blur parameters
+    int width = streamed ? rewriter.cols() : size.width;
+    int height = streamed ? rewriter.rows() : size.height;
+    double scale_x = 1.0;
+    double scale_y = 1.0;
+    bool resize_first = !streamed && resize_width > 0 && resize_height > 0 && (long)resize_width * resize_height < (long)width * height;
+
+    if (resize_first) {
+        double scale;
+
+        scale_x = (double)resize_width / width;
+        scale_y = (double)resize_height / height;
+        scale = sqrt(scale_x * scale_y);
+        gaussian_kernel_size = RecursiveGaussian::ksizeFor(RecursiveGaussian::sigmaFor((int)gaussian_kernel_size) * scale);
+        mask_feather = (int)(mask_feather * scale + 0.5);
+    }
+
+    int columns = resize_first ? resize_width : width;
+
+    // streamed bands hold rows [band_offset, band_offset + band rows)
+    int band_offset = 0;
+
+    auto scaled = [&] (const cv::Rect &rect) {
+        int x1 = (int)floor(rect.x * scale_x);
+        int y1 = (int)floor(rect.y * scale_y);
+        int x2 = (int)ceil((rect.x + rect.width) * scale_x);
+        int y2 = (int)ceil((rect.y + rect.height) * scale_y);
+
+        return cv::Rect(x1, y1 - band_offset, x2 - x1, y2 - y1);
+    };
+
+    // mask compositing blurs each masked region once with all steps
+    // (downsampled blur always blends regions through the mask)
+    bool downsample = algorithm == ALGORITHM_DOWNSAMPLE;
+    bool masked = (mask_enabled && algorithm == ALGORITHM_GAUSSIAN) || downsample;
+    bool recursive = gaussian_recursive && algorithm == ALGORITHM_GAUSSIAN;
+    int mask_steps = MAX((int)ceil(gaussian_steps), 1);
+
+    // successive gaussian blurs add up their variances: recursive and
+    // downsampled blurs run all steps at once with the equivalent sigma
+    double folded_sigma = RecursiveGaussian::sigmaFor((int)gaussian_kernel_size) * sqrt((double)mask_steps);
+    int recursive_halo = RecursiveGaussian::halo(folded_sigma);
+    int factor = downsample_factor > 0 ? downsample_factor : DownsampledBlur::factorFor(folded_sigma);
+    int mask_halo = mask_steps * ((int)gaussian_kernel_size / 2);
+
+    if (recursive) {
+        mask_halo = recursive_halo;
+    } else if (downsample) {
+        mask_halo = DownsampledBlur::halo(folded_sigma, factor);
+    }
+
+    // duplicate enough columns past the seam to blur seam-crossing objects
+    // in a single pass
+    int margin = 0;
+
+    for (unsigned int i = 0; i < objects.size(); i++) {
+        cv::Rect area;
+
+        if (objects.area(objects.root(i)).wrappedRect(width, height, area) && (area = scaled(area)).x + area.width > columns) {
+            int border = algorithm == ALGORITHM_PROGRESSIVE ? (int)ceil(MAX(area.width, area.height) * magnify_factor) + 33 : (int)gaussian_kernel_size;
+
+            if (recursive) {
+                border = 2 * recursive_halo;
+            }
+
+            if (masked) {
+                border = mask_feather + 2 * mask_halo;
+            }
+
+            margin = MAX(margin, WrappedEqr::marginFor(area, columns, border));
+        }
+    }
+
+    // rows written around objects (mask feather, progressive square) and
+    // rows read around written ones (feathered mask included)
+    int spread = masked ? mask_feather : 0;
+    int halo = algorithm == ALGORITHM_PROGRESSIVE ? ProgressiveBlur::MAX_FORCE + 1 : mask_halo + spread;
+
+    auto spreadFor = [&] (const cv::Rect &rect) {
+        return algorithm == ALGORITHM_PROGRESSIVE ? (int)ceil(MAX(rect.width, rect.height) * magnify_factor) + 1 : spread;
+    };
+
+    // blur objects in image (whole eqr or band of rows) and return result
+    auto blurImage = [&] (WrappedEqr &wrapped) -> cv::Mat {
+        const cv::Mat &source = wrapped.image();
+        const cv::Mat &padded = wrapped.padded();
+
+        // blur regions run at once (serial mode) or are queued by levels of
+        // non-overlapping regions (parallel mode)
+        RegionFilters regions(padded, source.cols, margin);
+
+        // gnomonic patch of the spherical footprint being blurred (if any) and
+        // patch area written
+        cv::Mat patch;
+        cv::Rect patch_output;
+
+        auto apply = [&] (const cv::Rect &output, int halo, const RegionFilters::Filter &filter) {
+            if (!patch.empty()) {
+                cv::Rect target(output & cv::Rect(0, 0, patch.cols, patch.rows));
+
+                if (target.width > 0 && target.height > 0) {
+                    filter(patch, cv::Point(0, 0), target);
+                    patch_output = patch_output.area() > 0 ? (patch_output | target) : target;
+                }
+            } else if (parallel_enabled) {
+                regions.add(output, halo, filter);
+            } else {
+                cv::Mat image(padded);
+                cv::Rect target(output & cv::Rect(0, 0, padded.cols, padded.rows));
+
+                if (target.width > 0 && target.height > 0) {
+                    filter(image, cv::Point(0, 0), target);
+                    wrapped.written(target);
+                }
+            }
+        };
+
+        // blur rectangle given in padded buffer coordinates
+        auto blur = [&] (const cv::Rect &rect) {
+            switch (algorithm) {
+            case ALGORITHM_NONE:
+                break;
+
+            case ALGORITHM_GAUSSIAN:
+                if (recursive) {
+                    apply(rect, recursive_halo, [=] (cv::Mat &image, const cv::Point &, const cv::Rect &target) {
+                        RecursiveGaussian::blur(image, target, folded_sigma);
+                    });
                     break;
+                }
+                apply(rect, (int)gaussian_kernel_size / 2, [&] (cv::Mat &image, const cv::Point &, const cv::Rect &target) {
+                    cv::Mat region(image, target);
+
+                    GaussianBlur(
+                        region,
+                        region,
+                        cv::Size(gaussian_kernel_size, gaussian_kernel_size),
+                        0,
+                        0
+                    );
+                });
+                break;
+
+            case ALGORITHM_PROGRESSIVE:
+            {
+                float x1 = rect.x;
+                float y1 = rect.y;
+                float x2 = rect.x + rect.width;
+                float y2 = rect.y + rect.height;
+
+                // Check presence of magnify parameter
+                if(magnify_factor != 1.0)
+                {
+                    // Magnify rectangle
+                    magnifyRect(
+                        magnify_factor,
+                        rect.x,
+                        rect.y,
+                        rect.width,
+                        rect.height,
+                        &x1,
+                        &y1,
+                        &x2,
+                        &y2
+                    );
+                }
+
+                // progressive blur covers a square around the rectangle center
+                int extent = (int)ceil(MIN(x2 - x1, y2 - y1)) + 1;
+                int cx = (x1 + x2) / 2;
+                int cy = (y1 + y2) / 2;
+                int bx1 = x1, by1 = y1, bx2 = x2, by2 = y2;
+
+                // Apply progressive blur
+                apply(cv::Rect(cx - extent, cy - extent, 2 * extent + 1, 2 * extent + 1), ProgressiveBlur::MAX_FORCE, [=] (cv::Mat &image, const cv::Point &origin, const cv::Rect &target) {
+                    ProgressiveBlur::blur(
+                        image,
+                        bx1 - origin.x,
+                        by1 - origin.y,
+                        bx2 - origin.x,
+                        by2 - origin.y,
+                        target.y,
+                        target.y + target.height
+                    );
+                });
+            }
+            break;
+
+            case ALGORITHM_DOWNSAMPLE:
+                // regions are blurred through the mask, except footprints
+                apply(rect, mask_halo, [=] (cv::Mat &image, const cv::Point &origin, const cv::Rect &target) {
+                    DownsampledBlur::blur(image, origin + cv::Point(0, band_offset), target, folded_sigma, factor);
+                });
+                break;
+
+            default:
+                fprintf(stderr, "Error: unsupported blur algorithm!\n");
+                break;
+            }
+        };
+
+        // enumerate rectangles to blur in padded buffer coordinates
+        // spherical objects blurred through their footprint are left out
+        std::vector<SphericalFootprint> footprints;
+        std::vector<bool> exact(objects.size(), false);
+
+        if (spherical_footprint && algorithm != ALGORITHM_NONE) {
+            double growth = algorithm == ALGORITHM_PROGRESSIVE ? 1.5 * magnify_factor : 1.0;
+            int footprint_halo = algorithm == ALGORITHM_PROGRESSIVE ? ProgressiveBlur::MAX_FORCE + 2 : mask_halo;
+            double footprint_magnify = algorithm == ALGORITHM_PROGRESSIVE ? magnify_factor : 1.0;
+
+            for (unsigned int j = 0; j < objects.size(); j++) {
+                SphericalFootprint footprint(objects.area(objects.root(j)), source.cols, source.rows, growth, footprint_halo, footprint_magnify);
+
+                if (footprint.isAvailable()) {
+                    footprints.push_back(footprint);
+                    exact[j] = true;
+                }
+            }
+        }
+
+        auto objectRects = [&] (const std::function<void(const cv::Rect &)> &callback) {
+            // rectangles of a band only affect its rows
+            auto visible = [&] (const cv::Rect &rect) {
+                int reach = spreadFor(rect) + halo;
+
+                if (rect.y + rect.height + reach > 0 && rect.y - reach < source.rows) {
+                    callback(rect);
+                }
+            };
 
-                    case ALGORITHM_PROGRESSIVE:
-                    {
-
-                        // Check presence of magnify parameter
-                        if(magnify_factor != 1.0)
-                        {
-                            // Magnifier variables
-                            float magnified_x  = 0.0;
-                            float magnified_y  = 0.0;
-                            float magnified_xw = 0.0;
-                            float magnified_yh = 0.0;
-
-                            // Magnify rectangle
-                            magnifyRect(
-                                magnify_factor,
-                                rect.x,
-                                rect.y,
-                                rect.width,
-                                rect.height,
-                                &magnified_x,
-                                &magnified_y,
-                                &magnified_xw,
-                                &magnified_yh
-                            );
-
-                            // Apply progressive blur
-                            progblur (
-                                source.data,
-                                source.cols,
-                                source.rows,
-                                source.channels(),
-                                magnified_x,
-                                magnified_y,
-                                magnified_xw,
-                                magnified_yh
-                            );
-                        } else {
-
-                            // Apply progressive blur
-                            progblur (
-                                source.data,
-                                source.cols,
-                                source.rows,
-                                source.channels(),
-                                rect.x,
-                                rect.y,
-                                rect.x + rect.width,
-                                rect.y + rect.height
-                            );
+            for (unsigned int j = 0; j < objects.size(); j++) {
+                BoundingBox object(objects.area(objects.root(j)));
+                cv::Rect area;
+
+                if (exact[j]) {
+                    continue;
+                }
+
+                if (object.wrappedRect(width, height, area) && wrapped.contains(scaled(area))) {
+                    visible(scaled(area));
+                } else {
+                    auto rects = object.rects(width, height);
+
+                    for (auto rect = rects.begin(); rect != rects.end(); ++rect) {
+                        visible(scaled(*rect));
+                    }
+                }
+            }
+        };
+
+        // apply blur operation
+        if (masked) {
+            BlurMask mask(mask_feather);
+            int kernel = (int)gaussian_kernel_size;
+
+            objectRects([&] (const cv::Rect &rect) {
+                mask.add(rect);
+            });
+            mask.build(padded.size(), mask_halo);
+
+            for (auto region = mask.getRegions().begin(); region != mask.getRegions().end(); ++region) {
+                BlurMask::Region current(*region);
+
+                // each step reads pixels blurred by the previous one: blur
+                // enough rows and columns around target for its own pixels to
+                // match a blur of the whole region
+                apply(current.area, mask_halo, [=] (cv::Mat &image, const cv::Point &origin, const cv::Rect &target) {
+                    int grow = (mask_steps - 1) * (kernel / 2);
+                    cv::Rect bounds(0, 0, image.cols, image.rows);
+                    cv::Rect input(cv::Rect(target.x - mask_halo, target.y - mask_halo, target.width + 2 * mask_halo, target.height + 2 * mask_halo) & bounds);
+                    cv::Rect steps(cv::Rect(target.x - grow, target.y - grow, target.width + 2 * grow, target.height + 2 * grow) & bounds);
+                    cv::Mat copy(cv::Mat(image, input).clone());
+                    cv::Mat blurred(copy, cv::Rect(steps.x - input.x, steps.y - input.y, steps.width, steps.height));
+
+                    if (recursive) {
+                        RecursiveGaussian::blur(copy, cv::Rect(target.x - input.x, target.y - input.y, target.width, target.height), folded_sigma);
+                    } else if (downsample) {
+                        DownsampledBlur::blur(copy, origin + input.tl() + cv::Point(0, band_offset), cv::Rect(target.x - input.x, target.y - input.y, target.width, target.height), folded_sigma, factor);
+                    } else {
+                        for (int i = 0; i < mask_steps; i++) {
+                            GaussianBlur(blurred, blurred, cv::Size(kernel, kernel), 0, 0);
                         }
                     }
-                    break;
 
-                    default:
-                        fprintf(stderr, "Error: unsupported blur algorithm!\n");
-                        break;
-                    }
+                    cv::Mat output(image, target);
+
+                    BlurMask::composite(
+                        output,
+                        cv::Mat(copy, cv::Rect(target.x - input.x, target.y - input.y, target.width, target.height)),
+                        cv::Mat(current.alpha, cv::Rect(origin.x + target.x - current.area.x, origin.y + target.y - current.area.y, target.width, target.height))
+                    );
                 });
             }
+        } else {
+            for (int i = 0; i < (recursive ? 1 : gaussian_steps); ++i)
+            {
+                objectRects(blur);
+            }
+        }
+        regions.run([&] (const cv::Rect &output) {
+            wrapped.written(output);
         });
+
+        // blur footprints in their patch and write back covered eqr pixels
+        for (auto footprint = footprints.begin(); footprint != footprints.end(); ++footprint) {
+            cv::Mat eqr(wrapped.image());
+            cv::Rect rows;
+
+            footprint->project(eqr, patch);
+            patch_output = cv::Rect(0, 0, 0, 0);
+            for (int i = 0; i < (recursive || downsample ? 1 : gaussian_steps); ++i) {
+                blur(footprint->getRect());
+            }
+            footprint->writeBack(patch, patch_output, eqr, rows);
+            wrapped.written(rows);
+            patch.release();
+        }
+        return wrapped.image();
+    };
+
+    if (streamed) {
+        // strips touched by objects (and the rows they write around them)
+        int chunkRows = rewriter.chunkHeight();
+        std::vector<bool> dirty(rewriter.chunkCount(), false);
+
+        for (unsigned int j = 0; j < objects.size(); j++) {
+            auto rects = objects.area(objects.root(j)).rects(width, height);
+
+            for (auto rect = rects.begin(); rect != rects.end(); ++rect) {
+                int first = MAX(rect->y - spreadFor(*rect), 0);
+                int last = MIN(rect->y + rect->height + spreadFor(*rect), height);
+
+                for (int index = first / chunkRows; index * chunkRows < last; index++) {
+                    dirty[index] = true;
+                }
+            }
+        }
+
+        // untouched strips are copied as they are, runs of touched strips
+        // (a few at a time) are decoded with the rows read around them,
+        // blurred and encoded again
+        int run = MAX(1024 / chunkRows, 1);
+        bool success = true;
+
+        for (int index = 0; index < rewriter.chunkCount() && success; ) {
+            if (!dirty[index]) {
+                success = rewriter.copy(index++);
+                continue;
+            }
+
+            int end = index;
+
+            while (end < rewriter.chunkCount() && end - index < run && dirty[end]) {
+                end++;
+            }
+
+            int first = index * chunkRows;
+            int last = MIN(end * chunkRows, height);
+
+            band_offset = MAX(first - halo, 0);
+
+            // rows are decoded straight into the wrap-padded band
+            WrappedEqr wrapped(MIN(last + halo, height) - band_offset, width, rewriter.type(), margin);
+            cv::Mat band(wrapped.image());
+
+            success = rewriter.read(band_offset, MIN(last + halo, height), band);
+            if (!success) {
+                break;
+            }
+            wrapped.wrap();
+
+            // alpha samples are kept as they are (the band may be blurred
+            // in place)
+            cv::Mat alpha;
+
+            if (band.channels() == 4) {
+                cv::extractChannel(band, alpha, 3);
+            }
+
+            cv::Mat blurred(blurImage(wrapped));
+
+            if (!alpha.empty()) {
+                cv::insertChannel(alpha, blurred, 3);
+            }
+            for (; index < end && success; index++) {
+                int row = index * chunkRows - band_offset;
+
+                success = rewriter.write(index, blurred.rowRange(row, MIN(row + chunkRows, height - band_offset)));
+            }
+        }
+        if (!rewriter.close() || !success) {
+            fprintf(stderr, "Error: cannot stream tiff strips to target file: %s\n", target_file);
+            return 2;
+        }
+        return 0;
+    }
+
+    // the image is held once: tiff files are decoded (and other images
+    // resized) straight into the wrap-padded buffer, other images are
+    // copied only if a margin is needed
+    WrappedEqr wrapped = direct || resize_first ?
+        WrappedEqr(resize_first ? resize_height : height, columns, type, margin) :
+        WrappedEqr(source, margin);
+    cv::Mat image(wrapped.image());
+
+    if (resize_first) {
+        if (direct && !ImageReader::read(source_file, source)) {
+            fprintf(stderr, "Error: cannot read image in source file: %s\n", source_file);
+            return 2;
+        }
+        cv::resize(source, image, image.size(), 0, 0, cv::INTER_AREA);
+    } else if (direct && !ImageReader::read(source_file, image)) {
+        fprintf(stderr, "Error: cannot read image in source file: %s\n", source_file);
+        return 2;
     }
+    source.release();
+    wrapped.wrap();
+
+    cv::Mat blurred(blurImage(wrapped));
 
     // Configure the quality level for jpeg images
     std::vector<int> compression_params;
     compression_params.push_back(CV_IMWRITE_JPEG_QUALITY);
     compression_params.push_back(100);
 
-    // Resize the image if specified
-    if(resize_width > 0 && resize_height > 0)
+    // Resize the image if specified (and not done before blurring)
+    if(resize_width > 0 && resize_height > 0 && !resize_first)
     {
         // Create the resized image
         cv::Size size(resize_width, resize_height);
         cv::Mat resized_image;
-        cv::resize(source, resized_image, size);
+        cv::resize(blurred, resized_image, size);
 
         // save target file
         cv::imwrite(target_file, resized_image, compression_params);
     } else {
         // save target file
-        cv::imwrite(target_file, source, compression_params);
+        cv::imwrite(target_file, blurred, compression_params);
     }
 
     return 0;
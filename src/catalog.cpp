@@ -0,0 +1,307 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <iostream>
+#include <map>
+
+#include "detectors/detector.hpp"
+#include "detectors/catalog.hpp"
+#include "detectors/binary.hpp"
+
+
+/*
+ * List of supported commands.
+ *
+ */
+
+#define COMMAND_NONE      0
+#define COMMAND_INGEST    1
+#define COMMAND_COUNT     2
+#define COMMAND_IMAGES    3
+#define COMMAND_EXPORT    4
+
+
+/*
+ * Program arguments.
+ *
+ */
+
+#define OPTION_CLASS                  0
+#define OPTION_AUTO_STATUS            1
+#define OPTION_MANUAL_STATUS          2
+#define OPTION_FALSE_POSITIVE         3
+#define OPTION_INVALID                4
+#define OPTION_IMAGE                  5
+
+
+static int command = COMMAND_NONE;
+static DetectionCatalog::Query query;
+static const char *catalog_file = NULL;
+static std::vector<std::string> input_files;
+
+
+static struct option options[] = {
+    {"class",                required_argument, 0,                  0 },
+    {"auto-status",          required_argument, 0,                  0 },
+    {"manual-status",        required_argument, 0,                  0 },
+    {"false-positive",       required_argument, 0,                  0 },
+    {"invalid",              required_argument, 0,                  0 },
+    {"image",                required_argument, 0,                  0 },
+    {0, 0, 0, 0}
+};
+
+
+/**
+ * Display program usage.
+ *
+ */
+void usage() {
+    printf("yafdb-catalog catalog.ycat ingest input-objects.yaml|directory|- ...\n");
+    printf("yafdb-catalog [options] catalog.ycat count|images|export\n\n");
+
+    printf("Campaign-wide catalog of detected objects in a single append-only file.\n\n");
+
+    printf("Commands:\n\n");
+    printf("ingest : add new or changed detected objects files (yaml or binary; directories\n");
+    printf("         add their *.yaml, *.yml and *.ydb files, '-' reads filenames from stdin)\n");
+    printf("count  : print number of matching objects\n");
+    printf("images : print number of matching objects, objects file and source image per image\n");
+    printf("export : print matching objects as tab-separated values\n");
+    printf("\n");
+
+    printf("Query options:\n\n");
+    printf("--class name          : class name of objects\n");
+    printf("--auto-status status  : automatic detection status ('valid', 'filtered-ratio', ...)\n");
+    printf("--manual-status status: manual validation status ('None', ...)\n");
+    printf("--false-positive No   : false positive status ('No' or 'Yes')\n");
+    printf("--invalid 0           : 0 = objects list only, 1 = invalid objects list only\n");
+    printf("--image text          : objects file or source image name contains text\n");
+    printf("\n");
+}
+
+
+/**
+ * Add objects file or detected objects files of a directory.
+ *
+ * \param path file or directory path
+ */
+static void addInput(const std::string &path) {
+    struct stat st;
+
+    if (stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        input_files.push_back(path);
+        return;
+    }
+
+    DIR *dir = opendir(path.c_str());
+
+    if (!dir) {
+        fprintf(stderr, "Warning: cannot read directory: %s\n", path.c_str());
+        return;
+    }
+
+    std::vector<std::string> names;
+
+    for (struct dirent *entry = readdir(dir); entry; entry = readdir(dir)) {
+        std::string name(entry->d_name);
+        size_t dot = name.rfind('.');
+        std::string extension(dot == std::string::npos ? "" : name.substr(dot));
+
+        if (extension == ".yaml" || extension == ".yml" || extension == ".ydb") {
+            names.push_back(path + "/" + name);
+        }
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    input_files.insert(input_files.end(), names.begin(), names.end());
+}
+
+
+/**
+ * Program entry-point.
+ *
+ */
+int main(int argc, char **argv) {
+    // parse arguments
+    while (true) {
+        int index = -1;
+
+        getopt_long(argc, argv, "", options, &index);
+        if (index == -1) {
+            if (argc < optind + 2) {
+                usage();
+                return 1;
+            }
+
+            catalog_file = argv[optind++];
+
+            const char *name = argv[optind++];
+
+            if (strcmp(name, "ingest") == 0) {
+                command = COMMAND_INGEST;
+            } else if (strcmp(name, "count") == 0) {
+                command = COMMAND_COUNT;
+            } else if (strcmp(name, "images") == 0) {
+                command = COMMAND_IMAGES;
+            } else if (strcmp(name, "export") == 0) {
+                command = COMMAND_EXPORT;
+            } else {
+                fprintf(stderr, "Error: unsupported command: %s\n", name);
+                return 1;
+            }
+            if ((command == COMMAND_INGEST) != (argc > optind)) {
+                usage();
+                return 1;
+            }
+
+            for (; optind < argc; optind++) {
+                if (strcmp(argv[optind], "-") == 0) {
+                    for (std::string line; std::getline(std::cin, line); ) {
+                        if (!line.empty()) {
+                            addInput(line);
+                        }
+                    }
+                } else {
+                    addInput(argv[optind]);
+                }
+            }
+            break;
+        }
+
+        switch (index) {
+        case OPTION_CLASS:
+            query.className = optarg;
+            break;
+
+        case OPTION_AUTO_STATUS:
+            query.autoStatus = optarg;
+            break;
+
+        case OPTION_MANUAL_STATUS:
+            query.manualStatus = optarg;
+            break;
+
+        case OPTION_FALSE_POSITIVE:
+            query.falsePositive = optarg;
+            break;
+
+        case OPTION_INVALID:
+            query.invalid = atoi(optarg) != 0;
+            break;
+
+        case OPTION_IMAGE:
+            query.image = optarg;
+            break;
+
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    // read catalog
+    DetectionCatalog catalog;
+
+    if (!catalog.open(catalog_file, command == COMMAND_INGEST)) {
+        fprintf(stderr, "Error: cannot open catalog file: %s\n", catalog_file);
+        return 2;
+    }
+
+    switch (command) {
+    case COMMAND_INGEST:
+        {
+            unsigned int ingested = 0;
+
+            if (!catalog.ingest(input_files, &ingested)) {
+                fprintf(stderr, "Error: cannot write catalog file: %s\n", catalog_file);
+                return 3;
+            }
+            fprintf(stderr, "Ingested %u of %u objects files (%u images in catalog)\n", ingested, (unsigned int)input_files.size(), catalog.imageCount());
+        }
+        break;
+
+    case COMMAND_COUNT:
+        printf("%u\n", catalog.count(query));
+        break;
+
+    case COMMAND_IMAGES:
+        {
+            std::map<unsigned int, unsigned int> counts;
+
+            catalog.select(query, [&] (unsigned int index) {
+                counts[catalog.recordImage(index)]++;
+            });
+            for (auto it = counts.begin(); it != counts.end(); ++it) {
+                printf("%u\t%s\t%s\n", (*it).second, catalog.imagePath((*it).first), catalog.imageSource((*it).first));
+            }
+        }
+        break;
+
+    case COMMAND_EXPORT:
+        printf("objects\tsource\tclassName\tfalsePositive\tautoStatus\tmanualStatus\tinvalid\tsystem\tx1\ty1\tx2\ty2\tchildren\n");
+        catalog.select(query, [&] (unsigned int index) {
+            const CatalogRecord &record = catalog.record(index);
+            unsigned int image = catalog.recordImage(index);
+
+            printf("%s\t%s\t%s\t%s\t%s\t%s\t%d\t%u\t%.17g\t%.17g\t%.17g\t%.17g\t%u\n",
+                catalog.imagePath(image),
+                catalog.imageSource(image),
+                catalog.recordString(index, record.className),
+                catalog.recordString(index, record.falsePositive),
+                catalog.recordString(index, record.autoStatus),
+                catalog.recordString(index, record.manualStatus),
+                (record.flags & DetectionFile::FLAG_INVALID) ? 1 : 0,
+                record.system,
+                record.box[0], record.box[1], record.box[2], record.box[3],
+                record.childCount
+            );
+        });
+        break;
+    }
+    return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+
+#include "detectors/detector.hpp"
+#include "detectors/store.hpp"
+
+
+/*
+ * Program arguments.
+ *
+ */
+
+static const char *input_file = NULL;
+static const char *output_file = NULL;
+
+
+static struct option options[] = {
+    {0, 0, 0, 0}
+};
+
+
+/**
+ * Display program usage.
+ *
+ */
+void usage() {
+    printf("yafdb-convert input-objects.yaml output-objects.ydb\n\n");
+
+    printf("Convert detected objects between yaml and binary (.ydb) formats. Input\n");
+    printf("format is detected from file content, output format from its extension.\n");
+    printf("Objects, invalid objects and source image name are kept; other yaml\n");
+    printf("entries (detector settings) are not part of the binary format.\n\n");
+}
+
+
+/**
+ * Program entry-point.
+ *
+ */
+int main(int argc, char **argv) {
+    // parse arguments
+    while (true) {
+        int index = -1;
+
+        getopt_long(argc, argv, "", options, &index);
+        if (index == -1) {
+            if (argc != optind + 2) {
+                usage();
+                return 1;
+            }
+
+            input_file = argv[optind++];
+            if (access(input_file, R_OK)) {
+                fprintf(stderr, "Error: detected objects file not readable: %s\n", input_file);
+                return 2;
+            }
+
+            output_file = argv[optind++];
+            if (access(output_file, W_OK) && errno == EACCES) {
+                fprintf(stderr, "Error: detected objects file not writable: %s\n", output_file);
+                return 2;
+            }
+            break;
+        }
+
+        switch (index) {
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    // read detected objects
+    DetectionStore objects;
+
+    if (!objects.load(input_file)) {
+        fprintf(stderr, "Error: cannot read objects in file: %s\n", input_file);
+        return 2;
+    }
+
+    // write detected objects
+    if (!objects.save(output_file)) {
+        fprintf(stderr, "Error: cannot write objects in file: %s\n", output_file);
+        return 3;
+    }
+    return 0;
+}
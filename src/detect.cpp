@@ -49,6 +49,11 @@
 #include "detectors/hierarchical.hpp"
 #include "detectors/gnomonic.hpp"
 #include "detectors/haar.hpp"
+#include "detectors/masked.hpp"
+#include "detectors/reader.hpp"
+#include "detectors/binary.hpp"
+#include "detectors/store.hpp"
+#include "detectors/writer.hpp"
 
 
 /*
@@ -81,19 +86,36 @@
 #define OPTION_HAAR_MODEL             13
 #define OPTION_HAAR_SCALE             14
 #define OPTION_HAAR_MIN_OVERLAP       15
+#define OPTION_MODEL_AREA             16
+#define OPTION_EXCLUSION_MASK         17
+#define OPTION_PRIOR                  18
+#define OPTION_PRIOR_SKIP             19
+#define OPTION_PRIOR_LOW              20
+#define OPTION_PRIOR_LOW_SCALE        21
+#define OPTION_PRIOR_FULL_SCAN        22
+#define OPTION_GNOMONIC_BAND          23
+#define OPTION_GNOMONIC_INTERPOLATION 24
+#define OPTION_GNOMONIC_BLOCKED       25
+#define OPTION_MEMORY_LIMIT           26
+#define OPTION_STREAM_NDJSON          27
 
 
 class HaarModel;
+class ModelArea;
+class GnomonicBand;
 
 static int full_invalid = 0;
 static int merge_valid_objects = 0;
 static int merge_min_overlap   = 1;
 static int algorithm = ALGORITHM_HAAR;
 static int gnomonic_enabled = 0;
+static int gnomonic_blocked = 0;
 static int filters_enabled  = 1;
 static int gnomonic_width = 2048;
-static double gnomonic_aperture_x = 60;
-static double gnomonic_aperture_y = 60;
+static double gnomonic_aperture_x = 60.0 / 180.0 * M_PI;
+static double gnomonic_aperture_y = 60.0 / 180.0 * M_PI;
+static std::vector<GnomonicBand> gnomonic_bands;
+static GnomonicTransform::Interpolation gnomonic_interpolation = GnomonicTransform::AUTO;
 static double flter_ratio_min     = 0.7;
 static double flter_ratio_max     = 1.3;
 static double flter_size_max_width = 3000;
@@ -101,6 +123,15 @@ static double flter_size_max_height = 3000;
 static std::map<std::string, HaarModel> haar_models;
 static double haar_scale = 1.1;
 static int haar_min_overlap = 3;
+static std::map<std::string, ModelArea> model_areas;
+static const char *exclusion_mask_file = NULL;
+static const char *prior_file = NULL;
+static double prior_skip = 0.01;
+static double prior_low = 0.05;
+static double prior_low_scale = 0.5;
+static int prior_full_scan = 20;
+static int memory_limit = 0;
+static int stream_ndjson = 0;
 static const char *source_file = NULL;
 static const char *objects_file = NULL;
 
@@ -122,6 +153,18 @@ static struct option options[] = {
     {"haar-model",            required_argument, 0,                    0 },
     {"haar-scale",            required_argument, 0,                    0 },
     {"haar-min-overlap",      required_argument, 0,                    0 },
+    {"model-area",            required_argument, 0,                    0 },
+    {"exclusion-mask",        required_argument, 0,                    0 },
+    {"prior",                 required_argument, 0,                    0 },
+    {"prior-skip",            required_argument, 0,                    0 },
+    {"prior-low",             required_argument, 0,                    0 },
+    {"prior-low-scale",       required_argument, 0,                    0 },
+    {"prior-full-scan",       required_argument, 0,                    0 },
+    {"gnomonic-band",         required_argument, 0,                    0 },
+    {"gnomonic-interpolation", required_argument, 0,                   0 },
+    {"gnomonic-blocked",      no_argument,       &gnomonic_blocked,    1 },
+    {"memory-limit",          required_argument, 0,                    0 },
+    {"stream-ndjson",         no_argument,       &stream_ndjson,       1 },
     {0, 0, 0, 0}
 };
 
@@ -173,9 +216,9 @@ public:
         fs << "}";
     }
 
-    std::shared_ptr<ObjectDetector> build() const {
+    std::shared_ptr<ObjectDetector> build(const cv::Size &minSize = cv::Size(10, 10), const cv::Size &maxSize = cv::Size()) const {
         std::shared_ptr<ObjectDetector> detector(
-            new HaarDetector(this->className, this->file, haar_scale, haar_min_overlap)
+            new HaarDetector(this->className, this->file, haar_scale, haar_min_overlap, minSize, maxSize)
         );
 
         if (this->children.size() > 0) {
@@ -232,6 +275,124 @@ public:
 };
 
 
+class ModelArea {
+public:
+    std::string className;
+    double minLatitude;
+    double maxLatitude;
+    double minLongitude;
+    double maxLongitude;
+
+
+    ModelArea() : minLatitude(-90), maxLatitude(90), minLongitude(0), maxLongitude(360) {
+    }
+
+    ModelArea(const ModelArea &ref) : className(ref.className), minLatitude(ref.minLatitude), maxLatitude(ref.maxLatitude), minLongitude(ref.minLongitude), maxLongitude(ref.maxLongitude) {
+    }
+
+
+    void write(cv::FileStorage &fs) const {
+        fs << "{";
+        fs << "className" << this->className;
+        fs << "minLatitude" << this->minLatitude;
+        fs << "maxLatitude" << this->maxLatitude;
+        fs << "minLongitude" << this->minLongitude;
+        fs << "maxLongitude" << this->maxLongitude;
+        fs << "}";
+    }
+
+    std::shared_ptr<ObjectDetector> build(const std::shared_ptr<ObjectDetector> &detector) const {
+        // latitudes are positive above horizon whereas polar angles grow downward in eqr
+        return std::shared_ptr<ObjectDetector>(
+            new MaskedObjectDetector(
+                detector,
+                -this->maxLatitude / 180.0 * M_PI,
+                -this->minLatitude / 180.0 * M_PI,
+                this->minLongitude / 180.0 * M_PI,
+                this->maxLongitude / 180.0 * M_PI
+            )
+        );
+    }
+
+
+    static bool parse(const std::string &value) {
+        std::stringstream stream(value);
+        std::vector<std::string> items;
+
+        for (std::string item; std::getline(stream, item, ':'); ) {
+            items.push_back(item);
+        }
+        switch (items.size()) {
+        case 5:
+            model_areas[items[0]].minLongitude = atof(items[3].c_str());
+            model_areas[items[0]].maxLongitude = atof(items[4].c_str());
+            // fall through
+        case 3:
+            model_areas[items[0]].className = items[0];
+            model_areas[items[0]].minLatitude = MIN(atof(items[1].c_str()), atof(items[2].c_str()));
+            model_areas[items[0]].maxLatitude = MAX(atof(items[1].c_str()), atof(items[2].c_str()));
+            return true;
+        }
+        return false;
+    }
+};
+
+
+class GnomonicBand {
+public:
+    int width;
+    double apertureX;
+    double apertureY;
+    int minSize;
+    int maxSize;
+
+
+    GnomonicBand() : width(2048), apertureX(M_PI / 3), apertureY(M_PI / 3), minSize(10), maxSize(0) {
+    }
+
+    GnomonicBand(const GnomonicBand &ref) : width(ref.width), apertureX(ref.apertureX), apertureY(ref.apertureY), minSize(ref.minSize), maxSize(ref.maxSize) {
+    }
+
+
+    void write(cv::FileStorage &fs) const {
+        fs << "{";
+        fs << "width" << this->width;
+        fs << "aperture_x" << this->apertureX;
+        fs << "aperture_y" << this->apertureY;
+        fs << "min_size" << this->minSize;
+        fs << "max_size" << this->maxSize;
+        fs << "}";
+    }
+
+
+    static bool parse(const std::string &value) {
+        std::stringstream stream(value);
+        std::vector<std::string> items;
+        GnomonicBand band;
+
+        for (std::string item; std::getline(stream, item, ':'); ) {
+            items.push_back(item);
+        }
+        switch (items.size()) {
+        case 5:
+            band.minSize = atoi(items[3].c_str());
+            band.maxSize = atoi(items[4].c_str());
+            // fall through
+        case 3:
+            band.width = atoi(items[0].c_str());
+            band.apertureX = atof(items[1].c_str()) / 180.0 * M_PI;
+            band.apertureY = atof(items[2].c_str()) / 180.0 * M_PI;
+            if (band.width <= 0 || band.apertureX <= 0 || band.apertureY <= 0) {
+                return false;
+            }
+            gnomonic_bands.push_back(band);
+            return true;
+        }
+        return false;
+    }
+};
+
+
 /**
  * Display program usage.
  *
@@ -246,6 +407,8 @@ void usage() {
     printf("--merge-valid-objects : Merge overlapping valid objects rectangles\n");
     printf("--merge-min-overlap 1 : Minimum occurrence of overlap to keep detected objects\n");
     printf("--algorithm algo : algorithm to use for object detection ('haar')\n");
+    printf("--memory-limit 0 : decode 8-bit tiff images by bands of rows within given memory in MB (gnomonic only, 0 = load whole image)\n");
+    printf("--stream-ndjson : also write detected objects to standard output as json lines, tile by tile (gnomonic without merging)\n");
     printf("\n");
 
     printf("Gnomonic projection options:\n\n");
@@ -253,6 +416,17 @@ void usage() {
     printf("--gnomonic-width 2048    : projection window width\n");
     printf("--gnomonic-aperture-x 60 : horizontal projection aperture\n");
     printf("--gnomonic-aperture-y 60 : vertical projection aperture\n");
+    printf("--gnomonic-band width:apertureX:apertureY[:minSize:maxSize] : scale band with its own tiling and haar object size range in pixels (0 = unlimited, allowed multiple times, replaces width/aperture)\n");
+    printf("--gnomonic-interpolation auto : tile resampling method ('auto', 'bilinear' or 'nearest')\n");
+    printf("--gnomonic-blocked       : sample tiles from a cache-blocked copy of the image (faster near the poles, uses more memory)\n");
+    printf("\n");
+
+    printf("Tile prior options (see yafdb-prior):\n\n");
+    printf("--prior prior.yaml     : tile hit-rate prior used to reduce gnomonic scanning\n");
+    printf("--prior-skip 0.01      : hit-rate under which tiles are skipped\n");
+    printf("--prior-low 0.05       : hit-rate under which tiles are scanned at lower resolution\n");
+    printf("--prior-low-scale 0.5  : resolution scale of low hit-rate tiles\n");
+    printf("--prior-full-scan 20   : ignore prior for one image out of n (0 = never)\n");
     printf("\n");
 
     printf("Filtering options:\n\n");
@@ -269,6 +443,11 @@ void usage() {
     printf("--haar-scale 1.1                                  : haar reduction scale factor\n");
     printf("--haar-min-overlap 3                              : haar minimum detection overlap\n");
     printf("\n");
+
+    printf("Area options:\n\n");
+    printf("--model-area class:minLat:maxLat[:minLon:maxLon] : restrict model to a latitude/longitude band in degrees (latitude +90 = zenith, -90 = nadir)\n");
+    printf("--exclusion-mask mask.png                        : static exclusion mask in eqr projection (white = excluded)\n");
+    printf("\n");
 }
 
 
@@ -294,6 +473,12 @@ int main(int argc, char **argv) {
                 }
             }
 
+            for (auto it = model_areas.begin(); it != model_areas.end(); ++it) {
+                if (haar_models.find((*it).first) == haar_models.end()) {
+                    fprintf(stderr, "Warning: model area given for unknown class: %s\n", (*it).first.c_str());
+                }
+            }
+
             source_file = argv[optind++];
             if (access(source_file, R_OK)) {
                 fprintf(stderr, "Error: source file not readable: %s\n", source_file);
@@ -378,78 +563,212 @@ int main(int argc, char **argv) {
             haar_min_overlap = atoi(optarg);
             break;
 
+        case OPTION_MODEL_AREA:
+            if (!ModelArea::parse(optarg)) {
+                fprintf(stderr, "Error: invalid model area given: %s\n", optarg);
+                return 2;
+            }
+            break;
+
+        case OPTION_GNOMONIC_BAND:
+            if (!GnomonicBand::parse(optarg)) {
+                fprintf(stderr, "Error: invalid gnomonic band given: %s\n", optarg);
+                return 2;
+            }
+            break;
+
+        case OPTION_GNOMONIC_INTERPOLATION:
+            if (strcmp(optarg, "auto") == 0) {
+                gnomonic_interpolation = GnomonicTransform::AUTO;
+            } else if (strcmp(optarg, "bilinear") == 0) {
+                gnomonic_interpolation = GnomonicTransform::BILINEAR;
+            } else if (strcmp(optarg, "nearest") == 0) {
+                gnomonic_interpolation = GnomonicTransform::NEAREST;
+            } else {
+                fprintf(stderr, "Error: unsupported interpolation: %s\n", optarg);
+                return 2;
+            }
+            break;
+
+        case OPTION_GNOMONIC_BLOCKED:
+            break;
+
+        case OPTION_MEMORY_LIMIT:
+            memory_limit = atoi(optarg);
+            break;
+
+        case OPTION_STREAM_NDJSON:
+            break;
+
+        case OPTION_PRIOR:
+            prior_file = optarg;
+            if (access(prior_file, R_OK)) {
+                fprintf(stderr, "Error: prior file not readable: %s\n", prior_file);
+                return 2;
+            }
+            break;
+
+        case OPTION_PRIOR_SKIP:
+            prior_skip = atof(optarg);
+            break;
+
+        case OPTION_PRIOR_LOW:
+            prior_low = atof(optarg);
+            break;
+
+        case OPTION_PRIOR_LOW_SCALE:
+            prior_low_scale = atof(optarg);
+            break;
+
+        case OPTION_PRIOR_FULL_SCAN:
+            prior_full_scan = atoi(optarg);
+            break;
+
+        case OPTION_EXCLUSION_MASK:
+            exclusion_mask_file = optarg;
+            if (access(exclusion_mask_file, R_OK)) {
+                fprintf(stderr, "Error: exclusion mask file not readable: %s\n", exclusion_mask_file);
+                return 2;
+            }
+            break;
+
         default:
             usage();
             return 1;
         }
     }
 
-    // read source file
-    cv::Mat  source      = cv::imread(source_file);
-    cv::Size source_size = source.size();
+    // read static exclusion mask
+    cv::Mat exclusionMask;
 
-    if (source.rows <= 0 || source.cols <= 0) {
-        fprintf(stderr, "Error: cannot read image in source file: %s\n", source_file);
-        return 2;
+    if (exclusion_mask_file != NULL) {
+        exclusionMask = ImageReader::read(exclusion_mask_file, CV_LOAD_IMAGE_GRAYSCALE);
+        if (exclusionMask.rows <= 0 || exclusionMask.cols <= 0) {
+            fprintf(stderr, "Error: cannot read image in exclusion mask file: %s\n", exclusion_mask_file);
+            return 2;
+        }
     }
 
     // instantiate detector(s)
-    std::shared_ptr<ObjectDetector> detector;
+    auto buildDetector = [&] (const cv::Size &minSize, const cv::Size &maxSize) {
+        std::shared_ptr<ObjectDetector> detector;
 
-    switch (algorithm) {
-    case ALGORITHM_NONE:
-        detector.reset(new ObjectDetector());
-        break;
+        switch (algorithm) {
+        case ALGORITHM_NONE:
+            detector.reset(new ObjectDetector());
+            break;
 
-    case ALGORITHM_HAAR:
-        {
-            auto multiDetector = new MultiObjectDetector();
+        case ALGORITHM_HAAR:
+            {
+                auto multiDetector = new MultiObjectDetector();
+
+                std::for_each(haar_models.begin(), haar_models.end(), [&] (const std::pair<std::string, HaarModel> &pair) {
+                    auto area = model_areas.find(pair.first);
+
+                    if (area != model_areas.end()) {
+                        multiDetector->addDetector((*area).second.build(pair.second.build(minSize, maxSize)));
+                    } else {
+                        multiDetector->addDetector(pair.second.build(minSize, maxSize));
+                    }
+                });
+                detector.reset(multiDetector);
+            }
+            break;
+        }
 
-            std::for_each(haar_models.begin(), haar_models.end(), [&] (const std::pair<std::string, HaarModel> &pair) {
-                multiDetector->addDetector(pair.second.build());
-            });
-            detector.reset(multiDetector);
+        // setup static exclusion mask
+        if (detector && !exclusionMask.empty()) {
+            detector.reset(
+                new MaskedObjectDetector(detector, -M_PI / 2, M_PI / 2, 0, 2 * M_PI, exclusionMask)
+            );
         }
-        break;
+        return detector;
+    };
+    std::shared_ptr<ObjectDetector> detector(buildDetector(cv::Size(10, 10), cv::Size()));
 
-    default:
+    if (!detector) {
         fprintf(stderr, "Error: no detector instantiated!\n");
         return 3;
     }
 
     // setup gnomonic reprojection task
+    GnomonicProjectionDetector *gnomonicDetector = NULL;
+    bool priorFullScan = false;
+
     if (gnomonic_enabled) {
-        detector.reset(
-            new GnomonicProjectionDetector(detector, gnomonic_width, gnomonic_aperture_x, gnomonic_aperture_y)
-        );
-    }
+        if (gnomonic_bands.empty()) {
+            gnomonicDetector = new GnomonicProjectionDetector(detector, gnomonic_width, gnomonic_aperture_x, gnomonic_aperture_y);
+        } else {
+            auto bandDetector = [&] (const GnomonicBand &band) {
+                return buildDetector(cv::Size(band.minSize, band.minSize), cv::Size(band.maxSize, band.maxSize));
+            };
 
-    // detect objects in source image
-    bool success = false;
+            gnomonicDetector = new GnomonicProjectionDetector(bandDetector(gnomonic_bands[0]), gnomonic_bands[0].width, gnomonic_bands[0].apertureX, gnomonic_bands[0].apertureY);
+            std::for_each(gnomonic_bands.begin() + 1, gnomonic_bands.end(), [&] (const GnomonicBand &band) {
+                gnomonicDetector->addBand(bandDetector(band), band.width, band.apertureX, band.apertureY);
+            });
+        }
+        gnomonicDetector->setInterpolation(gnomonic_interpolation);
+        gnomonicDetector->setBlockedSource(gnomonic_blocked);
+        detector.reset(gnomonicDetector);
+
+        // use tile prior, except for periodic full scans keeping it honest
+        if (prior_file != NULL) {
+            priorFullScan = prior_full_scan > 0 && std::hash<std::string>()(source_file) % prior_full_scan == 0;
+            if (!priorFullScan) {
+                std::vector<std::shared_ptr<TilePrior>> priors;
+
+                if (!TilePrior::load(prior_file, priors)) {
+                    fprintf(stderr, "Error: cannot read tile prior in file: %s\n", prior_file);
+                    return 2;
+                }
+                if (!gnomonicDetector->setPrior(priors, prior_skip, prior_low, prior_low_scale)) {
+                    fprintf(stderr, "Error: tile prior does not match gnomonic apertures: %s\n", prior_file);
+                    return 2;
+                }
+            }
+        }
+    }
 
-    if (detector) {
-        // run detection algorithm
-        std::list<DetectedObject> objects;
+    // read source file (or stream it by bands of rows)
+    std::shared_ptr<TiffSource> stream;
+    cv::Mat  source;
+    cv::Size source_size;
 
-        if (source.channels() == 1 || detector->supportsColor()) {
-            success = detector->detect(source, objects);
-            source.release();
+    if (memory_limit > 0) {
+        if (!gnomonic_enabled) {
+            fprintf(stderr, "Warning: memory limit requires gnomonic projection, loading whole image\n");
         } else {
-            cv::Mat graySource;
-
-            cv::cvtColor(source, graySource, cv::COLOR_RGB2GRAY);
-            // cv::equalizeHist(graySource, graySource);
-            source.release();
-
-            success = detector->detect(graySource, objects);
+            stream.reset(new TiffSource((size_t)memory_limit * 1024 * 1024));
+            if (stream->open(source_file)) {
+                source_size = cv::Size(stream->cols(), stream->rows());
+            } else {
+                fprintf(stderr, "Warning: cannot stream source file (8-bit tiff required), loading whole image: %s\n", source_file);
+                stream.reset();
+            }
+        }
+    }
+    if (!stream) {
+        // decode straight to grayscale for detectors working on gray images
+        source = ImageReader::read(source_file, detector->supportsColor() ? CV_LOAD_IMAGE_COLOR : CV_LOAD_IMAGE_GRAYSCALE);
+        source_size = source.size();
+
+        if (source.rows <= 0 || source.cols <= 0) {
+            fprintf(stderr, "Error: cannot read image in source file: %s\n", source_file);
+            return 2;
         }
+    }
 
-        /* Apply objects filtering if enabled */
-        if (filters_enabled && !full_invalid)
-        {
+    // detect objects in source image
+    bool success = false;
 
-            /* Iterate over detected objects */
-            std::for_each(objects.begin(), objects.end(), [&] (DetectedObject &object) {
+    if (detector) {
+        // tag detected object according to filters
+        auto finalize = [&] (DetectedObject &object) {
+
+            /* Apply objects filtering if enabled */
+            if (filters_enabled && !full_invalid)
+            {
 
                 /* Scope test variables */
                 bool ratioExceed = false;
@@ -489,20 +808,64 @@ int main(int argc, char **argv) {
                 } else if ( !ratioExceed && !sizeExceed ) {
                     object.autoStatus = "valid";
                 }
+            }
+
+            /* Check if full invalidate requested */
+            if (full_invalid)
+            {
 
+                /* Mark object as invalid */
+                object.autoStatus = "invalid";
+            }
+        };
+
+        // open streamed outputs (binary format is written once detection completes)
+        DetectionWriter writer;
+        DetectionWriter ndjsonWriter;
+        bool binary = DetectionFile::isBinaryName(objects_file);
+
+        if (!binary && !writer.open(objects_file, DetectionWriter::YAML, source_file)) {
+            fprintf(stderr, "Error: cannot write objects in file: %s\n", objects_file);
+            return 2;
+        }
+        if (stream_ndjson && !ndjsonWriter.open("-", DetectionWriter::NDJSON)) {
+            fprintf(stderr, "Error: cannot write objects to standard output\n");
+            return 2;
+        }
+
+        // without merging, objects are final as soon as their tile is scanned
+        bool streamed = gnomonicDetector != NULL && !merge_valid_objects;
+        bool written = true;
+
+        if (streamed) {
+            gnomonicDetector->setTileCallback([&] (std::list<DetectedObject> &tileObjects) {
+                std::for_each(tileObjects.begin(), tileObjects.end(), finalize);
+                written = writer.write(tileObjects) && written;
+                written = ndjsonWriter.write(tileObjects) && written;
             });
         }
 
-        /* Check if full invalidate requested */
-        if (full_invalid)
-        {
+        // run detection algorithm
+        std::list<DetectedObject> objects;
 
-            /* Iterate over objects */
-            std::for_each(objects.begin(), objects.end(), [&] (DetectedObject &object) {
+        if (stream) {
+            stream->setGrayscale(!detector->supportsColor());
+            success = gnomonicDetector->detect(*stream, objects);
+        } else if (source.channels() == 1 || detector->supportsColor()) {
+            success = detector->detect(source, objects);
+            source.release();
+        } else {
+            cv::Mat graySource;
 
-                /* Mark object as invalid */
-                object.autoStatus = "invalid";
-            });
+            cv::cvtColor(source, graySource, cv::COLOR_RGB2GRAY);
+            // cv::equalizeHist(graySource, graySource);
+            source.release();
+
+            success = detector->detect(graySource, objects);
+        }
+
+        if (!streamed) {
+            std::for_each(objects.begin(), objects.end(), finalize);
         }
 
         // merge detected objects
@@ -513,34 +876,48 @@ int main(int argc, char **argv) {
             std::list<DetectedObject> otherObjects;
 
             /* Build valid and others object into separated lists */
-            std::for_each(objects.begin(), objects.end(), [&] (DetectedObject &object) {
-                if(object.autoStatus == "valid")
+            for (auto it = objects.begin(); it != objects.end(); ) {
+                if((*it).autoStatus == "valid")
                 {
-                    validObjects.push_back(object);
+                    validObjects.splice(validObjects.end(), objects, it++);
                 } else {
-                    otherObjects.push_back(object);
+                    otherObjects.splice(otherObjects.end(), objects, it++);
                 }
-            });
+            }
 
             /* Merge valid objects */
             ObjectDetector::merge(validObjects, merge_min_overlap);
 
-            /* Clear base objects list */
-            objects.clear();
-
             /* Append merged valid objects into base list */
-            std::for_each(validObjects.begin(), validObjects.end(), [&] (DetectedObject &object) {
-                objects.push_back(object);
-            });
+            objects.splice(objects.end(), validObjects);
 
             /* Append other objects into base list */
-            std::for_each(otherObjects.begin(), otherObjects.end(), [&] (DetectedObject &object) {
-                objects.push_back(object);
-            });
+            objects.splice(objects.end(), otherObjects);
         }
 
-        // save detected objects
-        cv::FileStorage fs(objects_file, cv::FileStorage::WRITE);
+        if (!streamed) {
+            written = writer.write(objects) && written;
+            written = ndjsonWriter.write(objects) && written;
+        }
+        if (stream_ndjson && !(ndjsonWriter.close() && written)) {
+            fprintf(stderr, "Error: cannot write objects to standard output\n");
+            return 2;
+        }
+
+        // save detected objects (binary format keeps objects and source only)
+        if (binary) {
+            DetectionStore store(objects);
+
+            store.setSourceFile(source_file);
+            if (!store.save(objects_file)) {
+                fprintf(stderr, "Error: cannot write objects in file: %s\n", objects_file);
+                return 2;
+            }
+            return success ? 0 : 4;
+        }
+
+        // append detection settings after the streamed objects
+        cv::FileStorage fs(".yml", cv::FileStorage::WRITE + cv::FileStorage::MEMORY);
 
         switch (algorithm) {
         case ALGORITHM_NONE:
@@ -563,14 +940,57 @@ int main(int argc, char **argv) {
             break;
         }
         if (gnomonic_enabled) {
-            fs << "gnomonic" << "{" << "width" << gnomonic_width << "aperture_x" << gnomonic_aperture_x << "aperture_y" << gnomonic_aperture_y << "}";
+            fs << "gnomonic" << "{";
+            if (gnomonic_bands.empty()) {
+                fs << "width" << gnomonic_width << "aperture_x" << gnomonic_aperture_x << "aperture_y" << gnomonic_aperture_y;
+            } else {
+                fs << "bands" << "[";
+                std::for_each(gnomonic_bands.begin(), gnomonic_bands.end(), [&] (const GnomonicBand &band) {
+                    band.write(fs);
+                });
+                fs << "]";
+            }
+            fs << "}";
+        }
+        if (prior_file != NULL) {
+            fs << "prior" << "{" << "file" << prior_file << "full_scan" << (int)priorFullScan << "}";
+        }
+        if (gnomonicDetector != NULL) {
+            auto &skipped = gnomonicDetector->skippedTiles();
+            bool any = std::any_of(skipped.begin(), skipped.end(), [] (const GnomonicProjectionDetector::SkippedTiles &band) {
+                return !band.tiles.empty();
+            });
+
+            // skipped tiles are keyed by the scan grid of their band
+            if (any) {
+                fs << "skipped_tiles" << "[";
+                std::for_each(skipped.begin(), skipped.end(), [&] (const GnomonicProjectionDetector::SkippedTiles &band) {
+                    if (band.tiles.empty()) {
+                        return;
+                    }
+                    fs << "{" << "aperture_x" << band.ax << "aperture_y" << band.ay << "tiles" << "[";
+                    std::for_each(band.tiles.begin(), band.tiles.end(), [&] (const cv::Point2d &center) {
+                        fs << center;
+                    });
+                    fs << "]" << "}";
+                });
+                fs << "]";
+            }
+        }
+        if (!model_areas.empty()) {
+            fs << "areas" << "[";
+            std::for_each(model_areas.begin(), model_areas.end(), [&] (const std::pair<std::string, ModelArea> &pair) {
+                pair.second.write(fs);
+            });
+            fs << "]";
+        }
+        if (exclusion_mask_file != NULL) {
+            fs << "exclusion_mask" << exclusion_mask_file;
+        }
+        if (!(writer.close(DetectionWriter::trailer(fs)) && written)) {
+            fprintf(stderr, "Error: cannot write objects in file: %s\n", objects_file);
+            return 2;
         }
-        fs << "source" << source_file;
-        fs << "objects" << "[";
-        std::for_each(objects.begin(), objects.end(), [&] (const DetectedObject &object) {
-            object.write(fs);
-        });
-        fs << "]";
     }
     return success ? 0 : 4;
 }
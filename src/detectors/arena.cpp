@@ -0,0 +1,113 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "arena.hpp"
+
+
+Arena::Arena(size_t blockSize) : blockSize(blockSize), current(0), used(0) {
+}
+
+Arena::~Arena() {
+    this->release();
+}
+
+void* Arena::allocate(size_t size, size_t alignment) {
+    if (!this->blocks.empty()) {
+        const Block &block = this->blocks[this->current];
+        size_t offset = ((uintptr_t)(block.data + this->used) + alignment - 1) / alignment * alignment - (uintptr_t)block.data;
+
+        if (offset + size <= block.size) {
+            this->used = offset + size;
+            return block.data + offset;
+        }
+    }
+
+    // move to the next kept block large enough, or allocate a new one
+    size_t needed = size + alignment;
+    size_t next = this->blocks.empty() ? 0 : this->current + 1;
+
+    while (next < this->blocks.size() && this->blocks[next].size < needed) {
+        next++;
+    }
+    if (next < this->blocks.size()) {
+        Block block = this->blocks[next];
+
+        this->blocks.erase(this->blocks.begin() + next);
+        next = this->blocks.empty() ? 0 : this->current + 1;
+        this->blocks.insert(this->blocks.begin() + next, block);
+    } else {
+        Block block = { NULL, needed > this->blockSize ? needed : this->blockSize };
+
+        block.data = (char*)malloc(block.size);
+        if (!block.data) {
+            throw std::bad_alloc();
+        }
+        next = this->blocks.empty() ? 0 : this->current + 1;
+        this->blocks.insert(this->blocks.begin() + next, block);
+    }
+    this->current = next;
+    this->used = 0;
+    return this->allocate(size, alignment);
+}
+
+void Arena::reset() {
+    this->current = 0;
+    this->used = 0;
+}
+
+void Arena::release() {
+    for (auto it = this->blocks.begin(); it != this->blocks.end(); ++it) {
+        free((*it).data);
+    }
+    this->blocks.clear();
+    this->current = 0;
+    this->used = 0;
+}
+
+size_t Arena::capacity() const {
+    size_t size = 0;
+
+    for (auto it = this->blocks.begin(); it != this->blocks.end(); ++it) {
+        size += (*it).size;
+    }
+    return size;
+}
@@ -0,0 +1,197 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#ifndef __YAFDB_DETECTORS_ARENA_H_INCLUDE__
+#define __YAFDB_DETECTORS_ARENA_H_INCLUDE__
+
+
+#include <stddef.h>
+
+#include <new>
+#include <vector>
+
+
+/**
+ * Monotonic memory arena. Allocations are carved out of large blocks and
+ * are never freed individually: the whole arena is reset at once, keeping
+ * its blocks for the next job.
+ *
+ */
+class Arena {
+protected:
+    /** Memory block */
+    struct Block {
+        /** Block memory */
+        char *data;
+
+        /** Block size in bytes */
+        size_t size;
+    };
+
+    /** Allocated blocks */
+    std::vector<Block> blocks;
+
+    /** Default block size in bytes */
+    size_t blockSize;
+
+    /** Index of block in use */
+    size_t current;
+
+    /** Bytes used in current block */
+    size_t used;
+
+
+public:
+    /**
+     * Default constructor.
+     *
+     * \param blockSize default block size in bytes
+     */
+    Arena(size_t blockSize = 1 << 20);
+
+    /**
+     * Destructor.
+     */
+    ~Arena();
+
+
+    /**
+     * Allocate memory in arena.
+     *
+     * \param size number of bytes
+     * \param alignment alignment in bytes (power of two)
+     * \return allocated memory
+     */
+    void* allocate(size_t size, size_t alignment = 2 * sizeof(void*));
+
+    /**
+     * Forget all allocations in constant time. Blocks are kept for reuse.
+     */
+    void reset();
+
+    /**
+     * Forget all allocations and free blocks.
+     */
+    void release();
+
+    /**
+     * Get total size of blocks.
+     *
+     * \return size in bytes
+     */
+    size_t capacity() const;
+
+
+private:
+    Arena(const Arena &);
+    Arena& operator=(const Arena &);
+};
+
+
+/**
+ * Standard allocator drawing memory from an arena (or from the heap if no
+ * arena is given). Deallocation is a no-op for arena memory, which is
+ * reclaimed when the arena is reset.
+ *
+ */
+template <typename T> class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    /** Arena to allocate from (NULL for heap) */
+    Arena *arena;
+
+
+    /**
+     * Default constructor.
+     *
+     * \param arena arena to allocate from (NULL for heap)
+     */
+    ArenaAllocator(Arena *arena = NULL) : arena(arena) {
+    }
+
+    /**
+     * Rebind constructor.
+     *
+     * \param ref reference allocator
+     */
+    template <typename U> ArenaAllocator(const ArenaAllocator<U> &ref) : arena(ref.arena) {
+    }
+
+
+    /**
+     * Allocate memory for objects.
+     *
+     * \param count number of objects
+     * \return allocated memory
+     */
+    T* allocate(size_t count) {
+        if (this->arena) {
+            return static_cast<T*>(this->arena->allocate(count * sizeof(T), alignof(T)));
+        }
+        return static_cast<T*>(::operator new(count * sizeof(T)));
+    }
+
+    /**
+     * Release memory of objects.
+     *
+     * \param ptr allocated memory
+     * \param count number of objects
+     */
+    void deallocate(T *ptr, size_t count) {
+        if (!this->arena) {
+            ::operator delete(ptr);
+        }
+    }
+
+    template <typename U> struct rebind {
+        typedef ArenaAllocator<U> other;
+    };
+};
+
+template <typename T, typename U> bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+    return a.arena == b.arena;
+}
+
+template <typename T, typename U> bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+    return a.arena != b.arena;
+}
+
+
+#endif //__YAFDB_DETECTORS_ARENA_H_INCLUDE__
@@ -0,0 +1,167 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <vector>
+
+#include "binary.hpp"
+
+
+const uint32_t DetectionFile::VERSION;
+const uint32_t DetectionFile::FLAG_INVALID;
+
+
+DetectionFile::DetectionFile() : data(NULL), length(0), header(NULL) {
+}
+
+DetectionFile::~DetectionFile() {
+    this->close();
+}
+
+bool DetectionFile::open(const std::string &file) {
+    struct stat st;
+    int fd = ::open(file.c_str(), O_RDONLY);
+
+    this->close();
+    if (fd < 0) {
+        return false;
+    }
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(DetectionFileHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    this->data = (const unsigned char*)data;
+    this->length = st.st_size;
+    this->header = (const DetectionFileHeader*)data;
+
+    // check header and section bounds
+    const DetectionFileHeader &h = *this->header;
+    auto inside = [&] (uint64_t offset, uint64_t count, uint64_t item, uint64_t alignment) {
+        return offset % alignment == 0 && offset <= this->length && count <= (this->length - offset) / item;
+    };
+
+    if (memcmp(h.magic, "YFDB", 4) != 0 || h.version != VERSION || h.byteOrder != 0x01020304 ||
+        !inside(h.entryOffset, h.entryCount, sizeof(DetectionRecord), 8) ||
+        !inside(h.rootOffset, h.rootCount, sizeof(uint32_t), 4) ||
+        !inside(h.symbolOffset, h.symbolCount, sizeof(uint32_t), 4) ||
+        !inside(h.stringOffset, h.stringSize, 1, 1) ||
+        h.stringSize == 0 || this->data[h.stringOffset + h.stringSize - 1] != 0 ||
+        h.source >= h.symbolCount) {
+        this->close();
+        return false;
+    }
+
+    // check references so that accessors never leave the mapping
+    for (unsigned int i = 0; i < h.symbolCount; i++) {
+        if (reinterpret_cast<const uint32_t*>(this->data + h.symbolOffset)[i] >= h.stringSize) {
+            this->close();
+            return false;
+        }
+    }
+    for (unsigned int i = 0; i < h.rootCount; i++) {
+        if (this->root(i) >= h.entryCount) {
+            this->close();
+            return false;
+        }
+    }
+
+    // children are laid out after their parent and belong to one parent
+    // only, so that recursive accessors terminate in linear time
+    std::vector<bool> claimed(h.entryCount, false);
+
+    for (unsigned int i = 0; i < h.entryCount; i++) {
+        const DetectionRecord &record = this->record(i);
+
+        if (record.className >= h.symbolCount || record.falsePositive >= h.symbolCount ||
+            record.autoStatus >= h.symbolCount || record.manualStatus >= h.symbolCount ||
+            record.childBegin > h.entryCount || record.childCount > h.entryCount - record.childBegin ||
+            (record.childCount > 0 && record.childBegin <= i)) {
+            this->close();
+            return false;
+        }
+        for (unsigned int child = record.childBegin; child < record.childBegin + record.childCount; child++) {
+            if (claimed[child]) {
+                this->close();
+                return false;
+            }
+            claimed[child] = true;
+        }
+    }
+    return true;
+}
+
+void DetectionFile::close() {
+    if (this->data) {
+        munmap((void*)this->data, this->length);
+    }
+    this->data = NULL;
+    this->length = 0;
+    this->header = NULL;
+}
+
+bool DetectionFile::isBinary(const std::string &file) {
+    char magic[4];
+    FILE *fp = fopen(file.c_str(), "rb");
+
+    if (!fp) {
+        return false;
+    }
+
+    bool binary = fread(magic, 1, 4, fp) == 4 && memcmp(magic, "YFDB", 4) == 0;
+
+    fclose(fp);
+    return binary;
+}
+
+bool DetectionFile::isBinaryName(const std::string &file) {
+    return file.size() >= 4 && file.compare(file.size() - 4, 4, ".ydb") == 0;
+}
@@ -0,0 +1,272 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#ifndef __YAFDB_DETECTORS_BINARY_H_INCLUDE__
+#define __YAFDB_DETECTORS_BINARY_H_INCLUDE__
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+
+/**
+ * Header of binary detection file (.ydb). All values are stored in the
+ * byte order of the writer, which is checked by readers.
+ *
+ * Layout: header, entry records, root entry indices, symbol offsets and
+ * string table (NUL-terminated strings).
+ *
+ */
+struct DetectionFileHeader {
+    /** File magic ("YFDB") */
+    char magic[4];
+
+    /** Format version */
+    uint32_t version;
+
+    /** Byte order marker (0x01020304) */
+    uint32_t byteOrder;
+
+    /** Number of entry records */
+    uint32_t entryCount;
+
+    /** Number of top-level objects */
+    uint32_t rootCount;
+
+    /** Number of symbols */
+    uint32_t symbolCount;
+
+    /** Size of string table in bytes */
+    uint32_t stringSize;
+
+    /** Symbol of source image filename */
+    uint32_t source;
+
+    /** Offset of entry records */
+    uint64_t entryOffset;
+
+    /** Offset of root entry indices */
+    uint64_t rootOffset;
+
+    /** Offset of symbol offsets in string table */
+    uint64_t symbolOffset;
+
+    /** Offset of string table */
+    uint64_t stringOffset;
+};
+
+
+/**
+ * Entry record of binary detection file (one per object or child).
+ *
+ */
+struct DetectionRecord {
+    /** Bounding box points (p1.x, p1.y, p2.x, p2.y) */
+    double box[4];
+
+    /** Coordinate system */
+    uint32_t system;
+
+    /** Class name symbol */
+    uint32_t className;
+
+    /** False positive status symbol */
+    uint32_t falsePositive;
+
+    /** Automatic detection status symbol */
+    uint32_t autoStatus;
+
+    /** Manual validation status symbol */
+    uint32_t manualStatus;
+
+    /** First child entry */
+    uint32_t childBegin;
+
+    /** Number of children */
+    uint32_t childCount;
+
+    /** Record flags (see DetectionFile::FLAG_*) */
+    uint32_t flags;
+};
+
+
+/**
+ * Read-only memory-mapped view of a binary detection file. Records and
+ * strings are accessed in place without parsing.
+ *
+ */
+class DetectionFile {
+public:
+    /** Current format version */
+    static const uint32_t VERSION = 1;
+
+    /** Top-level object is listed as invalid object */
+    static const uint32_t FLAG_INVALID = 1;
+
+
+protected:
+    /** Mapped file */
+    const unsigned char *data;
+
+    /** Mapped size in bytes */
+    size_t length;
+
+    /** File header */
+    const DetectionFileHeader *header;
+
+
+public:
+    /**
+     * Empty constructor.
+     */
+    DetectionFile();
+
+    /**
+     * Destructor.
+     */
+    ~DetectionFile();
+
+
+    /**
+     * Map and check binary detection file.
+     *
+     * \param file binary detection filename
+     * \return true on success, false otherwise
+     */
+    bool open(const std::string &file);
+
+    /**
+     * Unmap file.
+     */
+    void close();
+
+
+    /**
+     * Get number of entry records.
+     *
+     * \return number of entries
+     */
+    unsigned int entries() const {
+        return this->header->entryCount;
+    }
+
+    /**
+     * Get number of top-level objects.
+     *
+     * \return number of objects
+     */
+    unsigned int size() const {
+        return this->header->rootCount;
+    }
+
+    /**
+     * Get number of symbols.
+     *
+     * \return number of symbols
+     */
+    unsigned int symbols() const {
+        return this->header->symbolCount;
+    }
+
+    /**
+     * Get entry record.
+     *
+     * \param entry entry index
+     * \return entry record
+     */
+    const DetectionRecord& record(unsigned int entry) const {
+        return reinterpret_cast<const DetectionRecord*>(this->data + this->header->entryOffset)[entry];
+    }
+
+    /**
+     * Get entry of top-level object.
+     *
+     * \param index object index
+     * \return entry index
+     */
+    unsigned int root(unsigned int index) const {
+        return reinterpret_cast<const uint32_t*>(this->data + this->header->rootOffset)[index];
+    }
+
+    /**
+     * Get symbol string.
+     *
+     * \param symbol symbol index
+     * \return NUL-terminated string
+     */
+    const char* symbol(unsigned int symbol) const {
+        return reinterpret_cast<const char*>(this->data + this->header->stringOffset) + reinterpret_cast<const uint32_t*>(this->data + this->header->symbolOffset)[symbol];
+    }
+
+    /**
+     * Get source image filename.
+     *
+     * \return NUL-terminated string
+     */
+    const char* source() const {
+        return this->symbol(this->header->source);
+    }
+
+
+    /**
+     * Check if file starts with binary detection file magic.
+     *
+     * \param file filename
+     * \return true if file is a binary detection file
+     */
+    static bool isBinary(const std::string &file);
+
+    /**
+     * Check if filename has binary detection file extension (.ydb).
+     *
+     * \param file filename
+     * \return true if binary detection filename
+     */
+    static bool isBinaryName(const std::string &file);
+
+
+private:
+    DetectionFile(const DetectionFile &);
+    DetectionFile& operator=(const DetectionFile &);
+};
+
+
+#endif //__YAFDB_DETECTORS_BINARY_H_INCLUDE__
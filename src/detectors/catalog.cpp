@@ -0,0 +1,588 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
+
+#include "catalog.hpp"
+#include "binary.hpp"
+#include "parallel.hpp"
+#include "store.hpp"
+
+
+const uint32_t DetectionCatalog::VERSION;
+
+
+DetectionCatalog::DetectionCatalog() : data(NULL), mapped(0), length(0), imageTotal(0), recordTotal(0) {
+}
+
+DetectionCatalog::~DetectionCatalog() {
+    this->unmap();
+}
+
+bool DetectionCatalog::open(const std::string &file, bool create) {
+    int fd = create ? ::open(file.c_str(), O_RDWR | O_CREAT, 0644) : ::open(file.c_str(), O_RDONLY);
+
+    this->unmap();
+    if (fd < 0) {
+        return false;
+    }
+    this->file = file;
+
+    // write header of new catalog
+    struct stat st;
+    bool success = flock(fd, create ? LOCK_EX : LOCK_SH) == 0 && fstat(fd, &st) == 0;
+
+    if (success && create && st.st_size == 0) {
+        CatalogFileHeader header;
+
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "YFCT", 4);
+        header.version = VERSION;
+        header.byteOrder = 0x01020304;
+        success = pwrite(fd, &header, sizeof(header), 0) == sizeof(header);
+    }
+
+    // the mapping stays valid once unlocked: writers only append blocks
+    // and truncate damaged tails (the mapping holds the file open, so the
+    // lock is released explicitly)
+    success = success && this->map(fd);
+    flock(fd, LOCK_UN);
+    ::close(fd);
+    return success;
+}
+
+bool DetectionCatalog::map(int fd) {
+    struct stat st;
+
+    this->unmap();
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CatalogFileHeader)) {
+        return false;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    this->data = (const unsigned char*)data;
+    this->mapped = st.st_size;
+
+    const CatalogFileHeader &header = *(const CatalogFileHeader*)data;
+
+    if (memcmp(header.magic, "YFCT", 4) != 0 || header.version != VERSION || header.byteOrder != 0x01020304) {
+        this->unmap();
+        return false;
+    }
+    this->length = sizeof(header);
+
+    // walk block headers, a truncated or damaged tail (interrupted ingest)
+    // ends the catalog
+    while (this->mapped - this->length >= sizeof(CatalogBlockHeader)) {
+        const unsigned char *start = this->data + this->length;
+        const CatalogBlockHeader &h = *(const CatalogBlockHeader*)start;
+        uint64_t size = sizeof(h) +
+            (uint64_t)h.imageCount * sizeof(CatalogImage) +
+            (uint64_t)h.recordCount * sizeof(CatalogRecord) +
+            (uint64_t)h.groupCount * sizeof(CatalogGroup) +
+            (uint64_t)h.supersededCount * sizeof(CatalogSuperseded) +
+            (uint64_t)h.recordCount * sizeof(uint32_t) +
+            (uint64_t)h.symbolCount * sizeof(uint32_t) +
+            h.stringSize;
+
+        if (memcmp(h.magic, "YFCB", 4) != 0 || size > this->mapped - this->length || size % 8 != 0 || h.stringSize == 0 ||
+            (uint64_t)this->imageTotal + h.imageCount > UINT32_MAX || (uint64_t)this->recordTotal + h.recordCount > UINT32_MAX) {
+            break;
+        }
+
+        Block block;
+
+        block.header = &h;
+        block.images = (const CatalogImage*)(start + sizeof(h));
+        block.records = (const CatalogRecord*)(block.images + h.imageCount);
+        block.groups = (const CatalogGroup*)(block.records + h.recordCount);
+        block.superseded = (const CatalogSuperseded*)(block.groups + h.groupCount);
+        block.postings = (const uint32_t*)(block.superseded + h.supersededCount);
+        block.symbols = block.postings + h.recordCount;
+        block.strings = (const char*)(block.symbols + h.symbolCount);
+        block.imageBase = this->imageTotal;
+        block.recordBase = this->recordTotal;
+
+        // other references are checked when used
+        bool valid = block.strings[h.stringSize - 1] == 0;
+
+        for (uint32_t i = 0; i < h.supersededCount && valid; i++) {
+            const CatalogSuperseded &entry = block.superseded[i];
+
+            valid = entry.block < this->blocks.size() && entry.image < this->blocks[entry.block].header->imageCount;
+        }
+        if (!valid) {
+            break;
+        }
+        for (uint32_t i = 0; i < h.supersededCount; i++) {
+            const CatalogSuperseded &entry = block.superseded[i];
+
+            this->superseded.insert(this->blocks[entry.block].imageBase + entry.image);
+        }
+        this->blocks.push_back(block);
+        this->imageTotal += h.imageCount;
+        this->recordTotal += h.recordCount;
+        this->length += size;
+    }
+    return true;
+}
+
+void DetectionCatalog::unmap() {
+    if (this->data) {
+        munmap((void*)this->data, this->mapped);
+    }
+    this->data = NULL;
+    this->mapped = 0;
+    this->length = 0;
+    this->blocks.clear();
+    this->superseded.clear();
+    this->imageTotal = 0;
+    this->recordTotal = 0;
+}
+
+bool DetectionCatalog::ingest(const std::vector<std::string> &files, unsigned int *ingested) {
+    int fd = ::open(this->file.c_str(), O_RDWR);
+
+    if (ingested) {
+        *ingested = 0;
+    }
+    if (fd < 0) {
+        return false;
+    }
+
+    // catch up with other writers, then drop any damaged tail
+    if (flock(fd, LOCK_EX) != 0 || !this->map(fd) || ftruncate(fd, this->length) != 0) {
+        flock(fd, LOCK_UN);
+        ::close(fd);
+        return false;
+    }
+
+    // current image of detection file paths
+    std::unordered_map<std::string, CatalogSuperseded> latest;
+
+    for (uint32_t b = 0; b < this->blocks.size(); b++) {
+        const Block &block = this->blocks[b];
+
+        for (uint32_t i = 0; i < block.header->imageCount; i++) {
+            CatalogSuperseded entry = { b, i };
+
+            latest[string(block, block.images[i].path)] = entry;
+        }
+    }
+
+    // select new or changed files
+    std::vector<std::string> pending;
+    std::vector<struct stat> pendingStats;
+    std::unordered_set<std::string> selected;
+
+    for (auto it = files.begin(); it != files.end(); ++it) {
+        struct stat st;
+
+        if (stat((*it).c_str(), &st) != 0) {
+            fprintf(stderr, "Warning: cannot access objects file: %s\n", (*it).c_str());
+            continue;
+        }
+
+        auto previous = latest.find(*it);
+
+        if (previous != latest.end()) {
+            const CatalogImage &image = this->blocks[(*previous).second.block].images[(*previous).second.image];
+
+            if (image.mtime == (int64_t)st.st_mtime && image.size == (int64_t)st.st_size) {
+                continue;
+            }
+        }
+        if (selected.insert(*it).second) {
+            pending.push_back(*it);
+            pendingStats.push_back(st);
+        }
+    }
+
+    // read files in parallel and append them by batches
+    const size_t batchSize = 64 * ThreadPool::instance().size();
+    uint32_t blockIndex = this->blocks.size();
+    uint64_t tail = this->length;
+    bool success = true;
+
+    for (size_t batch = 0; batch < pending.size() && success; batch += batchSize) {
+        size_t count = MIN(batchSize, pending.size() - batch);
+        std::vector< std::shared_ptr<DetectionStore> > stores(count);
+
+        ThreadPool::instance().parallelFor(0, count, 1, [&] (int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                std::shared_ptr<DetectionStore> store(new DetectionStore());
+
+                if (store->load(pending[batch + i])) {
+                    stores[i] = store;
+                }
+            }
+        });
+
+        // build block with its own symbols
+        std::vector<CatalogImage> blockImages;
+        std::vector<CatalogRecord> blockRecords;
+        std::vector<CatalogSuperseded> blockSuperseded;
+        std::vector<std::string> values;
+        std::unordered_map<std::string, uint32_t> blockSymbols;
+
+        auto blockSymbol = [&] (const std::string &value) {
+            auto it = blockSymbols.find(value);
+
+            if (it != blockSymbols.end()) {
+                return (*it).second;
+            }
+
+            uint32_t symbol = values.size();
+
+            values.push_back(value);
+            blockSymbols[value] = symbol;
+            return symbol;
+        };
+
+        for (size_t i = 0; i < count; i++) {
+            const DetectionStore *store = stores[i].get();
+
+            if (!store) {
+                fprintf(stderr, "Warning: cannot read objects in file: %s\n", pending[batch + i].c_str());
+                continue;
+            }
+
+            CatalogImage image;
+
+            memset(&image, 0, sizeof(image));
+            image.mtime = pendingStats[batch + i].st_mtime;
+            image.size = pendingStats[batch + i].st_size;
+            image.path = blockSymbol(pending[batch + i]);
+            image.source = blockSymbol(store->sourceFile());
+            image.recordBegin = blockRecords.size();
+            image.recordCount = store->size();
+
+            for (unsigned int j = 0; j < store->size(); j++) {
+                unsigned int entry = store->root(j);
+                BoundingBox area(store->area(entry));
+                CatalogRecord record;
+
+                memset(&record, 0, sizeof(record));
+                record.box[0] = area.p1.x;
+                record.box[1] = area.p1.y;
+                record.box[2] = area.p2.x;
+                record.box[3] = area.p2.y;
+                record.image = blockImages.size();
+                record.system = area.system;
+                record.className = blockSymbol(store->symbol(store->className(entry)));
+                record.falsePositive = blockSymbol(store->symbol(store->falsePositive(entry)));
+                record.autoStatus = blockSymbol(store->symbol(store->autoStatus(entry)));
+                record.manualStatus = blockSymbol(store->symbol(store->manualStatus(entry)));
+                record.childCount = store->childEnd(entry) - store->childBegin(entry);
+                record.flags = store->isInvalid(j) ? DetectionFile::FLAG_INVALID : 0;
+                blockRecords.push_back(record);
+            }
+
+            // supersede previous ingest of same file
+            auto previous = latest.find(pending[batch + i]);
+
+            if (previous != latest.end()) {
+                blockSuperseded.push_back((*previous).second);
+            }
+            blockImages.push_back(image);
+        }
+        if (blockImages.empty()) {
+            continue;
+        }
+
+        // symbols are sorted by string, so that queries find them by
+        // binary search
+        std::vector<uint32_t> order(values.size());
+        std::vector<uint32_t> rank(values.size());
+
+        for (uint32_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&] (uint32_t a, uint32_t b) {
+            return values[a] < values[b];
+        });
+        for (uint32_t i = 0; i < order.size(); i++) {
+            rank[order[i]] = i;
+        }
+        for (auto it = blockImages.begin(); it != blockImages.end(); ++it) {
+            (*it).path = rank[(*it).path];
+            (*it).source = rank[(*it).source];
+        }
+
+        // records are grouped by class, statuses and flags
+        std::map< std::tuple<uint32_t, uint32_t, uint32_t, uint32_t, uint32_t>, std::vector<uint32_t> > members;
+
+        for (uint32_t i = 0; i < blockRecords.size(); i++) {
+            CatalogRecord &record = blockRecords[i];
+
+            record.className = rank[record.className];
+            record.falsePositive = rank[record.falsePositive];
+            record.autoStatus = rank[record.autoStatus];
+            record.manualStatus = rank[record.manualStatus];
+            members[std::make_tuple(record.className, record.falsePositive, record.autoStatus, record.manualStatus, record.flags)].push_back(i);
+        }
+
+        std::vector<CatalogGroup> blockGroups;
+        std::vector<uint32_t> postings;
+
+        for (auto it = members.begin(); it != members.end(); ++it) {
+            CatalogGroup group;
+
+            memset(&group, 0, sizeof(group));
+            group.className = std::get<0>((*it).first);
+            group.falsePositive = std::get<1>((*it).first);
+            group.autoStatus = std::get<2>((*it).first);
+            group.manualStatus = std::get<3>((*it).first);
+            group.flags = std::get<4>((*it).first);
+            group.postingBegin = postings.size();
+            group.postingCount = (*it).second.size();
+            postings.insert(postings.end(), (*it).second.begin(), (*it).second.end());
+            blockGroups.push_back(group);
+        }
+
+        std::vector<uint32_t> offsets;
+        std::string strings;
+
+        for (auto it = order.begin(); it != order.end(); ++it) {
+            offsets.push_back(strings.size());
+            strings.append(values[*it].c_str(), values[*it].size() + 1);
+        }
+
+        // keep blocks 8 bytes aligned
+        strings.resize(strings.size() + (8 - (strings.size() + (postings.size() + offsets.size()) * sizeof(uint32_t)) % 8) % 8, '\0');
+
+        CatalogBlockHeader header;
+
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "YFCB", 4);
+        header.imageCount = blockImages.size();
+        header.recordCount = blockRecords.size();
+        header.groupCount = blockGroups.size();
+        header.supersededCount = blockSuperseded.size();
+        header.symbolCount = offsets.size();
+        header.stringSize = strings.size();
+
+        std::string block((const char*)&header, sizeof(header));
+
+        block.append((const char*)&blockImages[0], blockImages.size() * sizeof(CatalogImage));
+        if (!blockRecords.empty()) {
+            block.append((const char*)&blockRecords[0], blockRecords.size() * sizeof(CatalogRecord));
+            block.append((const char*)&blockGroups[0], blockGroups.size() * sizeof(CatalogGroup));
+        }
+        if (!blockSuperseded.empty()) {
+            block.append((const char*)&blockSuperseded[0], blockSuperseded.size() * sizeof(CatalogSuperseded));
+        }
+        if (!postings.empty()) {
+            block.append((const char*)&postings[0], postings.size() * sizeof(uint32_t));
+        }
+        block.append((const char*)&offsets[0], offsets.size() * sizeof(uint32_t));
+        block.append(strings);
+
+        success = pwrite(fd, block.data(), block.size(), tail) == (ssize_t)block.size();
+        if (success) {
+            tail += block.size();
+            for (uint32_t i = 0; i < blockImages.size(); i++) {
+                CatalogSuperseded entry = { blockIndex, i };
+
+                latest[values[order[blockImages[i].path]]] = entry;
+            }
+            blockIndex++;
+            if (ingested) {
+                *ingested += blockImages.size();
+            }
+        }
+    }
+    if (fsync(fd) != 0) {
+        success = false;
+    }
+
+    // map appended blocks
+    success = this->map(fd) && success;
+    flock(fd, LOCK_UN);
+    ::close(fd);
+    return success;
+}
+
+const DetectionCatalog::Block& DetectionCatalog::recordBlock(unsigned int index) const {
+    auto it = std::upper_bound(this->blocks.begin(), this->blocks.end(), index, [] (unsigned int index, const Block &block) {
+        return index < block.recordBase;
+    });
+
+    return *(it - 1);
+}
+
+const DetectionCatalog::Block& DetectionCatalog::imageBlock(unsigned int index) const {
+    auto it = std::upper_bound(this->blocks.begin(), this->blocks.end(), index, [] (unsigned int index, const Block &block) {
+        return index < block.imageBase;
+    });
+
+    return *(it - 1);
+}
+
+const char* DetectionCatalog::string(const Block &block, uint32_t symbol) {
+    if (symbol >= block.header->symbolCount || block.symbols[symbol] >= block.header->stringSize) {
+        return "";
+    }
+    return block.strings + block.symbols[symbol];
+}
+
+bool DetectionCatalog::find(const Block &block, const std::string &value, uint32_t &symbol) {
+    uint32_t low = 0;
+    uint32_t high = block.header->symbolCount;
+
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        int order = strcmp(string(block, middle), value.c_str());
+
+        if (order == 0) {
+            symbol = middle;
+            return true;
+        }
+        if (order < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return false;
+}
+
+BoundingBox DetectionCatalog::area(unsigned int index) const {
+    const CatalogRecord &record = this->record(index);
+
+    return BoundingBox((BoundingBox::CoordinateSystem)record.system, record.box[0], record.box[1], record.box[2], record.box[3]);
+}
+
+void DetectionCatalog::select(const Query &query, const std::function<void(unsigned int)> &callback) const {
+    std::vector<uint32_t> matches;
+
+    for (auto block = this->blocks.begin(); block != this->blocks.end(); ++block) {
+        const CatalogBlockHeader &header = *(*block).header;
+        uint32_t className = 0, autoStatus = 0, manualStatus = 0, falsePositive = 0;
+
+        // resolve query strings in block (strings it does not hold match
+        // none of its records)
+        if ((!query.className.empty() && !find(*block, query.className, className)) ||
+            (!query.autoStatus.empty() && !find(*block, query.autoStatus, autoStatus)) ||
+            (!query.manualStatus.empty() && !find(*block, query.manualStatus, manualStatus)) ||
+            (!query.falsePositive.empty() && !find(*block, query.falsePositive, falsePositive))) {
+            continue;
+        }
+
+        auto matching = [&] (uint32_t recordClass, uint32_t recordFalsePositive, uint32_t recordAuto, uint32_t recordManual, uint32_t flags) {
+            return (query.className.empty() || recordClass == className) &&
+                (query.autoStatus.empty() || recordAuto == autoStatus) &&
+                (query.manualStatus.empty() || recordManual == manualStatus) &&
+                (query.falsePositive.empty() || recordFalsePositive == falsePositive) &&
+                (query.invalid < 0 || (int)(flags & DetectionFile::FLAG_INVALID) == query.invalid);
+        };
+        auto current = [&] (uint32_t image) {
+            return image < header.imageCount && this->superseded.count((*block).imageBase + image) == 0;
+        };
+
+        matches.clear();
+        if (query.image.empty()) {
+            // postings of matching groups
+            for (uint32_t g = 0; g < header.groupCount; g++) {
+                const CatalogGroup &group = (*block).groups[g];
+
+                if (!matching(group.className, group.falsePositive, group.autoStatus, group.manualStatus, group.flags) ||
+                    group.postingBegin > header.recordCount || group.postingCount > header.recordCount - group.postingBegin) {
+                    continue;
+                }
+                for (uint32_t p = group.postingBegin; p < group.postingBegin + group.postingCount; p++) {
+                    uint32_t index = (*block).postings[p];
+
+                    if (index < header.recordCount && current((*block).records[index].image)) {
+                        matches.push_back(index);
+                    }
+                }
+            }
+            std::sort(matches.begin(), matches.end());
+        } else {
+            // records of matching images
+            for (uint32_t i = 0; i < header.imageCount; i++) {
+                const CatalogImage &image = (*block).images[i];
+
+                if (!current(i) || image.recordBegin > header.recordCount || image.recordCount > header.recordCount - image.recordBegin ||
+                    (strstr(string(*block, image.path), query.image.c_str()) == NULL &&
+                     strstr(string(*block, image.source), query.image.c_str()) == NULL)) {
+                    continue;
+                }
+                for (uint32_t index = image.recordBegin; index < image.recordBegin + image.recordCount; index++) {
+                    const CatalogRecord &record = (*block).records[index];
+
+                    if (matching(record.className, record.falsePositive, record.autoStatus, record.manualStatus, record.flags)) {
+                        matches.push_back(index);
+                    }
+                }
+            }
+        }
+        for (auto it = matches.begin(); it != matches.end(); ++it) {
+            callback((*block).recordBase + *it);
+        }
+    }
+}
+
+unsigned int DetectionCatalog::count(const Query &query) const {
+    unsigned int count = 0;
+
+    this->select(query, [&] (unsigned int) {
+        count++;
+    });
+    return count;
+}
@@ -0,0 +1,529 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+
+
+#ifndef __YAFDB_DETECTORS_CATALOG_H_INCLUDE__
+#define __YAFDB_DETECTORS_CATALOG_H_INCLUDE__
+
+
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "detector.hpp"
+
+
+/**
+ * Header of catalog file. All values are stored in the byte order of the
+ * writer, which is checked by readers.
+ *
+ * Layout: header followed by blocks appended by successive ingests.
+ *
+ */
+struct CatalogFileHeader {
+    /** File magic ("YFCT") */
+    char magic[4];
+
+    /** Format version */
+    uint32_t version;
+
+    /** Byte order marker (0x01020304) */
+    uint32_t byteOrder;
+
+    /** Reserved (zero) */
+    uint32_t reserved;
+};
+
+
+/**
+ * Header of catalog block. A block holds the images ingested at once and
+ * their indexes, all local to the block.
+ *
+ * Layout: header, images, object records (grouped by image), groups,
+ * superseded images, postings (record indexes of groups), symbol offsets
+ * (sorted by string) and string table (NUL-terminated strings, padded to
+ * 8 bytes).
+ *
+ */
+struct CatalogBlockHeader {
+    /** Block magic ("YFCB") */
+    char magic[4];
+
+    /** Number of images */
+    uint32_t imageCount;
+
+    /** Number of object records (and postings) */
+    uint32_t recordCount;
+
+    /** Number of groups */
+    uint32_t groupCount;
+
+    /** Number of superseded images */
+    uint32_t supersededCount;
+
+    /** Number of symbols */
+    uint32_t symbolCount;
+
+    /** Size of string table in bytes */
+    uint32_t stringSize;
+
+    /** Reserved (zero) */
+    uint32_t reserved;
+};
+
+
+/**
+ * Image entry of catalog (one per ingested detection file).
+ *
+ */
+struct CatalogImage {
+    /** Modification time of detection file */
+    int64_t mtime;
+
+    /** Size of detection file in bytes */
+    int64_t size;
+
+    /** Detection file path symbol */
+    uint32_t path;
+
+    /** Source image filename symbol */
+    uint32_t source;
+
+    /** First object record (within block) */
+    uint32_t recordBegin;
+
+    /** Number of object records */
+    uint32_t recordCount;
+};
+
+
+/**
+ * Object record of catalog (one per top-level object).
+ *
+ */
+struct CatalogRecord {
+    /** Bounding box points (p1.x, p1.y, p2.x, p2.y) */
+    double box[4];
+
+    /** Image index (within block) */
+    uint32_t image;
+
+    /** Coordinate system */
+    uint32_t system;
+
+    /** Class name symbol */
+    uint32_t className;
+
+    /** False positive status symbol */
+    uint32_t falsePositive;
+
+    /** Automatic detection status symbol */
+    uint32_t autoStatus;
+
+    /** Manual validation status symbol */
+    uint32_t manualStatus;
+
+    /** Number of children */
+    uint32_t childCount;
+
+    /** Record flags (see DetectionFile::FLAG_*) */
+    uint32_t flags;
+};
+
+
+/**
+ * Group of object records sharing class, statuses and flags, indexing
+ * their records in the postings of the block.
+ *
+ */
+struct CatalogGroup {
+    /** Class name symbol */
+    uint32_t className;
+
+    /** False positive status symbol */
+    uint32_t falsePositive;
+
+    /** Automatic detection status symbol */
+    uint32_t autoStatus;
+
+    /** Manual validation status symbol */
+    uint32_t manualStatus;
+
+    /** Record flags (see DetectionFile::FLAG_*) */
+    uint32_t flags;
+
+    /** First posting */
+    uint32_t postingBegin;
+
+    /** Number of postings */
+    uint32_t postingCount;
+
+    /** Reserved (zero) */
+    uint32_t reserved;
+};
+
+
+/**
+ * Image superseded by a later ingest of the same detection file.
+ *
+ */
+struct CatalogSuperseded {
+    /** Block index (earlier block) */
+    uint32_t block;
+
+    /** Image index (within block) */
+    uint32_t image;
+};
+
+
+/**
+ * Campaign-wide catalog of detected objects, stored in a single
+ * append-only file. Each ingest appends blocks; an image ingested again
+ * supersedes its previous entry. The file is memory-mapped: opening it
+ * only walks block headers and superseded images, and queries go through
+ * the indexes of each block (groups of records by class and statuses,
+ * records of each image), so that their cost follows the number of
+ * matching records.
+ *
+ * Records and images are numbered across blocks.
+ *
+ */
+class DetectionCatalog {
+public:
+    /** Current format version */
+    static const uint32_t VERSION = 2;
+
+
+    /**
+     * Object query (empty strings match any value).
+     *
+     */
+    struct Query {
+        /** Class name */
+        std::string className;
+
+        /** Automatic detection status */
+        std::string autoStatus;
+
+        /** Manual validation status */
+        std::string manualStatus;
+
+        /** False positive status */
+        std::string falsePositive;
+
+        /** Invalid objects (-1 = any, 0 = valid list only, 1 = invalid list only) */
+        int invalid;
+
+        /** Source image or detection file path substring */
+        std::string image;
+
+
+        Query() : invalid(-1) {
+        }
+    };
+
+
+protected:
+    /**
+     * Sections of a mapped block.
+     *
+     */
+    struct Block {
+        /** Block header */
+        const CatalogBlockHeader *header;
+
+        /** Images */
+        const CatalogImage *images;
+
+        /** Object records */
+        const CatalogRecord *records;
+
+        /** Groups */
+        const CatalogGroup *groups;
+
+        /** Superseded images */
+        const CatalogSuperseded *superseded;
+
+        /** Postings */
+        const uint32_t *postings;
+
+        /** Symbol offsets */
+        const uint32_t *symbols;
+
+        /** String table */
+        const char *strings;
+
+        /** First image (across blocks) */
+        uint32_t imageBase;
+
+        /** First record (across blocks) */
+        uint32_t recordBase;
+    };
+
+
+    /** Catalog filename */
+    std::string file;
+
+    /** Mapped file */
+    const unsigned char *data;
+
+    /** Mapped size in bytes */
+    size_t mapped;
+
+    /** Size of the well-formed part of the file */
+    uint64_t length;
+
+    /** Well-formed blocks */
+    std::vector<Block> blocks;
+
+    /** Superseded images (across blocks) */
+    std::unordered_set<uint32_t> superseded;
+
+    /** Number of images (superseded ones included) */
+    uint32_t imageTotal;
+
+    /** Number of records (superseded ones included) */
+    uint32_t recordTotal;
+
+
+    /**
+     * Map catalog file and walk its well-formed blocks.
+     *
+     * \param fd open catalog file descriptor
+     * \return true on success, false otherwise
+     */
+    bool map(int fd);
+
+    /**
+     * Unmap catalog file.
+     */
+    void unmap();
+
+    /**
+     * Get block of a record.
+     *
+     * \param index record index
+     * \return block
+     */
+    const Block& recordBlock(unsigned int index) const;
+
+    /**
+     * Get block of an image.
+     *
+     * \param index image index
+     * \return block
+     */
+    const Block& imageBlock(unsigned int index) const;
+
+    /**
+     * Get symbol string of a block.
+     *
+     * \param block block
+     * \param symbol symbol (within block)
+     * \return NUL-terminated string (empty if symbol is out of range)
+     */
+    static const char* string(const Block &block, uint32_t symbol);
+
+    /**
+     * Find symbol of a string in a block.
+     *
+     * \param block block
+     * \param value string value
+     * \param symbol output symbol (within block)
+     * \return true if found, false otherwise
+     */
+    static bool find(const Block &block, const std::string &value, uint32_t &symbol);
+
+
+public:
+    /**
+     * Empty constructor.
+     */
+    DetectionCatalog();
+
+    /**
+     * Destructor.
+     */
+    ~DetectionCatalog();
+
+
+    /**
+     * Open catalog file. Queries open an existing catalog read-only under
+     * a shared lock, ingest creates it if needed under an exclusive lock.
+     *
+     * \param file catalog filename
+     * \param create true to create missing catalog (for ingest)
+     * \return true on success, false otherwise
+     */
+    bool open(const std::string &file, bool create = false);
+
+    /**
+     * Ingest detection files (yaml or binary) which are new or changed
+     * since their last ingest. Files are read in parallel and appended by
+     * batches; concurrent writers are serialized by a file lock.
+     *
+     * \param files detection filenames
+     * \param ingested output number of ingested files (optional)
+     * \return true on success, false otherwise
+     */
+    bool ingest(const std::vector<std::string> &files, unsigned int *ingested = NULL);
+
+
+    /**
+     * Get number of current images.
+     *
+     * \return number of images
+     */
+    unsigned int imageCount() const {
+        return this->imageTotal - this->superseded.size();
+    }
+
+    /**
+     * Get number of object records (superseded ones included).
+     *
+     * \return number of records
+     */
+    unsigned int size() const {
+        return this->recordTotal;
+    }
+
+    /**
+     * Get object record.
+     *
+     * \param index record index
+     * \return object record
+     */
+    const CatalogRecord& record(unsigned int index) const {
+        const Block &block = this->recordBlock(index);
+
+        return block.records[index - block.recordBase];
+    }
+
+    /**
+     * Get image of object record.
+     *
+     * \param index record index
+     * \return image index
+     */
+    unsigned int recordImage(unsigned int index) const {
+        const Block &block = this->recordBlock(index);
+
+        return block.imageBase + block.records[index - block.recordBase].image;
+    }
+
+    /**
+     * Get symbol string of object record (class name or status).
+     *
+     * \param index record index
+     * \param symbol record symbol
+     * \return NUL-terminated string
+     */
+    const char* recordString(unsigned int index, uint32_t symbol) const {
+        return string(this->recordBlock(index), symbol);
+    }
+
+    /**
+     * Get image entry.
+     *
+     * \param index image index
+     * \return image entry
+     */
+    const CatalogImage& image(unsigned int index) const {
+        const Block &block = this->imageBlock(index);
+
+        return block.images[index - block.imageBase];
+    }
+
+    /**
+     * Get detection file path of image.
+     *
+     * \param index image index
+     * \return NUL-terminated string
+     */
+    const char* imagePath(unsigned int index) const {
+        return string(this->imageBlock(index), this->image(index).path);
+    }
+
+    /**
+     * Get source image filename of image.
+     *
+     * \param index image index
+     * \return NUL-terminated string
+     */
+    const char* imageSource(unsigned int index) const {
+        return string(this->imageBlock(index), this->image(index).source);
+    }
+
+    /**
+     * Get object record bounding box.
+     *
+     * \param index record index
+     * \return bounding box
+     */
+    BoundingBox area(unsigned int index) const;
+
+    /**
+     * Call function for each current object record matching query, in
+     * record order.
+     *
+     * \param query object query
+     * \param callback function called with matching record index
+     */
+    void select(const Query &query, const std::function<void(unsigned int)> &callback) const;
+
+    /**
+     * Count current object records matching query.
+     *
+     * \param query object query
+     * \return number of matching records
+     */
+    unsigned int count(const Query &query) const;
+
+
+private:
+    DetectionCatalog(const DetectionCatalog &);
+    DetectionCatalog& operator=(const DetectionCatalog &);
+};
+
+
+#endif //__YAFDB_DETECTORS_CATALOG_H_INCLUDE__
@@ -45,6 +45,10 @@
 
 #include "detector.hpp"
 #include "gnomonic.hpp"
+#include "grid.hpp"
+#include "parallel.hpp"
+#include "sampler.hpp"
+#include "store.hpp"
 
 #include <gnomonic-all.h>
 
@@ -229,6 +233,27 @@ std::vector<cv::Rect> BoundingBox::rects(int width, int height) const {
     return v;
 }
 
+bool BoundingBox::wrappedRect(int width, int height, cv::Rect &rect) const {
+    if (this->system == CARTESIAN) {
+        rect = this->rects(width, height)[0];
+        return true;
+    }
+
+    int x1 = (int)(this->p1.x / (2 * M_PI) * width);
+    int y1 = (int)((this->p1.y + M_PI / 2) / M_PI * height);
+    int x2 = (int)(this->p2.x / (2 * M_PI) * width);
+    int y2 = (int)((this->p2.y + M_PI / 2) / M_PI * height);
+
+    if (y1 > y2) {
+        return false;
+    }
+    if (x1 > x2) {
+        x2 += width;
+    }
+    rect = cv::Rect(x1, y1, x2 - x1, y2 - y1);
+    return true;
+}
+
 
 void GnomonicTransform::setup(int gnomonic_width, int gnomonic_height, double gnomonic_ax, double gnomonic_ay, double gnomonic_phi, double gnomonic_theta) {
     double rotateData1Z[3][3] = {
@@ -264,6 +289,10 @@ void GnomonicTransform::setup(int gnomonic_width, int gnomonic_height, double gn
     this->eqrRotation = cv::Mat(3, 3, CV_64F, rotateData2Z) * cv::Mat(3, 3, CV_64F, rotateData2Y);
 }
 
+void GnomonicTransform::setInterpolation(Interpolation interpolation) {
+    this->interpolation = interpolation;
+}
+
 bool GnomonicTransform::toGnomonic(double eqr_phi, double eqr_theta, int &gnomonic_x, int &gnomonic_y) const {
     double positionData[3] = {
         cos(eqr_phi) * cos(eqr_theta),
@@ -284,21 +313,211 @@ bool GnomonicTransform::toGnomonic(double eqr_phi, double eqr_theta, int &gnomon
 }
 
 void GnomonicTransform::toGnomonic(const cv::Mat &src, cv::Mat &dst) const {
-    gnomonic_etg(
-        src.data,
-        src.cols,
-        src.rows,
-        src.channels(),
-        dst.data,
-        dst.cols,
-        dst.rows,
-        dst.channels(),
-        this->gnomonic_phi,
-        -this->gnomonic_theta,
-        this->gnomonic_ax / 2.0,
-        this->gnomonic_ay / 2.0,
-        inter_bilinearf
-    );
+    if (!EqrSampler::supports(src, dst)) {
+        gnomonic_etg(
+            src.data,
+            src.cols,
+            src.rows,
+            src.channels(),
+            dst.data,
+            dst.cols,
+            dst.rows,
+            dst.channels(),
+            this->gnomonic_phi,
+            -this->gnomonic_theta,
+            this->gnomonic_ax / 2.0,
+            this->gnomonic_ay / 2.0,
+            inter_bilinearf
+        );
+        return;
+    }
+
+    this->resample(src.cols, src.rows, 0, dst, [&] (const float *x, const float *y, unsigned char *target, bool nearest) {
+        if (nearest) {
+            EqrSampler::nearest(src, x, y, target, dst.cols);
+        } else {
+            EqrSampler::bilinear(src, x, y, target, dst.cols);
+        }
+    });
+}
+
+void GnomonicTransform::toGnomonic(const EqrBlocks &src, cv::Mat &dst) const {
+    this->resample(src.cols(), src.rows(), 0, dst, [&] (const float *x, const float *y, unsigned char *target, bool nearest) {
+        if (nearest) {
+            EqrSampler::nearest(src, x, y, target, dst.cols);
+        } else {
+            EqrSampler::bilinear(src, x, y, target, dst.cols);
+        }
+    });
+}
+
+void GnomonicTransform::toGnomonic(EqrPyramid &pyramid, cv::Mat &dst) const {
+    double gnomonicPixel = 2.0 * this->gnomonic_thax / (this->gnomonic_width - 1.0);
+    int index = pyramid.levelFor(gnomonicPixel);
+    const EqrBlocks *blocks = pyramid.blockedLevel(index);
+
+    if (blocks != NULL && blocks->channels() == dst.channels() && dst.depth() == CV_8U) {
+        this->toGnomonic(*blocks, dst);
+    } else {
+        this->toGnomonic(pyramid.level(index), dst);
+    }
+}
+
+void GnomonicTransform::toGnomonic(const cv::Mat &band, int offset, int height, cv::Mat &dst) const {
+    this->resample(band.cols, height, offset, dst, [&] (const float *x, const float *y, unsigned char *target, bool nearest) {
+        if (nearest) {
+            EqrSampler::nearest(band, x, y, target, dst.cols);
+        } else {
+            EqrSampler::bilinear(band, x, y, target, dst.cols);
+        }
+    });
+}
+
+void GnomonicTransform::eqrRows(int height, int &begin, int &end) const {
+    std::vector<cv::Point2d> points;
+    double minTheta = M_PI / 2;
+    double maxTheta = -M_PI / 2;
+    int x, y;
+
+    this->footprint(17, points);
+    std::for_each(points.begin(), points.end(), [&] (const cv::Point2d &point) {
+        minTheta = MIN(minTheta, point.y);
+        maxTheta = MAX(maxTheta, point.y);
+    });
+
+    // extend to poles seen by the projection
+    if (this->toGnomonic(0, -M_PI / 2, x, y) && x >= 0 && x < this->gnomonic_width && y >= 0 && y < this->gnomonic_height) {
+        minTheta = -M_PI / 2;
+    }
+    if (this->toGnomonic(0, M_PI / 2, x, y) && x >= 0 && x < this->gnomonic_width && y >= 0 && y < this->gnomonic_height) {
+        maxTheta = M_PI / 2;
+    }
+
+    // keep a margin for sampling between footprint points
+    begin = MAX((int)floor((minTheta + M_PI / 2) / M_PI * height) - 2, 0);
+    end = MIN((int)ceil((maxTheta + M_PI / 2) / M_PI * height) + 2, height);
+}
+
+void GnomonicTransform::gnomonicCoordinates(int row, int begin, int count, int width, int height, float *x, float *y) const {
+    const double *r = (const double *)this->gnomonicRotation.data;
+    double theta = (row + 0.5) / height * M_PI - M_PI / 2.0;
+    double ct = cos(theta);
+    double st = sin(theta);
+
+    for (int i = 0; i < count; i++) {
+        double phi = (begin + i + 0.5) / width * 2.0 * M_PI;
+        double ex = cos(phi) * ct;
+        double ey = sin(phi) * ct;
+        double px = r[0] * ex + r[1] * ey + r[2] * st;
+        double py = r[3] * ex + r[4] * ey + r[5] * st;
+        double pz = r[6] * ex + r[7] * ey + r[8] * st;
+
+        if (px <= 0) {
+            x[i] = y[i] = -1e9f;
+            continue;
+        }
+        x[i] = (float)(((py / px / this->gnomonic_thax + 1.0) / 2.0) * (this->gnomonic_width - 1));
+        y[i] = (float)(((pz / px / this->gnomonic_thay + 1.0) / 2.0) * (this->gnomonic_height - 1));
+    }
+}
+
+void GnomonicTransform::resample(int width, int height, int offset, cv::Mat &dst, const std::function<void(const float *, const float *, unsigned char *, bool)> &sampler) const {
+    // compare angular pixel sizes at tile center
+    bool nearest = (this->interpolation == NEAREST);
+
+    if (this->interpolation == AUTO) {
+        double gnomonicPixel = 2.0 * this->gnomonic_thax / (this->gnomonic_width - 1.0);
+        double eqrPixel = 2.0 * M_PI / width;
+
+        nearest = (gnomonicPixel >= 2.0 * eqrPixel);
+    }
+
+    // split large windows in bands of rows
+    int grain = dst.rows;
+
+    if (dst.cols * dst.rows >= 512 * 512) {
+        grain = MAX(16, 65536 / dst.cols);
+    }
+    ThreadPool::instance().parallelFor(0, dst.rows, grain, [&] (int begin, int end) {
+        std::vector<float> x(dst.cols);
+        std::vector<float> y(dst.cols);
+
+        for (int row = begin; row < end; row++) {
+            this->eqrCoordinates(row, width, height, &x[0], &y[0]);
+            for (int i = 0; offset != 0 && i < dst.cols; i++) {
+                y[i] -= offset;
+            }
+            sampler(&x[0], &y[0], dst.ptr(row), nearest);
+        }
+    });
+}
+
+void GnomonicTransform::eqrCoordinates(int row, int width, int height, float *x, float *y) const {
+    // exact coordinates are computed every few pixels and interpolated in
+    // between, unless the interpolation error is too large (poles)
+    const int step = 16;
+    const double tolerance = 0.125;
+    const double *r = (const double *)this->eqrRotation.data;
+    const double uy = (2.0 * row / (this->gnomonic_height - 1.0) - 1.0) * this->gnomonic_thay;
+    auto exact = [&] (int column, double &ex, double &ey) {
+        double ux = (2.0 * column / (this->gnomonic_width - 1.0) - 1.0) * this->gnomonic_thax;
+        double px = r[0] + r[1] * ux + r[2] * uy;
+        double py = r[3] + r[4] * ux + r[5] * uy;
+        double pz = r[6] + r[7] * ux + r[8] * uy;
+        double phi = atan2(py, px);
+
+        if (phi < 0) {
+            phi += 2.0 * M_PI;
+        }
+        ex = phi / (2.0 * M_PI) * width - 0.5;
+        ey = (atan2(pz, sqrt(px * px + py * py)) + M_PI / 2.0) / M_PI * height - 0.5;
+    };
+    auto unwrap = [&] (double value, double reference) {
+        if (value - reference > width / 2.0) {
+            return value - width;
+        }
+        if (reference - value > width / 2.0) {
+            return value + width;
+        }
+        return value;
+    };
+    int last = this->gnomonic_width - 1;
+    double x0, y0, x1, y1, xm, ym;
+
+    exact(0, x0, y0);
+    for (int c0 = 0; c0 < last; c0 += step) {
+        int c1 = MIN(c0 + step, last);
+        int cm = (c0 + c1) / 2;
+
+        exact(c1, x1, y1);
+        exact(cm, xm, ym);
+        x1 = unwrap(x1, x0);
+
+        double t = (double)(cm - c0) / (c1 - c0);
+
+        if (fabs(unwrap(xm, x0) - (x0 + (x1 - x0) * t)) > tolerance ||
+            fabs(ym - (y0 + (y1 - y0) * t)) > tolerance) {
+            x[c0] = (float)x0;
+            y[c0] = (float)y0;
+            for (int c = c0 + 1; c < c1; c++) {
+                double ex, ey;
+
+                exact(c, ex, ey);
+                x[c] = (float)ex;
+                y[c] = (float)ey;
+            }
+        } else {
+            for (int c = c0; c < c1; c++) {
+                t = (double)(c - c0) / (c1 - c0);
+                x[c] = (float)(x0 + (x1 - x0) * t);
+                y[c] = (float)(y0 + (y1 - y0) * t);
+            }
+        }
+        x0 = x1;
+        y0 = y1;
+    }
+    x[last] = (float)x0;
+    y[last] = (float)y0;
 }
 
 bool GnomonicTransform::toEqr(int gnomonic_x, int gnomonic_y, double &eqr_phi, double &eqr_theta) const {
@@ -342,12 +561,27 @@ bool GnomonicTransform::toEqr(const BoundingBox &src, BoundingBox &dst) const {
     return false;
 }
 
+void GnomonicTransform::footprint(int samples, std::vector<cv::Point2d> &points) const {
+    for (int j = 0; j < samples; j++) {
+        int y = j * (this->gnomonic_height - 1) / MAX(samples - 1, 1);
+
+        for (int i = 0; i < samples; i++) {
+            int x = i * (this->gnomonic_width - 1) / MAX(samples - 1, 1);
+            cv::Point2d point;
+
+            if (this->toEqr(x, y, point.x, point.y)) {
+                points.push_back(point);
+            }
+        }
+    }
+}
+
 
 DetectedObject::DetectedObject(const cv::FileNode &node) : className(node["className"]), area(node["area"]), falsePositive(node["falsePositive"]), autoStatus(node["autoStatus"]), manualStatus(node["manualStatus"]) {
     auto childrenNode = node["children"];
 
     for (auto it = childrenNode.begin(); it != childrenNode.end(); ++it) {
-        this->children.push_back(*it);
+        this->children.emplace_back(*it);
     }
 }
 
@@ -373,10 +607,18 @@ void DetectedObject::addChild(const DetectedObject &child) {
     this->children.push_back(child);
 }
 
+void DetectedObject::addChild(DetectedObject &&child) {
+    this->children.push_back(std::move(child));
+}
+
 void DetectedObject::addChildren(const std::list<DetectedObject> &children) {
     this->children.insert(this->children.end(), children.begin(), children.end());
 }
 
+void DetectedObject::addChildren(std::list<DetectedObject> &&children) {
+    this->children.splice(this->children.end(), children);
+}
+
 void DetectedObject::move(double x, double y) {
     this->area.move(x, y);
     for (auto it = this->children.begin(); it != this->children.end(); ++it) {
@@ -483,7 +725,37 @@ cv::Mat DetectedObject::getRegion(const cv::Mat &source, cv::Point &offset, cv::
     return cv::Mat(source, cv::Rect(rects[0].x - bl, rects[0].y - bt, rects[0].width + bl + br, rects[0].height + bt + bb));
 }
 
+cv::Mat DetectedObject::getRegion(const WrappedEqr &source, cv::Point &offset, cv::Rect &rect, int borderSize) const {
+    const cv::Mat &padded = source.padded();
+    cv::Rect area;
+
+    if (!this->area.wrappedRect(source.image().cols, padded.rows, area) || !source.contains(area)) {
+        return this->getRegion(source.image(), offset, rect, borderSize);
+    }
+
+    int bt = MIN(borderSize, area.y);
+    int bl = MIN(borderSize, area.x);
+    int bb = MIN(borderSize, padded.rows - area.y - area.height);
+    int br = MIN(borderSize, padded.cols - area.x - area.width);
+
+    offset.x = area.x - bl;
+    offset.y = area.y - bt;
+    rect.x = bl;
+    rect.y = bt;
+    rect.width = area.width;
+    rect.height = area.height;
+    return cv::Mat(padded, cv::Rect(offset.x, offset.y, area.width + bl + br, area.height + bt + bb));
+}
+
 cv::Mat DetectedObject::getGnomonicRegion(const cv::Mat &source, GnomonicTransform &transform, cv::Rect &rect, int gnomonicWidth, double extraAperture) const {
+    EqrPyramid pyramid(source, source.cols);
+
+    return this->getGnomonicRegion(pyramid, transform, rect, gnomonicWidth, extraAperture);
+}
+
+cv::Mat DetectedObject::getGnomonicRegion(EqrPyramid &pyramid, GnomonicTransform &transform, cv::Rect &rect, int gnomonicWidth, double extraAperture) const {
+    const cv::Mat &source = pyramid.level(0);
+
     // check coordinates system
     if (this->area.system != BoundingBox::SPHERICAL || this->area.width() == 0) {
         return cv::Mat(0, 0, source.type());
@@ -512,7 +784,7 @@ cv::Mat DetectedObject::getGnomonicRegion(const cv::Mat &source, GnomonicTransfo
     cv::Mat window((int)((double)gnomonicWidth * ay / ax), gnomonicWidth, source.type());
 
     transform.setup(window.cols, window.rows, ax, ay, x, y);
-    transform.toGnomonic(source, window);
+    transform.toGnomonic(pyramid, window);
     if (transform.toGnomonic(this->area.p1.x, this->area.p1.y, rect.x, rect.y) &&
         transform.toGnomonic(this->area.p2.x, this->area.p2.y, rect.width, rect.height)) {
         rect.width -= rect.x;
@@ -531,44 +803,50 @@ bool ObjectDetector::detect(const cv::Mat &source, std::list<DetectedObject> &ob
     return false;
 }
 
-bool ObjectDetector::load(const std::string &file, std::list<DetectedObject> &objects) {
-    cv::FileStorage fs(file, cv::FileStorage::READ);
-
-    if (!fs.isOpened()) {
-        return false;
-    }
+bool ObjectDetector::acceptsTile(const GnomonicTransform &tile) const {
+    return true;
+}
 
-    auto objectsNode = fs["objects"];
+bool ObjectDetector::detectTile(const cv::Mat &source, const GnomonicTransform &tile, std::list<DetectedObject> &objects) {
+    return this->detect(source, objects);
+}
 
-    for (auto it = objectsNode.begin(); it != objectsNode.end(); ++it) {
-        objects.push_back(*it);
-    }
+bool ObjectDetector::load(const std::string &file, std::list<DetectedObject> &objects) {
+    DetectionStore store;
 
-    auto objectsNode_inv = fs["invalidObjects"];
-    for (auto it = objectsNode_inv.begin(); it != objectsNode_inv.end(); ++it) {
-        objects.push_back(*it);
+    if (!store.load(file)) {
+        return false;
     }
-
+    store.toList(objects);
     return true;
 }
 
 void ObjectDetector::merge(std::list<DetectedObject> &objects, int minOverlap) {
-    std::vector<DetectedObject> v(objects.begin(), objects.end());
-    std::set<unsigned int> used;
+    std::vector<DetectedObject> v(std::make_move_iterator(objects.begin()), std::make_move_iterator(objects.end()));
+    std::vector<BoundingBox> boxes;
+    std::vector<unsigned int> candidates;
+    std::vector<bool> used(v.size(), false);
+
+    for (unsigned int i = 0; i < v.size(); i++) {
+        boxes.push_back(v[i].area);
+    }
+
+    BoxGrid grid(boxes);
 
     objects.clear();
     for (unsigned int i = 0; i < v.size(); i++) {
-        if (used.find(i) != used.end()) {
+        if (used[i]) {
             continue;
         }
-        used.insert(i);
+        used[i] = true;
+        grid.remove(i);
 
         BoundingBox area(v[i].area);
         std::set<std::string> classNames;
         std::set<std::string> falsePositives;
         std::set<std::string> autoStatuses;
         std::set<std::string> manualStatuses;
-        std::list<DetectedObject> children(v[i].children);
+        std::list<DetectedObject> children(std::move(v[i].children));
         int count = 1;
 
         classNames.insert(v[i].className);
@@ -576,19 +854,29 @@ void ObjectDetector::merge(std::list<DetectedObject> &objects, int minOverlap) {
         autoStatuses.insert(v[i].autoStatus);
         manualStatuses.insert(v[i].manualStatus);
 
-        for (unsigned int j = i + 1; j < v.size(); j++) {
-            if (used.find(j) != used.end()) {
-                continue;
-            }
-            if (area.mergeIfOverlap(v[j].area)) {
-                classNames.insert(v[j].className);
-                falsePositives.insert(v[j].falsePositive);
-                autoStatuses.insert(v[j].autoStatus);
-                manualStatuses.insert(v[j].manualStatus);
-                children.insert(children.end(), v[j].children.begin(), v[j].children.end());
-                used.insert(j);
-                count++;
-                j = i;
+        // absorb the first unused object overlapping the (growing) area,
+        // looking only at grid candidates, until none is left
+        for (bool merged = true; merged; ) {
+            merged = false;
+            grid.query(area, candidates);
+            for (auto it = candidates.begin(); it != candidates.end(); ++it) {
+                unsigned int j = *it;
+
+                if (used[j]) {
+                    continue;
+                }
+                if (area.mergeIfOverlap(v[j].area)) {
+                    classNames.insert(v[j].className);
+                    falsePositives.insert(v[j].falsePositive);
+                    autoStatuses.insert(v[j].autoStatus);
+                    manualStatuses.insert(v[j].manualStatus);
+                    children.splice(children.end(), v[j].children);
+                    used[j] = true;
+                    grid.remove(j);
+                    count++;
+                    merged = true;
+                    break;
+                }
             }
         }
 
@@ -634,7 +922,7 @@ void ObjectDetector::merge(std::list<DetectedObject> &objects, int minOverlap) {
 
             ObjectDetector::merge(children);
 
-            objects.push_back(DetectedObject(className, area, falsePositiveName, autoStatusName, manualStatusName, children));
+            objects.emplace_back(std::move(className), area, std::move(falsePositiveName), std::move(autoStatusName), std::move(manualStatusName), std::move(children));
         }
     }
 }
@@ -662,6 +950,7 @@ void ObjectDetector::exportImages(const std::string &exportPath, const std::stri
 
     // export object writer
     cv::FileStorage fs(exportPath + "/" + timestamp + ".yaml", cv::FileStorage::WRITE);
+    EqrPyramid pyramid(source);
 
     std::function<void(const DetectedObject &, const std::string &)> writeObject = [&] (const DetectedObject &object, const std::string &objectSuffix) {
         // TODO: clean invalid characters
@@ -713,7 +1002,7 @@ void ObjectDetector::exportImages(const std::string &exportPath, const std::stri
         if (object.area.isSpherical()) {
             GnomonicTransform transform;
             cv::Rect rect;
-            cv::Mat region(object.getGnomonicRegion(source, transform, rect, 1024, 5.0 * M_PI / 180.0));
+            cv::Mat region(object.getGnomonicRegion(pyramid, transform, rect, 1024, 5.0 * M_PI / 180.0));
 
             rect.x = MAX(rect.x, 0);
             rect.y = MAX(rect.y, 0);
@@ -43,6 +43,7 @@
 
 
 #include <bitset>
+#include <functional>
 #include <list>
 #include <memory>
 #include <string>
@@ -50,6 +51,9 @@
 
 #include <opencv2/opencv.hpp>
 
+#include "pyramid.hpp"
+#include "wrapped.hpp"
+
 
 /**
  * A generic bounding box.
@@ -119,14 +123,6 @@ public:
     BoundingBox(const cv::Rect &rect) : system(CARTESIAN), p1(rect.tl().x, rect.tl().y), p2(rect.br().x, rect.br().y) {
     }
 
-    /**
-     * Copy constructor.
-     *
-     * \param ref reference object
-     */
-    BoundingBox(const BoundingBox &ref) : system(ref.system), p1(ref.p1), p2(ref.p2) {
-    }
-
     /**
      * Storage constructor.
      *
@@ -200,10 +196,27 @@ public:
      * \return opencv rectangle(s)
      */
     std::vector<cv::Rect> rects(int width, int height) const;
+
+    /**
+     * Convert bounding box to a single opencv rectangle in an eqr image
+     * horizontally wrapped past its right side (see WrappedEqr). Areas
+     * crossing the 0/2pi seam extend past the image width.
+     *
+     * \param width target image width
+     * \param height target image height
+     * \param rect output rectangle
+     * \return false if area crosses a pole (no single rectangle)
+     */
+    bool wrappedRect(int width, int height, cv::Rect &rect) const;
 };
 
 
 class GnomonicTransform {
+public:
+    /** Resampling method used to compute gnomonic projection */
+    enum Interpolation { AUTO = 1, BILINEAR, NEAREST };
+
+
 protected:
     /** Width in pixels of gnomonic projection */
     int gnomonic_width;
@@ -235,13 +248,39 @@ protected:
     /** Rotation from gnomonic to eqr */
     cv::Mat eqrRotation;
 
+    /** Resampling method */
+    Interpolation interpolation;
+
+
+    /**
+     * Compute eqr source coordinates of a row of gnomonic pixels.
+     *
+     * \param row gnomonic row
+     * \param width eqr width in pixels
+     * \param height eqr height in pixels
+     * \param x output eqr x coordinates (in pixels)
+     * \param y output eqr y coordinates (in pixels)
+     */
+    void eqrCoordinates(int row, int width, int height, float *x, float *y) const;
+
+    /**
+     * Compute whole gnomonic projection with given row sampler.
+     *
+     * \param width eqr width in pixels
+     * \param height eqr height in pixels
+     * \param offset index of first eqr row available to sampler
+     * \param dst gnomonic target
+     * \param sampler row sampler (x, y coordinates, target row, nearest neighbour flag)
+     */
+    void resample(int width, int height, int offset, cv::Mat &dst, const std::function<void(const float *, const float *, unsigned char *, bool)> &sampler) const;
+
 
 public:
     /**
      * Empty constructor.
      *
      */
-    GnomonicTransform() : gnomonic_width(0), gnomonic_height(0), gnomonic_ax(0), gnomonic_ay(0), gnomonic_phi(0), gnomonic_theta(0), gnomonic_thax(0), gnomonic_thay(0) {
+    GnomonicTransform() : gnomonic_width(0), gnomonic_height(0), gnomonic_ax(0), gnomonic_ay(0), gnomonic_phi(0), gnomonic_theta(0), gnomonic_thax(0), gnomonic_thay(0), interpolation(AUTO) {
     }
 
     /**
@@ -254,7 +293,7 @@ public:
      * \param gnomonic_phi gnomonic center azimuthal angle (in radian)
      * \param gnomonic_theta gnomonic center polar angle (in radian)
      */
-    GnomonicTransform(int gnomonic_width, int gnomonic_height, double gnomonic_ax, double gnomonic_ay, double gnomonic_phi, double gnomonic_theta) : gnomonic_width(0), gnomonic_height(0), gnomonic_ax(0), gnomonic_ay(0), gnomonic_phi(0), gnomonic_theta(0), gnomonic_thax(0), gnomonic_thay(0) {
+    GnomonicTransform(int gnomonic_width, int gnomonic_height, double gnomonic_ax, double gnomonic_ay, double gnomonic_phi, double gnomonic_theta) : gnomonic_width(0), gnomonic_height(0), gnomonic_ax(0), gnomonic_ay(0), gnomonic_phi(0), gnomonic_theta(0), gnomonic_thax(0), gnomonic_thay(0), interpolation(AUTO) {
         this->setup(gnomonic_width, gnomonic_height, gnomonic_ax, gnomonic_ay, gnomonic_phi, gnomonic_theta);
     }
 
@@ -263,7 +302,7 @@ public:
      *
      * \param ref other transform
      */
-    GnomonicTransform(const GnomonicTransform &ref) : gnomonic_width(ref.gnomonic_width), gnomonic_height(ref.gnomonic_height), gnomonic_ax(ref.gnomonic_ax), gnomonic_ay(ref.gnomonic_ay), gnomonic_phi(ref.gnomonic_phi), gnomonic_theta(ref.gnomonic_theta), gnomonic_thax(ref.gnomonic_thax), gnomonic_thay(ref.gnomonic_thay), gnomonicRotation(ref.gnomonicRotation), eqrRotation(ref.eqrRotation) {
+    GnomonicTransform(const GnomonicTransform &ref) : gnomonic_width(ref.gnomonic_width), gnomonic_height(ref.gnomonic_height), gnomonic_ax(ref.gnomonic_ax), gnomonic_ay(ref.gnomonic_ay), gnomonic_phi(ref.gnomonic_phi), gnomonic_theta(ref.gnomonic_theta), gnomonic_thax(ref.gnomonic_thax), gnomonic_thay(ref.gnomonic_thay), gnomonicRotation(ref.gnomonicRotation), eqrRotation(ref.eqrRotation), interpolation(ref.interpolation) {
     }
 
 
@@ -279,6 +318,15 @@ public:
      */
     void setup(int gnomonic_width, int gnomonic_height, double gnomonic_ax, double gnomonic_ay, double gnomonic_phi, double gnomonic_theta);
 
+    /**
+     * Select resampling method. In automatic mode, nearest neighbour is used
+     * when the projection downsamples the source by a factor of 2 or more,
+     * bilinear otherwise.
+     *
+     * \param interpolation resampling method
+     */
+    void setInterpolation(Interpolation interpolation);
+
 
     /**
      * Project a point from eqr to gnomonic.
@@ -299,6 +347,58 @@ public:
      */
     void toGnomonic(const cv::Mat &src, cv::Mat &dst) const;
 
+    /**
+     * Compute whole gnomonic projection from the pyramid level matching
+     * the angular pixel size of the projection.
+     *
+     * \param pyramid eqr source pyramid
+     * \param dst gnomonic target (must be of correct size)
+     */
+    void toGnomonic(EqrPyramid &pyramid, cv::Mat &dst) const;
+
+    /**
+     * Compute whole gnomonic projection from blocked storage.
+     *
+     * \param src blocked eqr source
+     * \param dst gnomonic target (must be of correct size, 8-bit, same channels)
+     */
+    void toGnomonic(const EqrBlocks &src, cv::Mat &dst) const;
+
+    /**
+     * Compute whole gnomonic projection from a band of eqr rows (which must
+     * cover rows returned by eqrRows()).
+     *
+     * \param band eqr rows (full width)
+     * \param offset index of first row of band
+     * \param height eqr height in pixels
+     * \param dst gnomonic target (must be of correct size, 8-bit, same channels)
+     */
+    void toGnomonic(const cv::Mat &band, int offset, int height, cv::Mat &dst) const;
+
+    /**
+     * Get range of eqr rows sampled by whole gnomonic projection.
+     *
+     * \param height eqr height in pixels
+     * \param begin output first row
+     * \param end output last row (excluded)
+     */
+    void eqrRows(int height, int &begin, int &end) const;
+
+    /**
+     * Compute gnomonic coordinates of a span of eqr pixels (pixel centers).
+     * Pixels behind the projection plane get negative coordinates far out
+     * of the projection.
+     *
+     * \param row eqr row
+     * \param begin first eqr column (columns wrap around the image width)
+     * \param count number of pixels
+     * \param width eqr width in pixels
+     * \param height eqr height in pixels
+     * \param x output gnomonic x coordinates (in pixels)
+     * \param y output gnomonic y coordinates (in pixels)
+     */
+    void gnomonicCoordinates(int row, int begin, int count, int width, int height, float *x, float *y) const;
+
 
     /**
      * Project a point from gnomonic to eqr.
@@ -319,6 +419,14 @@ public:
      * \return true if projection is conform, false otherwise
      */
     bool toEqr(const BoundingBox &src, BoundingBox &dst) const;
+
+    /**
+     * Sample gnomonic area footprint in eqr.
+     *
+     * \param samples number of samples along each axis
+     * \param points output eqr coordinates (x = azimuthal angle, y = polar angle, in radian)
+     */
+    void footprint(int samples, std::vector<cv::Point2d> &points) const;
 };
 
 
@@ -362,7 +470,7 @@ public:
      * \param autoStatus Status of automatic detection
      * \param manualStatus Status of manual validation
      */
-    DetectedObject(const std::string &className, const BoundingBox &area, const std::string &falsePositive, const std::string &autoStatus, const std::string &manualStatus) : className(className), area(area), falsePositive(falsePositive), autoStatus(autoStatus), manualStatus(manualStatus) {
+    DetectedObject(std::string className, const BoundingBox &area, std::string falsePositive, std::string autoStatus, std::string manualStatus) : className(std::move(className)), area(area), falsePositive(std::move(falsePositive)), autoStatus(std::move(autoStatus)), manualStatus(std::move(manualStatus)) {
     }
 
     /**
@@ -375,13 +483,7 @@ public:
      * \param manualStatus Status of manual validation
      * \param children children objects
      */
-    DetectedObject(const std::string &className, const BoundingBox &area, const std::string &falsePositive, const std::string &autoStatus, const std::string &manualStatus, const std::list<DetectedObject> &children) : className(className), area(area), falsePositive(falsePositive), autoStatus(autoStatus), manualStatus(manualStatus), children(children) {
-    }
-
-    /**
-     * Copy constructor.
-     */
-    DetectedObject(const DetectedObject &ref) : className(ref.className), area(ref.area), falsePositive(ref.falsePositive), autoStatus(ref.autoStatus), manualStatus(ref.manualStatus), children(ref.children) {
+    DetectedObject(std::string className, const BoundingBox &area, std::string falsePositive, std::string autoStatus, std::string manualStatus, std::list<DetectedObject> children) : className(std::move(className)), area(area), falsePositive(std::move(falsePositive)), autoStatus(std::move(autoStatus)), manualStatus(std::move(manualStatus)), children(std::move(children)) {
     }
 
     /**
@@ -406,6 +508,13 @@ public:
      */
     void addChild(const DetectedObject &child);
 
+    /**
+     * Add a child detection (moved).
+     *
+     * \param child child object
+     */
+    void addChild(DetectedObject &&child);
+
     /**
      * Add children detection.
      *
@@ -413,6 +522,13 @@ public:
      */
     void addChildren(const std::list<DetectedObject> &children);
 
+    /**
+     * Add children detection (moved, list nodes are reused).
+     *
+     * \param children child objects
+     */
+    void addChildren(std::list<DetectedObject> &&children);
+
     /**
      * Move object coordinates.
      *
@@ -432,6 +548,19 @@ public:
      */
     cv::Mat getRegion(const cv::Mat &source, cv::Point &offset, cv::Rect &rect, int borderSize = 0) const;
 
+    /**
+     * Get detected object region from a wrap-padded eqr image. Regions
+     * fitting in the padded buffer are returned as views without copy
+     * (their offset may then extend past the image width).
+     *
+     * \param source wrap-padded source image
+     * \param offset output image offset in padded buffer
+     * \param rect output rectangle of object in returned image
+     * \param borderSize extra border size
+     * \return detected object region
+     */
+    cv::Mat getRegion(const WrappedEqr &source, cv::Point &offset, cv::Rect &rect, int borderSize = 0) const;
+
     /**
      * Get detected object region in gnomonic projection.
      *
@@ -443,6 +572,18 @@ public:
      * \return detected object region (in gnomonic projection)
      */
     cv::Mat getGnomonicRegion(const cv::Mat &source, GnomonicTransform &transform, cv::Rect &rect, int gnomonicWidth = 1024, double extraAperture = 0.0) const;
+
+    /**
+     * Get detected object region in gnomonic projection.
+     *
+     * \param pyramid source image pyramid (in eqr projection)
+     * \param transform output gnomonic transform
+     * \param rect output rectangle of object in returned image
+     * \param gnomonicWidth width of gnomonic image
+     * \param extraAperture extra aperture angle (in radian)
+     * \return detected object region (in gnomonic projection)
+     */
+    cv::Mat getGnomonicRegion(EqrPyramid &pyramid, GnomonicTransform &transform, cv::Rect &rect, int gnomonicWidth = 1024, double extraAperture = 0.0) const;
 };
 
 
@@ -481,11 +622,31 @@ public:
      */
     virtual bool detect(const cv::Mat &source, std::list<DetectedObject> &objects);
 
+    /**
+     * Check if this object detector may find objects within given gnomonic
+     * tile.
+     *
+     * \param tile gnomonic transform of the tile
+     * \return true if tile must be scanned, false if it can be skipped
+     */
+    virtual bool acceptsTile(const GnomonicTransform &tile) const;
+
+    /*
+     * Execute object detector against given gnomonic tile.
+     *
+     * \param source tile image to scan for objects
+     * \param tile gnomonic transform of the tile
+     * \param objects output list of detected objects (in tile coordinates)
+     * \return true on success, false otherwise
+     */
+    virtual bool detectTile(const cv::Mat &source, const GnomonicTransform &tile, std::list<DetectedObject> &objects);
+
 
     /**
-     * Load detected objects from yaml file.
+     * Load detected objects from yaml or binary (.ydb) file (read through
+     * a DetectionStore, see DetectionStore::load).
      *
-     * \param file yaml filename
+     * \param file yaml or binary detection filename
      * \param objects output list of detected objects
      * \return true on success, false otherwise
      */
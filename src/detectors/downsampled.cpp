@@ -0,0 +1,189 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "downsampled.hpp"
+
+
+/**
+ * Integer division rounded towards minus infinity.
+ *
+ */
+static inline int floorDiv(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+int DownsampledBlur::factorFor(double sigma) {
+    return MAX((int)(sigma / 2), 1);
+}
+
+int DownsampledBlur::halo(double sigma, int factor) {
+    return (int)ceil(3 * sigma) + 5 * MAX(factor, 1);
+}
+
+void DownsampledBlur::blur(cv::Mat &image, const cv::Point &origin, const cv::Rect &target, double sigma, int factor) {
+    cv::Rect area(target & cv::Rect(0, 0, image.cols, image.rows));
+    int channels = image.channels();
+    int f = MAX(factor, 1);
+
+    if (area.width <= 0 || area.height <= 0) {
+        return;
+    }
+
+    // cell averaging and bilinear upsampling already blur by about
+    // f^2 / 4 of variance, the cells get the remainder
+    double variance = sigma * sigma - ((f * f - 1) / 12.0 + f * f / 6.0);
+    double lowSigma = MAX(sqrt(MAX(variance, 0.0)) / f, 0.5);
+    int radius = (int)ceil(3 * lowSigma);
+    int spare = radius + 1;
+
+    // cells covering target, its bilinear neighbours and the cell blur
+    int cx0 = MAX(floorDiv(origin.x + area.x, f) - spare, floorDiv(origin.x, f));
+    int cx1 = MIN(floorDiv(origin.x + area.x + area.width - 1, f) + spare, floorDiv(origin.x + image.cols - 1, f));
+    int cy0 = MAX(floorDiv(origin.y + area.y, f) - spare, floorDiv(origin.y, f));
+    int cy1 = MIN(floorDiv(origin.y + area.y + area.height - 1, f) + spare, floorDiv(origin.y + image.rows - 1, f));
+    int cw = cx1 - cx0 + 1;
+    int ch = cy1 - cy0 + 1;
+    int stride = cw * channels;
+    std::vector<float> cells(ch * stride, 0.0f);
+
+    // average pixels of each cell (cells cut by image borders average
+    // the pixels they hold)
+    for (int cy = 0; cy < ch; cy++) {
+        int py0 = MAX((cy0 + cy) * f - origin.y, 0);
+        int py1 = MIN((cy0 + cy + 1) * f - origin.y, image.rows);
+        float *cell = &cells[cy * stride];
+
+        for (int cx = 0; cx < cw; cx++) {
+            int px0 = MAX((cx0 + cx) * f - origin.x, 0);
+            int px1 = MIN((cx0 + cx + 1) * f - origin.x, image.cols);
+            float sums[4] = { 0, 0, 0, 0 };
+            float *dst = cell + cx * channels;
+
+            for (int py = py0; py < py1; py++) {
+                const unsigned char *src = image.ptr<unsigned char>(py) + px0 * channels;
+
+                for (int i = 0; i < (px1 - px0) * channels; i++) {
+                    sums[i % channels] += src[i];
+                }
+            }
+            for (int c = 0; c < channels; c++) {
+                dst[c] = sums[c] / ((py1 - py0) * (px1 - px0));
+            }
+        }
+    }
+
+    // separable gaussian over cells, borders replicated
+    std::vector<float> kernel(2 * radius + 1);
+    float total = 0;
+
+    for (int i = -radius; i <= radius; i++) {
+        kernel[i + radius] = (float)exp(-i * i / (2 * lowSigma * lowSigma));
+        total += kernel[i + radius];
+    }
+    for (int i = 0; i <= 2 * radius; i++) {
+        kernel[i] /= total;
+    }
+
+    std::vector<float> rows(ch * stride, 0.0f);
+
+    for (int cy = 0; cy < ch; cy++) {
+        for (int cx = 0; cx < cw; cx++) {
+            float *dst = &rows[cy * stride + cx * channels];
+
+            for (int i = -radius; i <= radius; i++) {
+                const float *src = &cells[cy * stride + MIN(MAX(cx + i, 0), cw - 1) * channels];
+
+                for (int c = 0; c < channels; c++) {
+                    dst[c] += kernel[i + radius] * src[c];
+                }
+            }
+        }
+    }
+    std::fill(cells.begin(), cells.end(), 0.0f);
+    for (int cy = 0; cy < ch; cy++) {
+        float *dst = &cells[cy * stride];
+
+        for (int i = -radius; i <= radius; i++) {
+            const float *src = &rows[MIN(MAX(cy + i, 0), ch - 1) * stride];
+
+            for (int k = 0; k < stride; k++) {
+                dst[k] += kernel[i + radius] * src[k];
+            }
+        }
+    }
+
+    // bilinear upsampling from cell centers
+    std::vector<int> left(area.width), right(area.width);
+    std::vector<float> weight(area.width);
+
+    for (int x = 0; x < area.width; x++) {
+        float u = (origin.x + area.x + x + 0.5f) / f - 0.5f;
+        int i = (int)floor(u);
+
+        weight[x] = u - i;
+        left[x] = MIN(MAX(i - cx0, 0), cw - 1) * channels;
+        right[x] = MIN(MAX(i + 1 - cx0, 0), cw - 1) * channels;
+    }
+    for (int y = 0; y < area.height; y++) {
+        float v = (origin.y + area.y + y + 0.5f) / f - 0.5f;
+        int j = (int)floor(v);
+        float t = v - j;
+        const float *top = &cells[MIN(MAX(j - cy0, 0), ch - 1) * stride];
+        const float *bottom = &cells[MIN(MAX(j + 1 - cy0, 0), ch - 1) * stride];
+        unsigned char *dst = image.ptr<unsigned char>(area.y + y) + area.x * channels;
+
+        for (int x = 0; x < area.width; x++, dst += channels) {
+            float s = weight[x];
+
+            for (int c = 0; c < channels; c++) {
+                float a = top[left[x] + c] + s * (top[right[x] + c] - top[left[x] + c]);
+                float b = bottom[left[x] + c] + s * (bottom[right[x] + c] - bottom[left[x] + c]);
+                float value = a + t * (b - a) + 0.5f;
+
+                dst[c] = (unsigned char)(value < 0 ? 0 : (value > 255 ? 255 : value));
+            }
+        }
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+
+#ifndef __YAFDB_DETECTORS_DOWNSAMPLED_H_INCLUDE__
+#define __YAFDB_DETECTORS_DOWNSAMPLED_H_INCLUDE__
+
+
+#include <opencv2/opencv.hpp>
+
+
+/**
+ * Strong gaussian blur computed at low resolution: the image is averaged
+ * over cells of factor x factor pixels, the cells are blurred with the
+ * remaining sigma and the result is bilinearly upsampled. Cells are
+ * aligned on absolute image coordinates so that adjacent areas blurred
+ * separately join without seams.
+ *
+ */
+class DownsampledBlur {
+public:
+    /**
+     * Default downsampling factor for a sigma (cells stay below the blur
+     * radius by a wide margin).
+     *
+     * \param sigma gaussian sigma
+     * \return downsampling factor
+     */
+    static int factorFor(double sigma);
+
+    /**
+     * Pixels read around blurred area.
+     *
+     * \param sigma gaussian sigma
+     * \param factor downsampling factor
+     * \return halo in pixels
+     */
+    static int halo(double sigma, int factor);
+
+    /**
+     * Blur image area in place.
+     *
+     * \param image image to blur (8-bit, 1 to 4 channels)
+     * \param origin position of image in full image (cell alignment)
+     * \param target area to blur
+     * \param sigma gaussian sigma
+     * \param factor downsampling factor
+     */
+    static void blur(cv::Mat &image, const cv::Point &origin, const cv::Rect &target, double sigma, int factor);
+};
+
+
+#endif //__YAFDB_DETECTORS_DOWNSAMPLED_H_INCLUDE__
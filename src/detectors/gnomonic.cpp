@@ -40,25 +40,121 @@
 #include "gnomonic.hpp"
 
 
+GnomonicProjectionDetector* GnomonicProjectionDetector::addBand(const std::shared_ptr<ObjectDetector> &detector, int width, double ax, double ay) {
+    this->bands.push_back({detector, width, (int)(width * ay / ax), ax, ay, std::shared_ptr<TilePrior>()});
+    return this;
+}
+
 bool GnomonicProjectionDetector::supportsColor() const {
-    return !this->detector || this->detector->supportsColor();
+    return std::any_of(this->bands.begin(), this->bands.end(), [] (const TilingConfig &band) {
+        return !band.detector || band.detector->supportsColor();
+    });
+}
+
+bool GnomonicProjectionDetector::setPrior(const std::vector<std::shared_ptr<TilePrior>> &priors, double skip, double low, double scale) {
+    for (auto band = this->bands.begin(); band != this->bands.end(); ++band) {
+        auto prior = std::find_if(priors.begin(), priors.end(), [&] (const std::shared_ptr<TilePrior> &prior) {
+            return prior->matches(band->ax, band->ay);
+        });
+
+        if (prior == priors.end()) {
+            return false;
+        }
+        band->prior = *prior;
+    }
+    this->priorSkip = skip;
+    this->priorLow = low;
+    this->priorScale = scale;
+    return true;
+}
+
+void GnomonicProjectionDetector::setInterpolation(GnomonicTransform::Interpolation interpolation) {
+    this->interpolation = interpolation;
+}
+
+void GnomonicProjectionDetector::setBlockedSource(bool blocked) {
+    this->blocked = blocked;
+}
+
+void GnomonicProjectionDetector::setTileCallback(const std::function<void(std::list<DetectedObject> &)> &callback) {
+    this->tileCallback = callback;
 }
 
 bool GnomonicProjectionDetector::detect(const cv::Mat &source, std::list<DetectedObject> &objects) {
-    cv::Mat window(this->height, this->width, source.type());
+    // tiles sample the pyramid level matching their resolution
+    EqrPyramid pyramid(source, 256, this->blocked);
+    auto project = [&] (const GnomonicTransform &transform, cv::Mat &window) {
+        transform.toGnomonic(pyramid, window);
+        return true;
+    };
+
+    this->skipped.clear();
+    return std::all_of(this->bands.begin(), this->bands.end(), [&] (const TilingConfig &band) {
+        this->skipped.push_back({band.ax, band.ay, std::vector<cv::Point2d>()});
+        return this->detectBand(source.type(), band, project, objects, this->skipped.back().tiles);
+    });
+}
+
+bool GnomonicProjectionDetector::detect(EqrSource &source, std::list<DetectedObject> &objects) {
+    // tiles are scanned by latitude, only rows they need are decoded
+    cv::Mat rows;
+    int rowsBegin = 0;
+    int rowsEnd = 0;
+    auto project = [&] (const GnomonicTransform &transform, cv::Mat &window) {
+        int begin, end;
+
+        transform.eqrRows(source.rows(), begin, end);
+        if (begin < rowsBegin || end > rowsEnd) {
+            rows.release();
+            rows = source.band(begin, end);
+            if (rows.empty()) {
+                return false;
+            }
+            rowsBegin = begin;
+            rowsEnd = end;
+        }
+        transform.toGnomonic(rows, rowsBegin, source.rows(), window);
+        return true;
+    };
+    this->skipped.clear();
+    return std::all_of(this->bands.begin(), this->bands.end(), [&] (const TilingConfig &band) {
+        this->skipped.push_back({band.ax, band.ay, std::vector<cv::Point2d>()});
+        return this->detectBand(source.type(), band, project, objects, this->skipped.back().tiles);
+    });
+}
+
+bool GnomonicProjectionDetector::detectBand(int type, const TilingConfig &band, const std::function<bool(const GnomonicTransform &, cv::Mat &)> &project, std::list<DetectedObject> &objects, std::vector<cv::Point2d> &skipped) {
+    cv::Mat fullWindow(band.height, band.width, type);
+    cv::Mat lowWindow(MAX((int)(band.height * this->priorScale), 1), MAX((int)(band.width * this->priorScale), 1), type);
 
     // scan the whole source image in eqr projection
-    for (double y = M_PI / 2; y >= -M_PI / 2; y -= this->hay) {
-        for (double x = 0; x < 2 * M_PI; x += this->hax) {
+    for (double y = M_PI / 2; y >= -M_PI / 2; y -= band.ay / 2) {
+        for (double x = 0; x < 2 * M_PI; x += band.ax / 2) {
+            // lower resolution or skip unproductive tiles
+            double rate = band.prior ? band.prior->rate(x, y) : 1;
+            cv::Mat &window = rate < this->priorLow ? lowWindow : fullWindow;
+
+            if (rate < this->priorSkip) {
+                skipped.push_back(cv::Point2d(x, y));
+                continue;
+            }
+
             // gnomonic projection of current area
-            GnomonicTransform transform(window.cols, window.rows, this->ax, this->ay, x, y);
+            GnomonicTransform transform(window.cols, window.rows, band.ax, band.ay, x, y);
 
-            transform.toGnomonic(source, window);
+            transform.setInterpolation(this->interpolation);
+            if (band.detector && !band.detector->acceptsTile(transform)) {
+                skipped.push_back(cv::Point2d(x, y));
+                continue;
+            }
+            if (!project(transform, window)) {
+                return false;
+            }
 
             // detect objects within reprojected area
             std::list<DetectedObject> window_objects;
 
-            if (this->detector && !this->detector->detect(window, window_objects)) {
+            if (band.detector && !band.detector->detectTile(window, transform, window_objects)) {
                 return false;
             }
 
@@ -77,11 +173,19 @@ bool GnomonicProjectionDetector::detect(const cv::Mat &source, std::list<Detecte
                 return false;
             };
 
-            std::for_each(window_objects.begin(), window_objects.end(), [&] (DetectedObject &object) {
-                if (eqrMapper(object)) {
-                    objects.push_back(object);
+            std::list<DetectedObject> tile_objects;
+
+            for (auto it = window_objects.begin(); it != window_objects.end(); ) {
+                if (eqrMapper(*it)) {
+                    tile_objects.splice(tile_objects.end(), window_objects, it++);
+                } else {
+                    ++it;
                 }
-            });
+            }
+            if (this->tileCallback && !tile_objects.empty()) {
+                this->tileCallback(tile_objects);
+            }
+            objects.splice(objects.end(), tile_objects);
         }
     }
     return true;
@@ -42,6 +42,8 @@
 
 
 #include "detector.hpp"
+#include "prior.hpp"
+#include "source.hpp"
 
 
 /**
@@ -49,34 +51,79 @@
  *
  */
 class GnomonicProjectionDetector : public ObjectDetector {
+public:
+    /**
+     * Tiles skipped in one tiling configuration.
+     *
+     */
+    typedef struct {
+        /** Projection window horizontal aperture in radian */
+        double ax;
+
+        /** Projection window vertical aperture in radian **/
+        double ay;
+
+        /** Skipped tile centers (x = azimuthal angle, y = polar angle, in radian) */
+        std::vector<cv::Point2d> tiles;
+    } SkippedTiles;
+
+
 protected:
-    /** Underlying object detector */
-    std::shared_ptr<ObjectDetector> detector;
+    /**
+     * Tiling configuration (scale band).
+     *
+     */
+    typedef struct {
+        /** Underlying object detector */
+        std::shared_ptr<ObjectDetector> detector;
+
+        /** Projection window width */
+        int width;
+
+        /** Projection window height */
+        int height;
+
+        /** Projection window horizontal aperture in radian */
+        double ax;
+
+        /** Projection window vertical aperture in radian **/
+        double ay;
+
+        /** Tile hit-rate prior of this tiling (optional) */
+        std::shared_ptr<TilePrior> prior;
+    } TilingConfig;
 
-    /** Projection window width */
-    int width;
+    /** Tiling configurations scanned one after the other */
+    std::list<TilingConfig> bands;
 
-    /** Projection window height */
-    int height;
+    /** Hit-rate under which tiles are skipped */
+    double priorSkip;
 
-    /** Projection window horizontal aperture in radian */
-    double ax;
+    /** Hit-rate under which tiles are scanned at lower resolution */
+    double priorLow;
 
-    /** Projection window vertical aperture in radian **/
-    double ay;
+    /** Resolution scale of low hit-rate tiles */
+    double priorScale;
 
-    /** Projection window horizontal half-aperture in radian */
-    double hax;
+    /** Tiles skipped during last detection (one entry per band) */
+    std::vector<SkippedTiles> skipped;
 
-    /** Projection window vertical half-aperture in radian **/
-    double hay;
+    /** Tile resampling method */
+    GnomonicTransform::Interpolation interpolation;
+
+    /** Sample tiles from a cache-blocked copy of the source */
+    bool blocked;
+
+    /** Called with the objects of each tile once mapped to eqr (optional) */
+    std::function<void(std::list<DetectedObject> &)> tileCallback;
 
 
 public:
     /**
      * Empty constructor.
      */
-    GnomonicProjectionDetector() : ObjectDetector(), width(512), height(512), ax(M_PI / 3), ay(M_PI / 3), hax(M_PI / 6), hay(M_PI / 6) {
+    GnomonicProjectionDetector() : ObjectDetector(), priorSkip(0), priorLow(0), priorScale(1), interpolation(GnomonicTransform::AUTO), blocked(false) {
+        this->addBand(std::shared_ptr<ObjectDetector>(), 512);
     }
 
     /**
@@ -87,7 +134,8 @@ public:
      * \param ax projection window horizontal aperture in radian
      * \param ay projection window vertical aperture in radian
      */
-    GnomonicProjectionDetector(const std::shared_ptr<ObjectDetector> &detector, int width, double ax = M_PI / 3, double ay = M_PI / 3) : ObjectDetector(), detector(detector), width(width), height(width * ay / ax), ax(ax), ay(ay), hax(ax / 2), hay(ay / 2) {
+    GnomonicProjectionDetector(const std::shared_ptr<ObjectDetector> &detector, int width, double ax = M_PI / 3, double ay = M_PI / 3) : ObjectDetector(), priorSkip(0), priorLow(0), priorScale(1), interpolation(GnomonicTransform::AUTO), blocked(false) {
+        this->addBand(detector, width, ax, ay);
     }
 
     /**
@@ -97,6 +145,63 @@ public:
     }
 
 
+    /**
+     * Add a tiling configuration, for example wide low resolution tiles
+     * searching for large objects only.
+     *
+     * \param detector underlying object detector (restricted to the object sizes of this band)
+     * \param width projection window width in pixels
+     * \param ax projection window horizontal aperture in radian
+     * \param ay projection window vertical aperture in radian
+     */
+    GnomonicProjectionDetector* addBand(const std::shared_ptr<ObjectDetector> &detector, int width, double ax = M_PI / 3, double ay = M_PI / 3);
+
+    /**
+     * Use tile hit-rate priors to reduce scanning. Each band uses the prior
+     * aggregated over its own scan grid.
+     *
+     * \param priors tile hit-rate priors (one per scan grid)
+     * \param skip hit-rate under which tiles are skipped
+     * \param low hit-rate under which tiles are scanned at lower resolution
+     * \param scale resolution scale of low hit-rate tiles
+     * \return true on success, false if a band has no prior of its scan grid
+     */
+    bool setPrior(const std::vector<std::shared_ptr<TilePrior>> &priors, double skip, double low, double scale);
+
+    /**
+     * Select tile resampling method.
+     *
+     * \param interpolation resampling method
+     */
+    void setInterpolation(GnomonicTransform::Interpolation interpolation);
+
+    /**
+     * Sample tiles from a cache-blocked copy of the source image (built
+     * once per image). Improves memory locality of tiles near the poles
+     * at the cost of one extra copy of the source.
+     *
+     * \param blocked true to enable blocked source
+     */
+    void setBlockedSource(bool blocked);
+
+    /**
+     * Report objects as soon as each tile is scanned, for example to
+     * stream them to the output. Objects are given in eqr coordinates
+     * and may be modified before being added to the detection result.
+     *
+     * \param callback tile objects callback (empty to disable)
+     */
+    void setTileCallback(const std::function<void(std::list<DetectedObject> &)> &callback);
+
+    /**
+     * Get tiles skipped during last detection.
+     *
+     * \return skipped tiles of each band
+     */
+    const std::vector<SkippedTiles>& skippedTiles() const {
+        return this->skipped;
+    }
+
     /**
      * Check if this object detector supports color images.
      *
@@ -112,6 +217,30 @@ public:
      * \return true on success, false otherwise
      */
     virtual bool detect(const cv::Mat &source, std::list<DetectedObject> &objects);
+
+    /*
+     * Execute object detector against given image source, decoding only
+     * the bands of rows needed by the current tiles.
+     *
+     * \param source source image to scan for objects
+     * \param objects output list of detected objects
+     * \return true on success, false otherwise
+     */
+    bool detect(EqrSource &source, std::list<DetectedObject> &objects);
+
+
+protected:
+    /*
+     * Scan source image with one tiling configuration.
+     *
+     * \param type source image type
+     * \param band tiling configuration
+     * \param project tile projection function
+     * \param objects output list of detected objects
+     * \param skipped output skipped tiles
+     * \return true on success, false otherwise
+     */
+    bool detectBand(int type, const TilingConfig &band, const std::function<bool(const GnomonicTransform &, cv::Mat &)> &project, std::list<DetectedObject> &objects, std::vector<cv::Point2d> &skipped);
 };
 
 
@@ -0,0 +1,227 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#include <math.h>
+#include <algorithm>
+#include <limits>
+
+#include "grid.hpp"
+
+
+#define CLAMP(x, a, b)  MIN(MAX(a, x), b)
+
+/** Maximum number of cells a box is binned into (larger ones are unbounded) */
+#define MAX_BOX_CELLS   16
+
+
+/**
+ * Check if box wraps around (first point after second one).
+ *
+ * \param area bounding box
+ * \return true if box wraps
+ */
+static bool wraps(const BoundingBox &area) {
+    return area.p1.x > area.p2.x || area.p1.y > area.p2.y;
+}
+
+
+BoxGrid::BoxGrid(const std::vector<BoundingBox> &boxes) : columns(1), rows(1), stamps(boxes.size(), 0), stamp(0), removed(boxes.size(), false) {
+    double x1 = std::numeric_limits<double>::max();
+    double y1 = std::numeric_limits<double>::max();
+    double x2 = -std::numeric_limits<double>::max();
+    double y2 = -std::numeric_limits<double>::max();
+    std::vector<double> widths;
+    std::vector<double> heights;
+
+    for (unsigned int i = 0; i < boxes.size(); i++) {
+        if (wraps(boxes[i])) {
+            continue;
+        }
+        x1 = MIN(x1, boxes[i].p1.x);
+        y1 = MIN(y1, boxes[i].p1.y);
+        x2 = MAX(x2, boxes[i].p2.x);
+        y2 = MAX(y2, boxes[i].p2.y);
+        widths.push_back(boxes[i].p2.x - boxes[i].p1.x);
+        heights.push_back(boxes[i].p2.y - boxes[i].p1.y);
+    }
+    if (!widths.empty()) {
+        // about one box per cell, but cells no smaller than the median box
+        // so that clustered boxes do not each cover most of the grid
+        int cells = CLAMP((int)ceil(sqrt((double)widths.size())), 1, 1024);
+
+        std::nth_element(widths.begin(), widths.begin() + widths.size() / 2, widths.end());
+        std::nth_element(heights.begin(), heights.begin() + heights.size() / 2, heights.end());
+        this->origin = cv::Point2d(x1, y1);
+        this->cellSize = cv::Point2d(
+            MAX(MAX(x2 - x1, 1e-9) / cells, widths[widths.size() / 2]),
+            MAX(MAX(y2 - y1, 1e-9) / cells, heights[heights.size() / 2])
+        );
+        this->columns = CLAMP((int)ceil(MAX(x2 - x1, 1e-9) / this->cellSize.x), 1, cells);
+        this->rows = CLAMP((int)ceil(MAX(y2 - y1, 1e-9) / this->cellSize.y), 1, cells);
+    }
+
+    // boxes covering many cells are returned by every query instead
+    std::vector<bool> binned(boxes.size(), false);
+
+    for (unsigned int i = 0; i < boxes.size(); i++) {
+        int cx1, cy1, cx2, cy2;
+
+        if (!wraps(boxes[i])) {
+            this->cells(boxes[i], cx1, cy1, cx2, cy2);
+            binned[i] = (cx2 - cx1 + 1) * (cy2 - cy1 + 1) <= MAX_BOX_CELLS;
+        }
+        if (!binned[i]) {
+            this->unbounded.push_back(i);
+        }
+    }
+
+    // bin boxes in two passes (count, then fill)
+    this->cellOffsets.assign(this->columns * this->rows + 1, 0);
+    for (int pass = 0; pass < 2; pass++) {
+        std::vector<unsigned int> fill(this->cellOffsets.begin(), this->cellOffsets.end() - 1);
+
+        for (unsigned int i = 0; i < boxes.size(); i++) {
+            int cx1, cy1, cx2, cy2;
+
+            if (!binned[i]) {
+                continue;
+            }
+            this->cells(boxes[i], cx1, cy1, cx2, cy2);
+            for (int y = cy1; y <= cy2; y++) {
+                for (int x = cx1; x <= cx2; x++) {
+                    int index = y * this->columns + x;
+
+                    if (pass == 0) {
+                        this->cellOffsets[index + 1]++;
+                    } else {
+                        this->cellItems[fill[index]++] = i;
+                    }
+                }
+            }
+        }
+        if (pass == 0) {
+            for (unsigned int c = 1; c < this->cellOffsets.size(); c++) {
+                this->cellOffsets[c] += this->cellOffsets[c - 1];
+            }
+            this->cellItems.resize(this->cellOffsets.back());
+        }
+    }
+    for (unsigned int c = 0; c + 1 < this->cellOffsets.size(); c++) {
+        this->cellCounts.push_back(this->cellOffsets[c + 1] - this->cellOffsets[c]);
+    }
+    this->last[0] = -1;
+}
+
+void BoxGrid::cells(const BoundingBox &area, int &x1, int &y1, int &x2, int &y2) const {
+    double ax1 = MIN(area.p1.x, area.p2.x);
+    double ay1 = MIN(area.p1.y, area.p2.y);
+    double ax2 = area.p2.x;
+    double ay2 = area.p2.y;
+
+    // wrapped areas may overlap anything past their first point
+    if (area.p1.x > area.p2.x) {
+        ax2 = std::numeric_limits<double>::max();
+    }
+    if (area.p1.y > area.p2.y) {
+        ay2 = std::numeric_limits<double>::max();
+    }
+
+    x1 = (int)CLAMP(floor((ax1 - this->origin.x) / this->cellSize.x), 0.0, (double)(this->columns - 1));
+    y1 = (int)CLAMP(floor((ay1 - this->origin.y) / this->cellSize.y), 0.0, (double)(this->rows - 1));
+    x2 = (int)CLAMP(floor((ax2 - this->origin.x) / this->cellSize.x), 0.0, (double)(this->columns - 1));
+    y2 = (int)CLAMP(floor((ay2 - this->origin.y) / this->cellSize.y), 0.0, (double)(this->rows - 1));
+}
+
+bool BoxGrid::query(const BoundingBox &area, std::vector<unsigned int> &candidates) {
+    int x1, y1, x2, y2;
+
+    this->cells(area, x1, y1, x2, y2);
+    if (x1 == this->last[0] && y1 == this->last[1] && x2 == this->last[2] && y2 == this->last[3]) {
+        return false;
+    }
+    this->last[0] = x1;
+    this->last[1] = y1;
+    this->last[2] = x2;
+    this->last[3] = y2;
+
+    candidates.clear();
+
+    // drop removed boxes from unbounded ones while scanning them
+    unsigned int kept = 0;
+
+    for (unsigned int k = 0; k < this->unbounded.size(); k++) {
+        unsigned int i = this->unbounded[k];
+
+        if (!this->removed[i]) {
+            this->unbounded[kept++] = i;
+            candidates.push_back(i);
+        }
+    }
+    this->unbounded.resize(kept);
+
+    this->stamp++;
+    for (int y = y1; y <= y2; y++) {
+        for (int x = x1; x <= x2; x++) {
+            int index = y * this->columns + x;
+            unsigned int *items = &this->cellItems[0] + this->cellOffsets[index];
+            unsigned int count = 0;
+
+            // drop removed boxes from cell while scanning it
+            for (unsigned int k = 0; k < this->cellCounts[index]; k++) {
+                unsigned int i = items[k];
+
+                if (this->removed[i]) {
+                    continue;
+                }
+                items[count++] = i;
+                if (this->stamps[i] != this->stamp) {
+                    this->stamps[i] = this->stamp;
+                    candidates.push_back(i);
+                }
+            }
+            this->cellCounts[index] = count;
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    return true;
+}
+
+void BoxGrid::remove(unsigned int index) {
+    this->removed[index] = true;
+}
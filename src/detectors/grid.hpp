@@ -0,0 +1,139 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#ifndef __YAFDB_DETECTORS_GRID_H_INCLUDE__
+#define __YAFDB_DETECTORS_GRID_H_INCLUDE__
+
+
+#include <vector>
+
+#include "detector.hpp"
+
+
+/**
+ * Uniform grid index over bounding boxes, used to find merge candidates
+ * without comparing every pair of objects.
+ *
+ * Cells are no smaller than the median box. Boxes crossing the 0/2pi seam
+ * or a pole (first point after second one) and boxes covering many cells
+ * are not binned and are returned as candidates of every query. Queries
+ * are conservative: candidates must still be tested for overlap.
+ *
+ */
+class BoxGrid {
+protected:
+    /** Grid origin */
+    cv::Point2d origin;
+
+    /** Cell width (x) and height (y) */
+    cv::Point2d cellSize;
+
+    /** Number of columns */
+    int columns;
+
+    /** Number of rows */
+    int rows;
+
+    /** Offset of cell items (one per cell plus end) */
+    std::vector<unsigned int> cellOffsets;
+
+    /** Number of items left in cells */
+    std::vector<unsigned int> cellCounts;
+
+    /** Box indices of cells */
+    std::vector<unsigned int> cellItems;
+
+    /** Boxes returned by every query */
+    std::vector<unsigned int> unbounded;
+
+    /** Last query having returned each box */
+    std::vector<unsigned int> stamps;
+
+    /** Current query stamp */
+    unsigned int stamp;
+
+    /** Removed boxes */
+    std::vector<bool> removed;
+
+    /** Cells covered by last query (x1, y1, x2, y2) */
+    int last[4];
+
+
+    /**
+     * Compute range of cells covered by a box.
+     *
+     * \param area bounding box
+     * \param x1 output first column
+     * \param y1 output first row
+     * \param x2 output last column
+     * \param y2 output last row
+     */
+    void cells(const BoundingBox &area, int &x1, int &y1, int &x2, int &y2) const;
+
+
+public:
+    /**
+     * Default constructor.
+     *
+     * \param boxes bounding boxes to index
+     */
+    BoxGrid(const std::vector<BoundingBox> &boxes);
+
+
+    /**
+     * Find boxes that may overlap given area. If area covers the same cells
+     * as the previous query, candidates are left untouched (and may still
+     * contain boxes removed since).
+     *
+     * \param area bounding box
+     * \param candidates output box indices (sorted, unique)
+     * \return true if candidates were updated
+     */
+    bool query(const BoundingBox &area, std::vector<unsigned int> &candidates);
+
+    /**
+     * Remove box from index.
+     *
+     * \param index box index
+     */
+    void remove(unsigned int index);
+};
+
+
+#endif //__YAFDB_DETECTORS_GRID_H_INCLUDE__
@@ -48,7 +48,7 @@ bool HaarDetector::supportsColors() const {
 bool HaarDetector::detect(const cv::Mat &source, std::list<DetectedObject> &objects) {
     std::vector<cv::Rect> rects;
 
-    this->classifier.detectMultiScale(source, rects, this->scaleFactor, this->minOverlap, 0, cv::Size(10, 10), cv::Size());
+    this->classifier.detectMultiScale(source, rects, this->scaleFactor, this->minOverlap, 0, this->minSize, this->maxSize);
     std::for_each(rects.begin(), rects.end(), [&] (const cv::Rect &rect) {
         objects.push_back(DetectedObject(this->className, rect, "No", "None", "None"));
     });
@@ -62,12 +62,18 @@ protected:
     /** Minimum match overlap */
     int minOverlap;
 
+    /** Minimum object size */
+    cv::Size minSize;
+
+    /** Maximum object size (empty = unlimited) */
+    cv::Size maxSize;
+
 
 public:
     /**
      * Empty constructor.
      */
-    HaarDetector() : ObjectDetector(), className("object"), scaleFactor(1.1), minOverlap(5) {
+    HaarDetector() : ObjectDetector(), className("object"), scaleFactor(1.1), minOverlap(5), minSize(10, 10) {
     }
 
     /**
@@ -77,8 +83,10 @@ public:
      * \param modelFile haar model filename
      * \param scaleFactor haar reduction factor after each iteration
      * \param minOverlap minimum match overlap
+     * \param minSize minimum object size
+     * \param maxSize maximum object size (empty = unlimited)
      */
-    HaarDetector(const std::string &className, const std::string &modelFile, double scaleFactor = 1.1, int minOverlap = 5) : ObjectDetector(), className(className), scaleFactor(scaleFactor), minOverlap(minOverlap) {
+    HaarDetector(const std::string &className, const std::string &modelFile, double scaleFactor = 1.1, int minOverlap = 5, const cv::Size &minSize = cv::Size(10, 10), const cv::Size &maxSize = cv::Size()) : ObjectDetector(), className(className), scaleFactor(scaleFactor), minOverlap(minOverlap), minSize(minSize), maxSize(maxSize) {
         this->classifier.load(modelFile);
     }
 
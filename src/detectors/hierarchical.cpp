@@ -116,12 +116,12 @@ bool HierarchicalObjectDetector::detect(const cv::Mat &source, std::list<Detecte
                 childObject.move(firstRect.x, firstRect.y);
             });
 
-            object.addChildren(childObjects);
+            object.addChildren(std::move(childObjects));
             return true;
         });
 
         if (matched >= this->minOccurences && (this->maxOccurences <= 0 || matched <= this->maxOccurences)) {
-            objects.push_back(object);
+            objects.push_back(std::move(object));
         }
     });
     return true;
@@ -0,0 +1,143 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+
+#include <string.h>
+
+#include "mask.hpp"
+
+
+BlurMask::BlurMask(int feather) : feather(MAX(feather, 0)) {
+}
+
+void BlurMask::add(const cv::Rect &rect) {
+    if (rect.width > 0 && rect.height > 0) {
+        this->rects.push_back(rect);
+    }
+}
+
+void BlurMask::build(const cv::Size &size, int halo) {
+    cv::Rect bounds(0, 0, size.width, size.height);
+    int radius = this->feather / 2;
+    int reach = 2 * radius;
+    std::vector<cv::Rect> areas;
+    std::vector< std::vector<size_t> > members;
+
+    this->regions.clear();
+
+    // alpha fades out over reach pixels around each rectangle
+    for (size_t i = 0; i < this->rects.size(); i++) {
+        const cv::Rect &rect = this->rects[i];
+        cv::Rect area(cv::Rect(rect.x - reach, rect.y - reach, rect.width + 2 * reach, rect.height + 2 * reach) & bounds);
+
+        if (area.width > 0 && area.height > 0) {
+            areas.push_back(area);
+            members.push_back(std::vector<size_t>(1, i));
+        }
+    }
+
+    // regions whose footprints overlap are merged so that remaining ones
+    // only read original pixels and can be blurred independently
+    bool merged = true;
+
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < areas.size(); i++) {
+            cv::Rect a(areas[i].x - halo, areas[i].y - halo, areas[i].width + 2 * halo, areas[i].height + 2 * halo);
+
+            for (size_t j = i + 1; j < areas.size(); ) {
+                cv::Rect b(areas[j].x - halo, areas[j].y - halo, areas[j].width + 2 * halo, areas[j].height + 2 * halo);
+
+                if ((a & b).area() > 0) {
+                    areas[i] = areas[i] | areas[j];
+                    members[i].insert(members[i].end(), members[j].begin(), members[j].end());
+                    areas.erase(areas.begin() + j);
+                    members.erase(members.begin() + j);
+                    a = cv::Rect(areas[i].x - halo, areas[i].y - halo, areas[i].width + 2 * halo, areas[i].height + 2 * halo);
+                    merged = true;
+                } else {
+                    j++;
+                }
+            }
+        }
+    }
+
+    // rasterize rectangles grown by half the feather, then box filter them:
+    // alpha stays opaque over each rectangle and fades out around it
+    for (size_t i = 0; i < areas.size(); i++) {
+        Region region;
+
+        region.area = areas[i];
+        region.alpha = cv::Mat::zeros(region.area.height, region.area.width, CV_8UC1);
+        for (auto m = members[i].begin(); m != members[i].end(); ++m) {
+            const cv::Rect &rect = this->rects[*m];
+            cv::Rect fill(cv::Rect(rect.x - radius, rect.y - radius, rect.width + 2 * radius, rect.height + 2 * radius) & region.area);
+
+            if (fill.width > 0 && fill.height > 0) {
+                cv::Mat(region.alpha, cv::Rect(fill.x - region.area.x, fill.y - region.area.y, fill.width, fill.height)).setTo(cv::Scalar(255));
+            }
+        }
+        if (radius > 0) {
+            cv::blur(region.alpha, region.alpha, cv::Size(2 * radius + 1, 2 * radius + 1));
+        }
+        this->regions.push_back(region);
+    }
+}
+
+void BlurMask::composite(cv::Mat &image, const cv::Mat &blurred, const cv::Mat &alpha) {
+    int channels = image.channels();
+
+    for (int y = 0; y < image.rows; y++) {
+        unsigned char *dst = image.ptr<unsigned char>(y);
+        const unsigned char *src = blurred.ptr<unsigned char>(y);
+        const unsigned char *weights = alpha.ptr<unsigned char>(y);
+
+        for (int x = 0; x < image.cols; x++, dst += channels, src += channels) {
+            int w = weights[x];
+
+            if (w == 255) {
+                memcpy(dst, src, channels);
+            } else if (w > 0) {
+                for (int c = 0; c < channels; c++) {
+                    dst[c] = (unsigned char)((src[c] * w + dst[c] * (255 - w) + 127) / 255);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,130 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+
+#ifndef __YAFDB_DETECTORS_MASK_H_INCLUDE__
+#define __YAFDB_DETECTORS_MASK_H_INCLUDE__
+
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+
+/**
+ * Feathered blur mask built from all blurred rectangles of an image.
+ * Rectangles are grouped into independent regions (bounding boxes whose
+ * footprints do not overlap), each holding an 8-bit alpha channel that is
+ * opaque inside the rectangles and fades out around them. Each region is
+ * then blurred once and composited into the image, whatever the number of
+ * overlapping rectangles.
+ *
+ */
+class BlurMask {
+public:
+    /**
+     * Mask region.
+     *
+     */
+    typedef struct {
+        /** Bounding box in image */
+        cv::Rect area;
+
+        /** Alpha channel over area (CV_8UC1) */
+        cv::Mat alpha;
+    } Region;
+
+
+protected:
+    /** Width of the fading border around rectangles */
+    int feather;
+
+    /** Masked rectangles */
+    std::vector<cv::Rect> rects;
+
+    /** Built regions */
+    std::vector<Region> regions;
+
+
+public:
+    /**
+     * Default constructor.
+     *
+     * \param feather width of the fading border around rectangles
+     */
+    BlurMask(int feather = 0);
+
+
+    /**
+     * Add rectangle to mask.
+     *
+     * \param rect masked rectangle
+     */
+    void add(const cv::Rect &rect);
+
+    /**
+     * Group rectangles into regions and rasterize their alpha channels.
+     *
+     * \param size image size
+     * \param halo pixels read around a region by the blur
+     */
+    void build(const cv::Size &size, int halo);
+
+    /**
+     * Retrieve built regions.
+     *
+     * \return regions
+     */
+    const std::vector<Region> &getRegions() const {
+        return this->regions;
+    }
+
+
+    /**
+     * Blend blurred pixels into image: image = blurred * alpha + image * (1 - alpha).
+     *
+     * \param image image area to update (CV_8U)
+     * \param blurred blurred pixels (same size and type as image)
+     * \param alpha alpha channel (same size as image, CV_8UC1)
+     */
+    static void composite(cv::Mat &image, const cv::Mat &blurred, const cv::Mat &alpha);
+};
+
+
+#endif //__YAFDB_DETECTORS_MASK_H_INCLUDE__
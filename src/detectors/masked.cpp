@@ -0,0 +1,132 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#include "masked.hpp"
+
+
+bool MaskedObjectDetector::allows(double phi, double theta) const {
+    phi = fmod(phi, 2 * M_PI);
+    if (phi < 0) {
+        phi += 2 * M_PI;
+    }
+
+    // check latitude / longitude bands
+    if (theta < this->minTheta || theta > this->maxTheta) {
+        return false;
+    }
+    if (this->minPhi <= this->maxPhi) {
+        if (phi < this->minPhi || phi > this->maxPhi) {
+            return false;
+        }
+    } else if (phi < this->minPhi && phi > this->maxPhi) {
+        return false;
+    }
+
+    // check exclusion mask
+    if (!this->mask.empty()) {
+        int x = (int)(phi / (2 * M_PI) * this->mask.cols);
+        int y = (int)((theta + M_PI / 2) / M_PI * this->mask.rows);
+
+        x = MIN(MAX(x, 0), this->mask.cols - 1);
+        y = MIN(MAX(y, 0), this->mask.rows - 1);
+        if (this->mask.at<unsigned char>(y, x) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MaskedObjectDetector::supportsColor() const {
+    return !this->detector || this->detector->supportsColor();
+}
+
+bool MaskedObjectDetector::detect(const cv::Mat &source, std::list<DetectedObject> &objects) {
+    std::list<DetectedObject> sourceObjects;
+
+    if (this->detector && !this->detector->detect(source, sourceObjects)) {
+        return false;
+    }
+
+    // keep objects centered in allowed area
+    for (auto it = sourceObjects.begin(); it != sourceObjects.end(); ) {
+        double x = ((*it).area.p1.x + (*it).area.p2.x) / 2;
+        double y = ((*it).area.p1.y + (*it).area.p2.y) / 2;
+
+        if (this->allows(x / source.cols * 2 * M_PI, y / source.rows * M_PI - M_PI / 2)) {
+            objects.splice(objects.end(), sourceObjects, it++);
+        } else {
+            ++it;
+        }
+    }
+    return true;
+}
+
+bool MaskedObjectDetector::acceptsTile(const GnomonicTransform &tile) const {
+    std::vector<cv::Point2d> points;
+
+    if (this->detector && !this->detector->acceptsTile(tile)) {
+        return false;
+    }
+    tile.footprint(this->samples, points);
+    return std::any_of(points.begin(), points.end(), [&] (const cv::Point2d &point) {
+        return this->allows(point.x, point.y);
+    });
+}
+
+bool MaskedObjectDetector::detectTile(const cv::Mat &source, const GnomonicTransform &tile, std::list<DetectedObject> &objects) {
+    std::list<DetectedObject> tileObjects;
+
+    if (this->detector && !this->detector->detectTile(source, tile, tileObjects)) {
+        return false;
+    }
+
+    // keep objects centered in allowed area
+    for (auto it = tileObjects.begin(); it != tileObjects.end(); ) {
+        const BoundingBox &area = (*it).area;
+        double phi, theta;
+
+        if (tile.toEqr((int)((area.p1.x + area.p2.x) / 2), (int)((area.p1.y + area.p2.y) / 2), phi, theta) &&
+            this->allows(phi, theta)) {
+            objects.splice(objects.end(), tileObjects, it++);
+        } else {
+            ++it;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,141 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#ifndef __YAFDB_DETECTORS_MASKED_H_INCLUDE__
+#define __YAFDB_DETECTORS_MASKED_H_INCLUDE__
+
+
+#include "detector.hpp"
+
+
+/**
+ * Object detector restricted to an area of the sphere.
+ *
+ */
+class MaskedObjectDetector : public ObjectDetector {
+protected:
+    /** Underlying object detector */
+    std::shared_ptr<ObjectDetector> detector;
+
+    /** Minimum allowed polar angle in radian (eqr convention, -pi/2 = top) */
+    double minTheta;
+
+    /** Maximum allowed polar angle in radian (eqr convention, pi/2 = bottom) */
+    double maxTheta;
+
+    /** Minimum allowed azimuthal angle in radian */
+    double minPhi;
+
+    /** Maximum allowed azimuthal angle in radian (may be lower than minimum to wrap around) */
+    double maxPhi;
+
+    /** Exclusion mask in eqr projection (non-zero = excluded, empty = none) */
+    cv::Mat mask;
+
+    /** Number of samples along each tile axis to check its footprint */
+    int samples;
+
+
+public:
+    /**
+     * Default constructor.
+     *
+     * \param detector underlying object detector
+     * \param minTheta minimum allowed polar angle in radian
+     * \param maxTheta maximum allowed polar angle in radian
+     * \param minPhi minimum allowed azimuthal angle in radian
+     * \param maxPhi maximum allowed azimuthal angle in radian
+     * \param mask exclusion mask in eqr projection (single channel, non-zero = excluded)
+     */
+    MaskedObjectDetector(const std::shared_ptr<ObjectDetector> &detector, double minTheta = -M_PI / 2, double maxTheta = M_PI / 2, double minPhi = 0, double maxPhi = 2 * M_PI, const cv::Mat &mask = cv::Mat()) : ObjectDetector(), detector(detector), minTheta(minTheta), maxTheta(maxTheta), minPhi(minPhi), maxPhi(maxPhi), mask(mask), samples(16) {
+    }
+
+    /**
+     * Empty destructor.
+     */
+    virtual ~MaskedObjectDetector() {
+    }
+
+
+    /**
+     * Check if a point of the sphere lies within the allowed area.
+     *
+     * \param phi azimuthal angle (in radian)
+     * \param theta polar angle (in radian)
+     * \return true if point is allowed, false otherwise
+     */
+    bool allows(double phi, double theta) const;
+
+    /**
+     * Check if this object detector supports color images.
+     *
+     * \return true if detector works with color images, false otherwise.
+     */
+    virtual bool supportsColor() const;
+
+    /*
+     * Execute object detector against given image (in eqr projection).
+     *
+     * \param source source image to scan for objects
+     * \param objects output list of detected objects
+     * \return true on success, false otherwise
+     */
+    virtual bool detect(const cv::Mat &source, std::list<DetectedObject> &objects);
+
+    /**
+     * Check if the allowed area intersects given gnomonic tile.
+     *
+     * \param tile gnomonic transform of the tile
+     * \return true if tile must be scanned, false if it can be skipped
+     */
+    virtual bool acceptsTile(const GnomonicTransform &tile) const;
+
+    /*
+     * Execute object detector against given gnomonic tile.
+     *
+     * \param source tile image to scan for objects
+     * \param tile gnomonic transform of the tile
+     * \param objects output list of detected objects (in tile coordinates)
+     * \return true on success, false otherwise
+     */
+    virtual bool detectTile(const cv::Mat &source, const GnomonicTransform &tile, std::list<DetectedObject> &objects);
+};
+
+
+#endif //__YAFDB_DETECTORS_MASKED_H_INCLUDE__
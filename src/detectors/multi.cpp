@@ -65,3 +65,27 @@ bool MultiObjectDetector::detect(const cv::Mat &source, std::list<DetectedObject
         return detector->detect(source, objects);
     });
 }
+
+bool MultiObjectDetector::acceptsTile(const GnomonicTransform &tile) const {
+    return std::any_of(this->detectors.begin(), this->detectors.end(), [&] (const std::shared_ptr<ObjectDetector> &detector) {
+        return detector->acceptsTile(tile);
+    });
+}
+
+bool MultiObjectDetector::detectTile(const cv::Mat &source, const GnomonicTransform &tile, std::list<DetectedObject> &objects) {
+    cv::Mat graySource(source);
+
+    return std::all_of(this->detectors.begin(), this->detectors.end(), [&] (const std::shared_ptr<ObjectDetector> &detector) {
+        if (!detector->acceptsTile(tile)) {
+            return true;
+        }
+        if (!detector->supportsColor()) {
+            if (graySource.channels() != 1) {
+                cv::cvtColor(source, graySource, cv::COLOR_RGB2GRAY);
+                // cv::equalizeHist(graySource, graySource);
+            }
+            return detector->detectTile(graySource, tile, objects);
+        }
+        return detector->detectTile(source, tile, objects);
+    });
+}
@@ -92,6 +92,24 @@ public:
      * \return true on success, false otherwise
      */
     virtual bool detect(const cv::Mat &source, std::list<DetectedObject> &objects);
+
+    /**
+     * Check if any underlying object detector accepts given gnomonic tile.
+     *
+     * \param tile gnomonic transform of the tile
+     * \return true if tile must be scanned, false if it can be skipped
+     */
+    virtual bool acceptsTile(const GnomonicTransform &tile) const;
+
+    /*
+     * Execute underlying object detectors accepting given gnomonic tile.
+     *
+     * \param source tile image to scan for objects
+     * \param tile gnomonic transform of the tile
+     * \param objects output list of detected objects (in tile coordinates)
+     * \return true on success, false otherwise
+     */
+    virtual bool detectTile(const cv::Mat &source, const GnomonicTransform &tile, std::list<DetectedObject> &objects);
 };
 
 
@@ -0,0 +1,182 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+#include "parallel.hpp"
+
+
+/** True within parallel loop bodies */
+static thread_local bool insideLoop = false;
+
+
+/**
+ * Shared state of a parallel loop.
+ *
+ */
+class ParallelLoop {
+public:
+    /** Loop body */
+    std::function<void(int, int)> body;
+
+    /** Loop range */
+    int begin, end, chunk;
+
+    /** Next chunk start */
+    std::atomic<int> next;
+
+    /** Number of workers still running */
+    int running;
+
+    /** Completion lock */
+    std::mutex lock;
+
+    /** Signaled when a worker completes */
+    std::condition_variable done;
+
+
+    /**
+     * Process chunks until none is left.
+     */
+    void work() {
+        bool wasInside = insideLoop;
+
+        insideLoop = true;
+        for (int start = this->next.fetch_add(this->chunk); start < this->end; start = this->next.fetch_add(this->chunk)) {
+            this->body(start, std::min(start + this->chunk, this->end));
+        }
+        insideLoop = wasInside;
+
+        std::lock_guard<std::mutex> guard(this->lock);
+
+        this->running--;
+        this->done.notify_all();
+    }
+};
+
+
+ThreadPool::ThreadPool(int threads) : stopping(false) {
+    for (int i = 0; i < threads; i++) {
+        this->workers.push_back(std::thread(&ThreadPool::run, this));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+
+        this->stopping = true;
+        this->wakeup.notify_all();
+    }
+    for (auto &worker : this->workers) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool(std::max((int)std::thread::hardware_concurrency(), 1) - 1);
+
+    return pool;
+}
+
+int ThreadPool::size() const {
+    return this->workers.size() + 1;
+}
+
+void ThreadPool::run() {
+    while (true) {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> guard(this->lock);
+
+            while (!this->stopping && this->tasks.empty()) {
+                this->wakeup.wait(guard);
+            }
+            if (this->tasks.empty()) {
+                return;
+            }
+            task = this->tasks.front();
+            this->tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &body) {
+    int count = end - begin;
+    int chunks = std::min(this->size(), count / std::max(grain, 1));
+
+    // serial execution of small or nested loops
+    if (chunks <= 1 || insideLoop) {
+        if (count > 0) {
+            body(begin, end);
+        }
+        return;
+    }
+
+    std::shared_ptr<ParallelLoop> loop(new ParallelLoop());
+
+    loop->body = body;
+    loop->begin = begin;
+    loop->end = end;
+    loop->chunk = (count + chunks - 1) / chunks;
+    loop->next = begin;
+    loop->running = chunks;
+
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+
+        for (int i = 1; i < chunks; i++) {
+            this->tasks.push_back([loop] () {
+                loop->work();
+            });
+        }
+        this->wakeup.notify_all();
+    }
+    loop->work();
+
+    std::unique_lock<std::mutex> guard(loop->lock);
+
+    while (loop->running > 0) {
+        loop->done.wait(guard);
+    }
+}
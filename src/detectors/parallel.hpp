@@ -0,0 +1,122 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#ifndef __YAFDB_DETECTORS_PARALLEL_H_INCLUDE__
+#define __YAFDB_DETECTORS_PARALLEL_H_INCLUDE__
+
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/**
+ * Process-wide pool of worker threads.
+ *
+ */
+class ThreadPool {
+protected:
+    /** Worker threads */
+    std::vector<std::thread> workers;
+
+    /** Pending tasks */
+    std::deque< std::function<void()> > tasks;
+
+    /** Task queue lock */
+    std::mutex lock;
+
+    /** Signaled when tasks are queued */
+    std::condition_variable wakeup;
+
+    /** Stop flag */
+    bool stopping;
+
+
+    /**
+     * Default constructor.
+     *
+     * \param threads number of worker threads
+     */
+    ThreadPool(int threads);
+
+    /**
+     * Worker thread main loop.
+     */
+    void run();
+
+
+public:
+    /**
+     * Stop all worker threads.
+     */
+    ~ThreadPool();
+
+
+    /**
+     * Get shared pool (one worker per hardware thread).
+     *
+     * \return thread pool
+     */
+    static ThreadPool& instance();
+
+    /**
+     * Get number of threads working on a parallel loop (including caller).
+     *
+     * \return number of threads
+     */
+    int size() const;
+
+    /**
+     * Execute loop body over range split in chunks, in parallel. The caller
+     * takes part in the work and returns once all chunks are done. Nested
+     * calls from within a loop body run serially.
+     *
+     * \param begin first index
+     * \param end last index (excluded)
+     * \param grain minimum number of indices per chunk
+     * \param body loop body called with sub-ranges [begin, end)
+     */
+    void parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &body);
+};
+
+
+#endif //__YAFDB_DETECTORS_PARALLEL_H_INCLUDE__
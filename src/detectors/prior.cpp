@@ -0,0 +1,203 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#include "prior.hpp"
+
+
+TilePrior::TilePrior(double ax, double ay) : ax(ax), ay(ay), images(0) {
+    int rows = (int)floor(M_PI / (ay / 2) + 1e-9) + 1;
+    int cols = (int)ceil(2 * M_PI / (ax / 2) - 1e-9);
+
+    this->hits = cv::Mat(rows, cols, CV_64F, cv::Scalar(0));
+    this->exposures = cv::Mat(rows, cols, CV_64F, cv::Scalar(0));
+}
+
+void TilePrior::tiles(double ax, double ay, std::vector<cv::Point2d> &centers) {
+    // same scan order as the gnomonic projection detector
+    for (double y = M_PI / 2; y >= -M_PI / 2; y -= ay / 2) {
+        for (double x = 0; x < 2 * M_PI; x += ax / 2) {
+            centers.push_back(cv::Point2d(x, y));
+        }
+    }
+}
+
+bool TilePrior::load(const std::string &file, std::vector<std::shared_ptr<TilePrior>> &priors) {
+    cv::FileStorage fs(file, cv::FileStorage::READ);
+
+    if (!fs.isOpened()) {
+        return false;
+    }
+
+    // single scan grid files hold their prior at top-level
+    cv::FileNode grids = fs["grids"];
+
+    if (!grids.isSeq()) {
+        std::shared_ptr<TilePrior> prior(new TilePrior());
+
+        if (!prior->read(fs.root())) {
+            return false;
+        }
+        priors.push_back(prior);
+        return true;
+    }
+    for (auto it = grids.begin(); it != grids.end(); ++it) {
+        std::shared_ptr<TilePrior> prior(new TilePrior());
+
+        if (!prior->read(*it)) {
+            return false;
+        }
+        priors.push_back(prior);
+    }
+    return !priors.empty();
+}
+
+void TilePrior::save(cv::FileStorage &fs, const std::vector<std::shared_ptr<TilePrior>> &priors) {
+    fs << "grids" << "[";
+    std::for_each(priors.begin(), priors.end(), [&] (const std::shared_ptr<TilePrior> &prior) {
+        prior->write(fs);
+    });
+    fs << "]";
+}
+
+bool TilePrior::read(const cv::FileNode &node) {
+    node["aperture_x"] >> this->ax;
+    node["aperture_y"] >> this->ay;
+    node["images"] >> this->images;
+    node["hits"] >> this->hits;
+    node["exposures"] >> this->exposures;
+    return this->ax > 0 && this->ay > 0 && !this->hits.empty() && this->hits.size() == this->exposures.size();
+}
+
+void TilePrior::write(cv::FileStorage &fs) const {
+    fs << "{";
+    fs << "aperture_x" << this->ax;
+    fs << "aperture_y" << this->ay;
+    fs << "images" << this->images;
+    fs << "hits" << this->hits;
+    fs << "exposures" << this->exposures;
+    fs << "}";
+}
+
+bool TilePrior::matches(double ax, double ay) const {
+    return fabs(this->ax - ax) < 1e-6 && fabs(this->ay - ay) < 1e-6;
+}
+
+void TilePrior::readSkipped(const cv::FileNode &node, double ax, double ay, std::vector<cv::Point2d> &skipped) {
+    for (auto it = node.begin(); it != node.end(); ++it) {
+        // older files list tile centers of their single scan grid
+        if (!(*it).isMap()) {
+            cv::Point2d center;
+
+            (*it) >> center;
+            skipped.push_back(center);
+            continue;
+        }
+        if (fabs((double)(*it)["aperture_x"] - ax) >= 1e-6 || fabs((double)(*it)["aperture_y"] - ay) >= 1e-6) {
+            continue;
+        }
+
+        cv::FileNode tiles = (*it)["tiles"];
+
+        for (auto tile = tiles.begin(); tile != tiles.end(); ++tile) {
+            cv::Point2d center;
+
+            (*tile) >> center;
+            skipped.push_back(center);
+        }
+    }
+}
+
+void TilePrior::add(const DetectionStore &objects, const std::vector<cv::Point2d> &skipped) {
+    std::vector<cv::Point2d> centers;
+    cv::Mat skippedCells(this->hits.size(), CV_8UC1, cv::Scalar(0));
+
+    std::for_each(skipped.begin(), skipped.end(), [&] (const cv::Point2d &center) {
+        cv::Point p(this->cell(center.x, center.y));
+
+        skippedCells.at<unsigned char>(p.y, p.x) = 1;
+    });
+
+    TilePrior::tiles(this->ax, this->ay, centers);
+    std::for_each(centers.begin(), centers.end(), [&] (const cv::Point2d &center) {
+        cv::Point p(this->cell(center.x, center.y));
+
+        if (skippedCells.at<unsigned char>(p.y, p.x)) {
+            return;
+        }
+
+        // check if any object center lies within tile
+        GnomonicTransform transform(64, (int)(64 * this->ay / this->ax), this->ax, this->ay, center.x, center.y);
+        bool hit = false;
+
+        for (unsigned int i = 0; i < objects.size() && !hit; i++) {
+            BoundingBox area(objects.area(objects.root(i)));
+            int x, y;
+
+            hit = area.isSpherical() &&
+                transform.toGnomonic(area.p1.x + area.width() / 2, area.p1.y + area.height() / 2, x, y) &&
+                x >= 0 && x < 64 && y >= 0 && y < (int)(64 * this->ay / this->ax);
+        }
+
+        this->exposures.at<double>(p.y, p.x) += 1;
+        if (hit) {
+            this->hits.at<double>(p.y, p.x) += 1;
+        }
+    });
+    this->images++;
+}
+
+double TilePrior::rate(double x, double y) const {
+    cv::Point p(this->cell(x, y));
+    double exposures = this->exposures.at<double>(p.y, p.x);
+
+    if (exposures <= 0) {
+        return 1;
+    }
+    return this->hits.at<double>(p.y, p.x) / exposures;
+}
+
+cv::Point TilePrior::cell(double x, double y) const {
+    int col = (int)floor(fmod(x, 2 * M_PI) / (this->ax / 2) + 0.5) % this->hits.cols;
+    int row = (int)floor((M_PI / 2 - y) / (this->ay / 2) + 0.5);
+
+    if (col < 0) {
+        col += this->hits.cols;
+    }
+    return cv::Point(col, MIN(MAX(row, 0), this->hits.rows - 1));
+}
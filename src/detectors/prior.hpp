@@ -0,0 +1,205 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#ifndef __YAFDB_DETECTORS_PRIOR_H_INCLUDE__
+#define __YAFDB_DETECTORS_PRIOR_H_INCLUDE__
+
+
+#include "detector.hpp"
+#include "store.hpp"
+
+
+/**
+ * Per-tile detection hit-rate map of one gnomonic scan grid (one prior per
+ * scale band).
+ *
+ */
+class TilePrior {
+protected:
+    /** Scan grid horizontal aperture in radian */
+    double ax;
+
+    /** Scan grid vertical aperture in radian */
+    double ay;
+
+    /** Number of aggregated images */
+    int images;
+
+    /** Number of images with at least one object per tile */
+    cv::Mat hits;
+
+    /** Number of images in which each tile was scanned */
+    cv::Mat exposures;
+
+
+public:
+    /**
+     * Empty constructor.
+     */
+    TilePrior() : ax(0), ay(0), images(0) {
+    }
+
+    /**
+     * Default constructor.
+     *
+     * \param ax scan grid horizontal aperture in radian
+     * \param ay scan grid vertical aperture in radian
+     */
+    TilePrior(double ax, double ay);
+
+
+    /**
+     * Enumerate tile centers of the gnomonic scan grid.
+     *
+     * \param ax scan grid horizontal aperture in radian
+     * \param ay scan grid vertical aperture in radian
+     * \param centers output tile centers (x = azimuthal angle, y = polar angle, in radian)
+     */
+    static void tiles(double ax, double ay, std::vector<cv::Point2d> &centers);
+
+    /**
+     * Load priors of all scan grids from yaml file.
+     *
+     * \param file yaml filename
+     * \param priors output priors (one per scan grid)
+     * \return true on success, false otherwise
+     */
+    static bool load(const std::string &file, std::vector<std::shared_ptr<TilePrior>> &priors);
+
+    /**
+     * Write priors of all scan grids to storage.
+     *
+     * \param fs storage to write to
+     * \param priors priors to write (one per scan grid)
+     */
+    static void save(cv::FileStorage &fs, const std::vector<std::shared_ptr<TilePrior>> &priors);
+
+    /**
+     * Read prior from storage node.
+     *
+     * \param node storage node to read from
+     * \return true on success, false otherwise
+     */
+    bool read(const cv::FileNode &node);
+
+    /**
+     * Write prior to storage.
+     *
+     * \param fs storage to write to
+     */
+    void write(cv::FileStorage &fs) const;
+
+    /**
+     * Check if prior was aggregated over given scan grid.
+     *
+     * \param ax scan grid horizontal aperture in radian
+     * \param ay scan grid vertical aperture in radian
+     * \return true if apertures match, false otherwise
+     */
+    bool matches(double ax, double ay) const;
+
+    /**
+     * Read skipped tiles of given scan grid from a detection file node
+     * (entries of other scan grids are ignored).
+     *
+     * \param node skipped tiles node
+     * \param ax scan grid horizontal aperture in radian
+     * \param ay scan grid vertical aperture in radian
+     * \param skipped output tile centers
+     */
+    static void readSkipped(const cv::FileNode &node, double ax, double ay, std::vector<cv::Point2d> &skipped);
+
+    /**
+     * Get scan grid horizontal aperture.
+     *
+     * \return aperture in radian
+     */
+    double apertureX() const {
+        return this->ax;
+    }
+
+    /**
+     * Get scan grid vertical aperture.
+     *
+     * \return aperture in radian
+     */
+    double apertureY() const {
+        return this->ay;
+    }
+
+    /**
+     * Get number of aggregated images.
+     *
+     * \return number of images
+     */
+    int count() const {
+        return this->images;
+    }
+
+    /**
+     * Aggregate results of one image.
+     *
+     * \param objects detected objects (top-level objects, in spherical coordinates)
+     * \param skipped centers of tiles that were not scanned
+     */
+    void add(const DetectionStore &objects, const std::vector<cv::Point2d> &skipped);
+
+    /**
+     * Get hit-rate of the tile nearest to given center.
+     *
+     * \param x tile center azimuthal angle (in radian)
+     * \param y tile center polar angle (in radian)
+     * \return tile hit-rate (1 if tile was never scanned)
+     */
+    double rate(double x, double y) const;
+
+
+protected:
+    /**
+     * Find grid cell of the tile nearest to given center.
+     *
+     * \param x tile center azimuthal angle (in radian)
+     * \param y tile center polar angle (in radian)
+     * \return grid cell
+     */
+    cv::Point cell(double x, double y) const;
+};
+
+
+#endif //__YAFDB_DETECTORS_PRIOR_H_INCLUDE__
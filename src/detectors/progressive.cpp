@@ -0,0 +1,388 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "progressive.hpp"
+
+#if defined(__SSE2__)
+#define YAFDB_PROGRESSIVE_SSE2
+#include <emmintrin.h>
+#endif
+
+
+const int ProgressiveBlur::MAX_FORCE;
+
+
+//! Progressive rectangular blurring
+
+//! Apply a progresive blur on the desired rectangle.
+//!
+//! @param pbBitmap Bitmap array pointer to result image
+//! @param pbSource Bitmap array pointer to source image
+//! @param pbWidth Bitmap width, in pixels
+//! @param pbHeight Bitmap height, in pixels
+//! @param pbChannel Layer on which blur apply
+//! @param pbRx1 Rectangle upper left corner x coordinates
+//! @param pbRy1 Rectangle upper left corner y coordinates
+//! @param pbRx2 Rectangle lower right corner x coordinates
+//! @param pbRy2 Rectangle lower right corner y coordinates
+
+static void progblur ( unsigned char * pbBitmap, int pbWidth, int pbHeight, int pbChannel, int pbRx1, int pbRy1, int pbRx2, int pbRy2 ) {
+
+    /* Parsing variables */
+    int pbX = 0;
+    int pbY = 0;
+    int pbI = 0;
+    int pbJ = 0;
+
+    /* Function parameters */
+    float pbU = 0.0;
+    float pbV = 0.0;
+
+    /* Area boudaries */
+    int pbAX1 = 0;
+    int pbAY1 = 0;
+    int pbAX2 = 0;
+    int pbAY2 = 0;
+
+    /* Compute rectangle size */
+    int pbrWidth  = ( pbRx2 - pbRx1 );
+    int pbrHeight = ( pbRy2 - pbRy1 );
+
+    /* Compute rectangle center */
+    float pbCX = ( float ) pbrWidth  / 2.0 + pbRx1;
+    float pbCY = ( float ) pbrHeight / 2.0 + pbRy1;
+
+    /* Compute automatic factor */
+    float pbFactor = pbrWidth < pbrHeight ? pbrWidth : pbrHeight;
+
+    /* Chromaitc accumulator */
+    float pbAccumR = 0.0;
+    float pbAccumG = 0.0;
+    float pbAccumB = 0.0;
+    int   pbForce  = 0;
+    int   pbCount  = 0;
+
+    /* Optimization for bitmap offset */
+    unsigned char * pbOffset = NULL;
+
+    /* Optimization for bitmap sub-offset */
+    int pbYOffset = 0;
+    int pbJOffset = 0;
+
+    /* Increase rectangle size */
+    pbRx1 = pbCX - pbFactor;
+    pbRx2 = pbCX + pbFactor;
+    pbRy1 = pbCY - pbFactor;
+    pbRy2 = pbCY + pbFactor;
+
+    /* Recompute adapted width and height */
+    pbrWidth  = ( pbRx2 - pbRx1 );
+    pbrHeight = ( pbRy2 - pbRy1 );
+
+    /* Optimization operation */
+    pbFactor *= 0.2;
+
+    /* Blurring y-component loop */
+    for ( pbY = pbRy1; pbY <= pbRy2; pbY ++ ) {
+
+        /* Compute optimization sub-offset */
+        pbYOffset = pbChannel * pbWidth * pbY;
+
+        /* Compute coordinates v-parameters */
+        pbV = ( ( float ) ( pbY - pbRy1 ) / pbrHeight ) * 2.0 - 1.0;
+
+        /* Blurring x-component loop */
+        for ( pbX = pbRx1; pbX <= pbRx2; pbX ++ ) {
+
+            /* Reset chromatic accumulator */
+            pbAccumR = 0.0;
+            pbAccumG = 0.0;
+            pbAccumB = 0.0;
+
+            /* Compute coordinates u-parameters */
+            pbU = ( ( float ) ( pbX - pbRx1 ) / pbrWidth  ) * 2.0 - 1.0;
+
+            /* Compute recursive condition value */
+            pbForce = int( exp( - pbU * pbU * 3.5 ) * exp( - pbV * pbV * 3.5 ) * pbFactor );
+
+            pbForce = ( pbForce > 32 ) ? 32 : pbForce;
+
+            /* Create area boundaries */
+            pbAX1 = pbX - pbForce; pbAX1 = ( pbAX1 <         0 ) ?            0 : pbAX1;
+            pbAX2 = pbX + pbForce; pbAX2 = ( pbAX2 >=  pbWidth ) ? pbWidth  - 1 : pbAX2;
+            pbAY1 = pbY - pbForce; pbAY1 = ( pbAY1 <         0 ) ?            0 : pbAY1;
+            pbAY2 = pbY + pbForce; pbAY2 = ( pbAY2 >= pbHeight ) ? pbHeight - 1 : pbAY2;
+
+            /* Accumulates y-components */
+            for ( pbJ = pbAY1; pbJ <= pbAY2; pbJ ++ ) {
+
+                /* Compute optimization sub-offset */
+                pbJOffset = pbChannel * pbWidth * pbJ;
+
+                /* Accumulates x-components */
+                for ( pbI = pbAX1; pbI <= pbAX2; pbI ++ ) {
+
+                    /* Compute optimiztion offset */
+                    pbOffset = pbBitmap + pbJOffset + pbChannel * pbI;
+
+                    /* Accumulate chromatic value */
+                    pbAccumR += * ( pbOffset ++ );
+                    pbAccumG += * ( pbOffset ++ );
+                    pbAccumB += * ( pbOffset    );
+
+                }
+
+            }
+
+            /* Compute number of considered pixels */
+            pbCount = ( pbAX2 - pbAX1 + 1 ) * ( pbAY2 - pbAY1 + 1 );
+
+            /* Compute optimization offset */
+            pbOffset = pbBitmap + pbYOffset + pbChannel * pbX;
+
+            /* Assign mean value */
+            * ( pbOffset ++ ) = pbAccumR / pbCount;
+            * ( pbOffset ++ ) = pbAccumG / pbCount;
+            * ( pbOffset    ) = pbAccumB / pbCount;
+
+        }
+
+    }
+
+}
+
+
+/**
+ * Compute box means of one row from a summed-area table (4 lanes per
+ * entry, wrapping unsigned sums stay exact for box sums below 2^32).
+ *
+ */
+static void boxRow(const uint32_t *top, const uint32_t *bottom, const int *left, const int *right, const int *count, int channels, unsigned char *dst, int width) {
+    for (int x = 0; x < width; x++) {
+        const uint32_t *a = top + 4 * left[x];
+        const uint32_t *b = top + 4 * right[x];
+        const uint32_t *c = bottom + 4 * left[x];
+        const uint32_t *d = bottom + 4 * right[x];
+
+#ifdef YAFDB_PROGRESSIVE_SSE2
+        __m128i sum = _mm_sub_epi32(
+            _mm_add_epi32(_mm_loadu_si128((const __m128i *)d), _mm_loadu_si128((const __m128i *)a)),
+            _mm_add_epi32(_mm_loadu_si128((const __m128i *)b), _mm_loadu_si128((const __m128i *)c))
+        );
+        __m128i mean = _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(sum), _mm_set1_ps((float)count[x])));
+        int32_t lanes[4];
+
+        _mm_storeu_si128((__m128i *)lanes, mean);
+        for (int k = 0; k < channels; k++) {
+            dst[k] = (unsigned char)lanes[k];
+        }
+#else
+        for (int k = 0; k < channels; k++) {
+            dst[k] = (unsigned char)((float)(d[k] + a[k] - b[k] - c[k]) / count[x]);
+        }
+#endif
+        dst += channels;
+    }
+}
+
+
+void ProgressiveBlur::blur(cv::Mat &image, int x1, int y1, int x2, int y2, int rowBegin, int rowEnd) {
+    if (image.depth() != CV_8U || image.channels() > 4) {
+        return;
+    }
+
+    const int channels = image.channels();
+    int width = x2 - x1;
+    int height = y2 - y1;
+
+    // blurred square around rectangle center (same rounding as reference
+    // within image, rounded down outside so that results do not depend on
+    // the image origin)
+    float cx = (float)width / 2.0 + x1;
+    float cy = (float)height / 2.0 + y1;
+    float factor = width < height ? width : height;
+    int rx1 = floorf(cx - factor);
+    int rx2 = floorf(cx + factor);
+    int ry1 = floorf(cy - factor);
+    int ry2 = floorf(cy + factor);
+    int rw = rx2 - rx1;
+    int rh = ry2 - ry1;
+
+    factor *= 0.2;
+    if (rw <= 0 || rh <= 0) {
+        return;
+    }
+
+    // blurred pixels within image
+    int ox1 = MAX(rx1, 0);
+    int ox2 = MIN(rx2, image.cols - 1);
+    int oy1 = MAX(MAX(ry1, 0), rowBegin);
+    int oy2 = MIN(MIN(ry2, image.rows - 1), rowEnd - 1);
+
+    if (ox1 > ox2 || oy1 > oy2) {
+        return;
+    }
+
+    // box radius is separable: precompute column and row weights
+    std::vector<double> wx(ox2 - ox1 + 1);
+    std::vector<double> wy(oy2 - oy1 + 1);
+
+    for (int x = ox1; x <= ox2; x++) {
+        float u = ((float)(x - rx1) / rw) * 2.0 - 1.0;
+
+        wx[x - ox1] = exp(-u * u * 3.5);
+    }
+    for (int y = oy1; y <= oy2; y++) {
+        float v = ((float)(y - ry1) / rh) * 2.0 - 1.0;
+
+        wy[y - oy1] = exp(-v * v * 3.5);
+    }
+
+    // source columns read by boxes
+    int sx1 = MAX(ox1 - MAX_FORCE, 0);
+    int sx2 = MIN(ox2 + MAX_FORCE, image.cols - 1);
+    int sw = sx2 - sx1 + 1;
+    int ow = ox2 - ox1 + 1;
+
+    // rows are processed by bands, each band output written back once the
+    // table of the next band (which reads its last rows) is built
+    const int band = 128;
+    std::vector<uint32_t> table((size_t)(band + 2 * MAX_FORCE + 1) * (sw + 1) * 4);
+    std::vector<int> left(ow), right(ow), top(ow), bottom(ow), count(ow);
+    cv::Mat pending(band, ow, image.type());
+    int pendingY = -1;
+    int pendingRows = 0;
+
+    auto flush = [&] () {
+        if (pendingRows > 0) {
+            cv::Mat rows(pending, cv::Rect(0, 0, ow, pendingRows));
+            cv::Mat target(image, cv::Rect(ox1, pendingY, ow, pendingRows));
+
+            rows.copyTo(target);
+        }
+        pendingRows = 0;
+    };
+
+    for (int by = oy1; by <= oy2; by += band) {
+        int byEnd = MIN(by + band - 1, oy2);
+        int ty1 = MAX(by - MAX_FORCE, 0);
+        int ty2 = MIN(byEnd + MAX_FORCE, image.rows - 1);
+
+        // summed-area table of source rows [ty1, ty2], columns [sx1, sx2]
+        memset(&table[0], 0, (size_t)(sw + 1) * 4 * sizeof(uint32_t));
+        for (int y = ty1; y <= ty2; y++) {
+            const unsigned char *src = image.ptr<unsigned char>(y) + sx1 * channels;
+            const uint32_t *above = &table[(size_t)(y - ty1) * (sw + 1) * 4];
+            uint32_t *row = &table[(size_t)(y - ty1 + 1) * (sw + 1) * 4];
+            uint32_t sum[4] = { 0, 0, 0, 0 };
+
+            for (int k = 0; k < 4; k++) {
+                row[k] = 0;
+            }
+            for (int x = 0; x < sw; x++) {
+                for (int k = 0; k < channels; k++) {
+                    sum[k] += src[x * channels + k];
+                }
+                for (int k = 0; k < 4; k++) {
+                    row[4 * (x + 1) + k] = above[4 * (x + 1) + k] + sum[k];
+                }
+            }
+        }
+        flush();
+
+        // box means of band rows
+        for (int y = by; y <= byEnd; y++) {
+            double weight = wy[y - oy1];
+
+            for (int x = ox1; x <= ox2; x++) {
+                int force = int(wx[x - ox1] * weight * factor);
+
+                force = force > MAX_FORCE ? MAX_FORCE : force;
+
+                int ax1 = MAX(x - force, 0);
+                int ax2 = MIN(x + force, image.cols - 1);
+                int ay1 = MAX(y - force, 0);
+                int ay2 = MIN(y + force, image.rows - 1);
+
+                left[x - ox1] = ax1 - sx1;
+                right[x - ox1] = ax2 - sx1 + 1;
+                top[x - ox1] = ay1 - ty1;
+                bottom[x - ox1] = ay2 - ty1 + 1;
+                count[x - ox1] = (ax2 - ax1 + 1) * (ay2 - ay1 + 1);
+            }
+
+            // radius varies slowly: columns come in runs sharing table rows
+            unsigned char *dst = pending.ptr<unsigned char>(y - by);
+
+            for (int x = 0; x < ow; ) {
+                int end = x + 1;
+
+                while (end < ow && top[end] == top[x] && bottom[end] == bottom[x]) {
+                    end++;
+                }
+                boxRow(
+                    &table[(size_t)top[x] * (sw + 1) * 4],
+                    &table[(size_t)bottom[x] * (sw + 1) * 4],
+                    &left[x], &right[x], &count[x],
+                    channels,
+                    dst + x * channels,
+                    end - x
+                );
+                x = end;
+            }
+        }
+        pendingY = by;
+        pendingRows = byEnd - by + 1;
+    }
+    flush();
+}
+
+void ProgressiveBlur::reference(cv::Mat &image, int x1, int y1, int x2, int y2) {
+    if (image.type() != CV_8UC3 || !image.isContinuous()) {
+        return;
+    }
+
+    progblur(image.data, image.cols, image.rows, image.channels(), x1, y1, x2, y2);
+}
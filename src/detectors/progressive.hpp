@@ -0,0 +1,90 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#ifndef __YAFDB_DETECTORS_PROGRESSIVE_H_INCLUDE__
+#define __YAFDB_DETECTORS_PROGRESSIVE_H_INCLUDE__
+
+
+#include <limits.h>
+
+#include <opencv2/opencv.hpp>
+
+
+/**
+ * Progressive rectangular blur: pixels of a square centered on the
+ * rectangle (half size = smallest rectangle side) are replaced by the mean
+ * of a box whose radius decreases from the center (at most 32 pixels).
+ *
+ */
+class ProgressiveBlur {
+public:
+    /** Maximum box radius in pixels */
+    static const int MAX_FORCE = 32;
+
+
+    /**
+     * Blur rectangle area. Box sums are taken from summed-area tables of
+     * the original pixels, so each pixel costs the same whatever its box
+     * radius. Pixels outside the image are left out.
+     *
+     * \param image image to blur in place (8-bit, 1 to 4 channels)
+     * \param x1 rectangle left coordinate
+     * \param y1 rectangle top coordinate
+     * \param x2 rectangle right coordinate
+     * \param y2 rectangle bottom coordinate
+     * \param rowBegin first row to blur (rows read extend MAX_FORCE rows around blurred ones)
+     * \param rowEnd last row to blur (excluded)
+     */
+    static void blur(cv::Mat &image, int x1, int y1, int x2, int y2, int rowBegin = 0, int rowEnd = INT_MAX);
+
+    /**
+     * Blur rectangle area with the original per-pixel box loop, which reads
+     * back pixels already blurred (kept as reference for comparisons).
+     *
+     * \param image image to blur in place (8-bit, 3 channels, blurred square within image)
+     * \param x1 rectangle left coordinate
+     * \param y1 rectangle top coordinate
+     * \param x2 rectangle right coordinate
+     * \param y2 rectangle bottom coordinate
+     */
+    static void reference(cv::Mat &image, int x1, int y1, int x2, int y2);
+};
+
+
+#endif //__YAFDB_DETECTORS_PROGRESSIVE_H_INCLUDE__
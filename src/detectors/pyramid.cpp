@@ -0,0 +1,92 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#include <math.h>
+
+#include "pyramid.hpp"
+
+
+EqrPyramid::EqrPyramid(const cv::Mat &source, int minWidth, bool blocked) : blocked(blocked && EqrBlocks::supports(source)) {
+    this->levels.push_back(source);
+    for (int width = source.cols / 2; width >= minWidth; width /= 2) {
+        this->levels.push_back(cv::Mat());
+    }
+    this->blocks.resize(this->levels.size());
+}
+
+const cv::Mat& EqrPyramid::level(int index) {
+    std::lock_guard<std::mutex> guard(this->lock);
+
+    for (int i = 1; i <= index; i++) {
+        if (!this->levels[i].empty()) {
+            continue;
+        }
+
+        // area averaging of 2x2 blocks keeps pixel grids aligned and never
+        // mixes pixels across the eqr seam
+        const cv::Mat &previous = this->levels[i - 1];
+
+        cv::resize(previous, this->levels[i], cv::Size((previous.cols + 1) / 2, (previous.rows + 1) / 2), 0, 0, cv::INTER_AREA);
+    }
+    return this->levels[index];
+}
+
+const EqrBlocks* EqrPyramid::blockedLevel(int index) {
+    if (!this->blocked) {
+        return NULL;
+    }
+
+    const cv::Mat &source = this->level(index);
+    std::lock_guard<std::mutex> guard(this->lock);
+
+    if (!this->blocks[index]) {
+        this->blocks[index].reset(new EqrBlocks(source));
+    }
+    return this->blocks[index].get();
+}
+
+int EqrPyramid::levelFor(double pixelAngle) const {
+    double eqrPixel = 2.0 * M_PI / this->levels[0].cols;
+    int index = 0;
+
+    while (index + 1 < this->count() && eqrPixel * (1 << (index + 1)) <= pixelAngle) {
+        index++;
+    }
+    return index;
+}
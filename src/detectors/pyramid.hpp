@@ -0,0 +1,119 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#ifndef __YAFDB_DETECTORS_PYRAMID_H_INCLUDE__
+#define __YAFDB_DETECTORS_PYRAMID_H_INCLUDE__
+
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "sampler.hpp"
+
+
+/**
+ * Multi-resolution pyramid of an eqr image. Each level halves the
+ * resolution of the previous one and is computed on first use.
+ *
+ */
+class EqrPyramid {
+protected:
+    /** Pyramid levels (level 0 is the source image) */
+    std::vector<cv::Mat> levels;
+
+    /** Cache-blocked copies of levels (optional) */
+    std::vector< std::shared_ptr<EqrBlocks> > blocks;
+
+    /** Use cache-blocked copies of levels */
+    bool blocked;
+
+    /** Level computation lock */
+    std::mutex lock;
+
+
+public:
+    /**
+     * Default constructor.
+     *
+     * \param source eqr image (level 0, not copied)
+     * \param minWidth minimum width in pixels of coarsest level
+     * \param blocked also build cache-blocked copies of levels
+     */
+    EqrPyramid(const cv::Mat &source, int minWidth = 256, bool blocked = false);
+
+
+    /**
+     * Get number of levels.
+     *
+     * \return number of levels
+     */
+    int count() const {
+        return this->levels.size();
+    }
+
+    /**
+     * Get pyramid level, computing it if needed.
+     *
+     * \param index level index
+     * \return eqr image of given level
+     */
+    const cv::Mat& level(int index);
+
+    /**
+     * Get cache-blocked copy of pyramid level, computing it if needed.
+     *
+     * \param index level index
+     * \return blocked eqr image of given level or NULL if not enabled / supported
+     */
+    const EqrBlocks* blockedLevel(int index);
+
+    /**
+     * Find coarsest level whose pixels are not larger than given angle.
+     *
+     * \param pixelAngle angular size of target pixels (in radian)
+     * \return level index
+     */
+    int levelFor(double pixelAngle) const;
+};
+
+
+#endif //__YAFDB_DETECTORS_PYRAMID_H_INCLUDE__
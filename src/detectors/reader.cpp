@@ -0,0 +1,124 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#include <atomic>
+
+#include "parallel.hpp"
+#include "reader.hpp"
+#include "source.hpp"
+
+
+/**
+ * Decode image file with cv::imread into given image (copied only if image
+ * is already allocated).
+ *
+ */
+static bool decode(const std::string &file, cv::Mat &image, int flags) {
+    cv::Mat decoded(cv::imread(file, flags));
+
+    if (decoded.empty()) {
+        return false;
+    }
+    if (image.empty()) {
+        image = decoded;
+    } else {
+        decoded.copyTo(image);
+    }
+    return true;
+}
+
+
+cv::Mat ImageReader::read(const std::string &file, int flags) {
+    cv::Mat image;
+
+    if (!ImageReader::read(file, image, flags)) {
+        return cv::Mat();
+    }
+    return image;
+}
+
+bool ImageReader::read(const std::string &file, cv::Mat &image, int flags) {
+    bool grayscale = (flags == CV_LOAD_IMAGE_GRAYSCALE);
+    TiffSource header(0);
+
+    if ((flags != CV_LOAD_IMAGE_COLOR && !grayscale) || !header.open(file)) {
+        return decode(file, image, flags);
+    }
+    header.setGrayscale(grayscale);
+
+    // decoded in place if image has the right size and type
+    image.create(header.rows(), header.cols(), header.type());
+
+    std::atomic<bool> failed(false);
+
+    // one tiff handle per range of strips
+    ThreadPool::instance().parallelFor(0, header.chunkCount(), 1, [&] (int begin, int end) {
+        TiffSource reader(0);
+
+        if (!reader.open(file)) {
+            failed = true;
+            return;
+        }
+        reader.setGrayscale(grayscale);
+        for (int index = begin; index < end && !failed; index++) {
+            int first = index * reader.chunkHeight();
+            cv::Mat rows(image.rowRange(first, MIN(first + reader.chunkHeight(), image.rows)));
+
+            if (!reader.decode(index, rows)) {
+                failed = true;
+            }
+        }
+    });
+    if (failed) {
+        return decode(file, image, flags);
+    }
+    return true;
+}
+
+bool ImageReader::header(const std::string &file, cv::Size &size, int &type, int flags) {
+    TiffSource header(0);
+
+    if ((flags != CV_LOAD_IMAGE_COLOR && flags != CV_LOAD_IMAGE_GRAYSCALE) || !header.open(file)) {
+        return false;
+    }
+    header.setGrayscale(flags == CV_LOAD_IMAGE_GRAYSCALE);
+    size = cv::Size(header.cols(), header.rows());
+    type = header.type();
+    return true;
+}
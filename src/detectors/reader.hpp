@@ -0,0 +1,93 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#ifndef __YAFDB_DETECTORS_READER_H_INCLUDE__
+#define __YAFDB_DETECTORS_READER_H_INCLUDE__
+
+
+#include <string>
+
+#include <opencv2/opencv.hpp>
+
+
+/**
+ * Image file reader.
+ *
+ */
+class ImageReader {
+public:
+    /**
+     * Read image file. 8-bit tiff strips (or rows of tiles) are decoded in
+     * parallel, each thread with its own file handle, straight into the
+     * returned image. Other formats are read with cv::imread.
+     *
+     * \param file image file path
+     * \param flags CV_LOAD_IMAGE_COLOR (bgr), CV_LOAD_IMAGE_GRAYSCALE or CV_LOAD_IMAGE_UNCHANGED
+     * \return image (empty on error)
+     */
+    static cv::Mat read(const std::string &file, int flags = CV_LOAD_IMAGE_COLOR);
+
+    /**
+     * Read image file into given image. Tiff files are decoded straight
+     * into it when it already has the right size and type (e.g. a view of
+     * a larger buffer), other formats are decoded then copied into it.
+     * Image is allocated otherwise.
+     *
+     * \param file image file path
+     * \param image output image
+     * \param flags CV_LOAD_IMAGE_COLOR (bgr), CV_LOAD_IMAGE_GRAYSCALE or CV_LOAD_IMAGE_UNCHANGED
+     * \return true on success, false otherwise
+     */
+    static bool read(const std::string &file, cv::Mat &image, int flags = CV_LOAD_IMAGE_COLOR);
+
+    /**
+     * Read image size and type from file header, without decoding pixels
+     * (8-bit tiff files only).
+     *
+     * \param file image file path
+     * \param size output image size
+     * \param type output image type
+     * \param flags CV_LOAD_IMAGE_COLOR (bgr) or CV_LOAD_IMAGE_GRAYSCALE
+     * \return true on success, false if file is not a supported tiff
+     */
+    static bool header(const std::string &file, cv::Size &size, int &type, int flags = CV_LOAD_IMAGE_COLOR);
+};
+
+
+#endif //__YAFDB_DETECTORS_READER_H_INCLUDE__
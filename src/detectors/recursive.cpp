@@ -0,0 +1,155 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+
+#include <math.h>
+
+#include <vector>
+
+#include "recursive.hpp"
+
+
+double RecursiveGaussian::sigmaFor(int ksize) {
+    return 0.3 * ((ksize - 1) * 0.5 - 1) + 0.8;
+}
+
+int RecursiveGaussian::ksizeFor(double sigma) {
+    return MAX(2 * (int)floor((sigma - 0.8) / 0.3 + 1.5) + 1, 3);
+}
+
+int RecursiveGaussian::halo(double sigma) {
+    return (int)ceil(4 * sigma);
+}
+
+void RecursiveGaussian::blur(cv::Mat &image, const cv::Rect &target, double sigma) {
+    cv::Rect bounds(0, 0, image.cols, image.rows);
+    cv::Rect area(target & bounds);
+    int halo = RecursiveGaussian::halo(sigma);
+    cv::Rect input(cv::Rect(area.x - halo, area.y - halo, area.width + 2 * halo, area.height + 2 * halo) & bounds);
+    int channels = image.channels();
+    int width = input.width * channels;
+
+    if (area.width <= 0 || area.height <= 0) {
+        return;
+    }
+
+    // filter coefficients (Young & van Vliet, 1995), valid from sigma 0.5
+    double s = MAX(sigma, 0.5);
+    double q = s >= 2.5 ? 0.98711 * s - 0.96330 : 3.97156 - 4.14554 * sqrt(1 - 0.26891 * s);
+    double b0 = 1.57825 + 2.44413 * q + 1.4281 * q * q + 0.422205 * q * q * q;
+    float a1 = (float)((2.44413 * q + 2.85619 * q * q + 1.26661 * q * q * q) / b0);
+    float a2 = (float)(-(1.4281 * q * q + 1.26661 * q * q * q) / b0);
+    float a3 = (float)(0.422205 * q * q * q / b0);
+    float B = 1 - (a1 + a2 + a3);
+    std::vector<float> buffer(input.height * width);
+
+    // horizontal pass, each row filtered forward then backward with the
+    // filter state started as if the border pixel was repeated
+    for (int y = 0; y < input.height; y++) {
+        const unsigned char *src = image.ptr<unsigned char>(input.y + y) + input.x * channels;
+        float *row = &buffer[y * width];
+
+        for (int i = 0; i < width; i++) {
+            row[i] = src[i];
+        }
+        for (int c = 0; c < channels; c++) {
+            float w1 = row[c], w2 = w1, w3 = w1;
+
+            for (int i = c; i < width; i += channels) {
+                float w = B * row[i] + a1 * w1 + a2 * w2 + a3 * w3;
+
+                row[i] = w;
+                w3 = w2;
+                w2 = w1;
+                w1 = w;
+            }
+            w1 = row[width - channels + c];
+            w2 = w1;
+            w3 = w1;
+            for (int i = width - channels + c; i >= 0; i -= channels) {
+                float w = B * row[i] + a1 * w1 + a2 * w2 + a3 * w3;
+
+                row[i] = w;
+                w3 = w2;
+                w2 = w1;
+                w1 = w;
+            }
+        }
+    }
+
+    // vertical pass over target columns, whole rows at a time
+    int begin = (area.x - input.x) * channels;
+    int end = begin + area.width * channels;
+
+    for (int y = 0; y < input.height; y++) {
+        float *row = &buffer[y * width];
+        const float *r1 = &buffer[MAX(y - 1, 0) * width];
+        const float *r2 = &buffer[MAX(y - 2, 0) * width];
+        const float *r3 = &buffer[MAX(y - 3, 0) * width];
+
+        if (y == 0) {
+            continue;
+        }
+        for (int i = begin; i < end; i++) {
+            row[i] = B * row[i] + a1 * r1[i] + a2 * r2[i] + a3 * r3[i];
+        }
+    }
+    for (int y = input.height - 2; y >= 0; y--) {
+        float *row = &buffer[y * width];
+        const float *r1 = &buffer[MIN(y + 1, input.height - 1) * width];
+        const float *r2 = &buffer[MIN(y + 2, input.height - 1) * width];
+        const float *r3 = &buffer[MIN(y + 3, input.height - 1) * width];
+
+        for (int i = begin; i < end; i++) {
+            row[i] = B * row[i] + a1 * r1[i] + a2 * r2[i] + a3 * r3[i];
+        }
+    }
+
+    // write back target pixels
+    for (int y = area.y; y < area.y + area.height; y++) {
+        const float *row = &buffer[(y - input.y) * width] + begin;
+        unsigned char *dst = image.ptr<unsigned char>(y) + area.x * channels;
+
+        for (int i = 0; i < end - begin; i++) {
+            float v = row[i] + 0.5f;
+
+            dst[i] = (unsigned char)(v < 0 ? 0 : (v > 255 ? 255 : v));
+        }
+    }
+}
@@ -0,0 +1,93 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+
+#ifndef __YAFDB_DETECTORS_RECURSIVE_H_INCLUDE__
+#define __YAFDB_DETECTORS_RECURSIVE_H_INCLUDE__
+
+
+#include <opencv2/opencv.hpp>
+
+
+/**
+ * Recursive (IIR) gaussian blur after Young and van Vliet: a third order
+ * causal and anti-causal filter pair per axis approximates the gaussian,
+ * so each pixel costs the same whatever the sigma.
+ *
+ */
+class RecursiveGaussian {
+public:
+    /**
+     * Gaussian sigma matching a kernel size (same rule as cv::GaussianBlur
+     * with sigma 0).
+     *
+     * \param ksize kernel size
+     * \return sigma
+     */
+    static double sigmaFor(int ksize);
+
+    /**
+     * Odd kernel size matching a gaussian sigma (inverse of sigmaFor).
+     *
+     * \param sigma gaussian sigma
+     * \return kernel size (at least 3)
+     */
+    static int ksizeFor(double sigma);
+
+    /**
+     * Pixels read around blurred area.
+     *
+     * \param sigma gaussian sigma
+     * \return halo in pixels
+     */
+    static int halo(double sigma);
+
+    /**
+     * Blur image area in place. Pixels are read up to halo(sigma) around
+     * target; image borders are extended by replication.
+     *
+     * \param image image to blur (8-bit, any number of channels)
+     * \param target area to blur
+     * \param sigma gaussian sigma
+     */
+    static void blur(cv::Mat &image, const cv::Rect &target, double sigma);
+};
+
+
+#endif //__YAFDB_DETECTORS_RECURSIVE_H_INCLUDE__
@@ -0,0 +1,171 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#include "parallel.hpp"
+#include "regions.hpp"
+
+
+RegionFilters::RegionFilters(const cv::Mat &image, int wrapWidth, int wrapMargin) : image(image), wrapWidth(wrapWidth), wrapMargin(wrapMargin) {
+}
+
+void RegionFilters::add(const cv::Rect &output, int halo, const Filter &filter) {
+    cv::Rect bounds(0, 0, this->image.cols, this->image.rows);
+    Region region;
+
+    region.output = output & bounds;
+    region.halo = halo;
+    region.filter = filter;
+    if (region.output.width <= 0 || region.output.height <= 0) {
+        return;
+    }
+
+    // columns at either side of the seam are copied to the other side once
+    // written, so a region also touches their duplicates
+    cv::Rect footprint(cv::Rect(output.x - halo, output.y - halo, output.width + 2 * halo, output.height + 2 * halo) & bounds);
+
+    region.footprints.push_back(footprint);
+    if (this->wrapMargin > 0) {
+        if (footprint.x < this->wrapMargin) {
+            region.footprints.push_back(cv::Rect(footprint.x + this->wrapWidth, footprint.y, footprint.width, footprint.height) & bounds);
+        }
+        if (footprint.x + footprint.width > this->wrapWidth) {
+            region.footprints.push_back(cv::Rect(footprint.x - this->wrapWidth, footprint.y, footprint.width, footprint.height) & bounds);
+        }
+    }
+    this->regions.push_back(region);
+}
+
+void RegionFilters::run(const std::function<void(const cv::Rect &)> &written, int bandPixels) {
+    cv::Rect bounds(0, 0, this->image.cols, this->image.rows);
+
+    // level of a region comes after the levels of overlapping earlier regions
+    std::vector<int> levels(this->regions.size(), 0);
+    int levelCount = 0;
+
+    for (size_t i = 0; i < this->regions.size(); i++) {
+        for (size_t j = 0; j < i; j++) {
+            if (levels[j] < levels[i]) {
+                continue;
+            }
+
+            bool overlap = false;
+
+            for (auto a = this->regions[i].footprints.begin(); a != this->regions[i].footprints.end() && !overlap; ++a) {
+                for (auto b = this->regions[j].footprints.begin(); b != this->regions[j].footprints.end() && !overlap; ++b) {
+                    overlap = ((*a) & (*b)).area() > 0;
+                }
+            }
+            if (overlap) {
+                levels[i] = levels[j] + 1;
+            }
+        }
+        levelCount = MAX(levelCount, levels[i] + 1);
+    }
+
+    // bands of rows of one level
+    typedef struct {
+        /** Region index */
+        size_t region;
+
+        /** Output rows */
+        cv::Rect output;
+
+        /** Private copy of input */
+        cv::Mat window;
+
+        /** Position of window in image */
+        cv::Point origin;
+    } Band;
+
+    for (int level = 0; level < levelCount; level++) {
+        std::vector<Band> bands;
+
+        for (size_t i = 0; i < this->regions.size(); i++) {
+            const Region &region = this->regions[i];
+
+            if (levels[i] != level) {
+                continue;
+            }
+
+            // bands keep halo rows small relative to their own rows
+            int rows = MAX(bandPixels / region.output.width, 4 * region.halo);
+
+            rows = MAX(rows, 1);
+            for (int y = region.output.y; y < region.output.y + region.output.height; y += rows) {
+                Band band;
+
+                band.region = i;
+                band.output = cv::Rect(region.output.x, y, region.output.width, MIN(rows, region.output.y + region.output.height - y));
+                bands.push_back(band);
+            }
+        }
+
+        // copy inputs before any band of the level writes
+        ThreadPool::instance().parallelFor(0, bands.size(), 1, [&] (int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                Band &band = bands[i];
+                int halo = this->regions[band.region].halo;
+                cv::Rect input(cv::Rect(band.output.x - halo, band.output.y - halo, band.output.width + 2 * halo, band.output.height + 2 * halo) & bounds);
+
+                band.window = cv::Mat(this->image, input).clone();
+                band.origin = input.tl();
+            }
+        });
+
+        // filter bands and write them back
+        ThreadPool::instance().parallelFor(0, bands.size(), 1, [&] (int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                Band &band = bands[i];
+                cv::Rect target(band.output.x - band.origin.x, band.output.y - band.origin.y, band.output.width, band.output.height);
+                cv::Mat output(this->image, band.output);
+
+                this->regions[band.region].filter(band.window, band.origin, target);
+                cv::Mat(band.window, target).copyTo(output);
+                band.window.release();
+            }
+        });
+
+        for (size_t i = 0; i < this->regions.size(); i++) {
+            if (levels[i] == level) {
+                written(this->regions[i].output);
+            }
+        }
+    }
+    this->regions.clear();
+}
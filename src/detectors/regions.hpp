@@ -0,0 +1,133 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#ifndef __YAFDB_DETECTORS_REGIONS_H_INCLUDE__
+#define __YAFDB_DETECTORS_REGIONS_H_INCLUDE__
+
+
+#include <functional>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+
+/**
+ * Ordered list of region filters (e.g. object blurs) applied to an image
+ * in parallel. Regions whose footprints (output plus halo read around it)
+ * do not overlap run concurrently, overlapping ones keep their order.
+ * Large regions are split into bands of rows, each band filtering a
+ * private copy of its input so that results match a serial run.
+ *
+ */
+class RegionFilters {
+public:
+    /**
+     * Region filter: updates target area of window in place. Window is a
+     * copy of the image around target (halo included, clipped to image).
+     *
+     * \param window private copy of image area
+     * \param origin position of window in image
+     * \param target area to compute, in window coordinates
+     */
+    typedef std::function<void(cv::Mat &window, const cv::Point &origin, const cv::Rect &target)> Filter;
+
+
+protected:
+    /**
+     * Queued region.
+     *
+     */
+    typedef struct {
+        /** Output area in image */
+        cv::Rect output;
+
+        /** Pixels read around output */
+        int halo;
+
+        /** Region filter */
+        Filter filter;
+
+        /** Footprints (with duplicates across seam) */
+        std::vector<cv::Rect> footprints;
+    } Region;
+
+    /** Filtered image */
+    cv::Mat image;
+
+    /** Eqr width of wrap-padded image (0 if not padded) */
+    int wrapWidth;
+
+    /** Columns duplicated past the seam */
+    int wrapMargin;
+
+    /** Queued regions */
+    std::vector<Region> regions;
+
+
+public:
+    /**
+     * Default constructor.
+     *
+     * \param image image to filter in place
+     * \param wrapWidth eqr width if image is wrap-padded (see WrappedEqr), 0 otherwise
+     * \param wrapMargin columns duplicated past the seam
+     */
+    RegionFilters(const cv::Mat &image, int wrapWidth = 0, int wrapMargin = 0);
+
+
+    /**
+     * Queue region filter.
+     *
+     * \param output area written by filter
+     * \param halo pixels read around output
+     * \param filter region filter
+     */
+    void add(const cv::Rect &output, int halo, const Filter &filter);
+
+    /**
+     * Apply queued filters and clear queue.
+     *
+     * \param written function called with output area of each region once written
+     * \param bandPixels approximate number of output pixels per band of rows
+     */
+    void run(const std::function<void(const cv::Rect &)> &written, int bandPixels = 1 << 18);
+};
+
+
+#endif //__YAFDB_DETECTORS_REGIONS_H_INCLUDE__
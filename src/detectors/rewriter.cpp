@@ -0,0 +1,320 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+
+#include <string.h>
+
+#include <vector>
+
+#include <tiffio.h>
+
+#include "rewriter.hpp"
+#include "source.hpp"
+
+
+/**
+ * Copy integer tag (stored as 16-bit) if set in source.
+ *
+ */
+static void copyShort(TIFF *input, TIFF *output, uint32_t tag) {
+    uint16_t value;
+
+    if (TIFFGetField(input, tag, &value)) {
+        TIFFSetField(output, tag, value);
+    }
+}
+
+/**
+ * Copy rational tag if set in source.
+ *
+ */
+static void copyFloat(TIFF *input, TIFF *output, uint32_t tag) {
+    float value;
+
+    if (TIFFGetField(input, tag, &value)) {
+        TIFFSetField(output, tag, (double)value);
+    }
+}
+
+/**
+ * Copy ascii tag if set in source.
+ *
+ */
+static void copyString(TIFF *input, TIFF *output, uint32_t tag) {
+    char *value = NULL;
+
+    if (TIFFGetField(input, tag, &value) && value != NULL) {
+        TIFFSetField(output, tag, value);
+    }
+}
+
+
+TiffRewriter::TiffRewriter() : input(NULL), output(NULL), width(0), height(0), samples(0), tiled(false), tileWidth(0), chunkRows(0) {
+}
+
+TiffRewriter::~TiffRewriter() {
+    if (this->output != NULL) {
+        TIFFClose(this->output);
+    }
+    if (this->input != NULL) {
+        TIFFClose(this->input);
+    }
+}
+
+bool TiffRewriter::open(const std::string &source, const std::string &target) {
+    uint32_t imageWidth = 0, imageHeight = 0;
+    uint16_t bitsPerSample = 0, samplesPerPixel = 0, planarConfig = 0, compression = COMPRESSION_NONE, photometric = 0;
+    uint16_t extraCount = 0;
+    uint16_t *extraTypes = NULL;
+
+    if (source == target || !TiffSource::isTiff(source)) {
+        return false;
+    }
+    this->input = TIFFOpen(source.c_str(), "r");
+    if (this->input == NULL) {
+        return false;
+    }
+    TIFFGetField(this->input, TIFFTAG_IMAGEWIDTH, &imageWidth);
+    TIFFGetField(this->input, TIFFTAG_IMAGELENGTH, &imageHeight);
+    TIFFGetFieldDefaulted(this->input, TIFFTAG_BITSPERSAMPLE, &bitsPerSample);
+    TIFFGetFieldDefaulted(this->input, TIFFTAG_SAMPLESPERPIXEL, &samplesPerPixel);
+    TIFFGetFieldDefaulted(this->input, TIFFTAG_PLANARCONFIG, &planarConfig);
+    TIFFGetFieldDefaulted(this->input, TIFFTAG_COMPRESSION, &compression);
+    TIFFGetField(this->input, TIFFTAG_PHOTOMETRIC, &photometric);
+    TIFFGetField(this->input, TIFFTAG_EXTRASAMPLES, &extraCount, &extraTypes);
+
+    // strips are copied as they are: compressions with shared tables
+    // (e.g. jpeg) are left out
+    bool copyable = compression == COMPRESSION_NONE || compression == COMPRESSION_LZW || compression == COMPRESSION_ADOBE_DEFLATE ||
+        compression == COMPRESSION_DEFLATE || compression == COMPRESSION_PACKBITS;
+
+    // only gray and rgb(a) pixels are blurred as they are stored (palette
+    // indices, cmyk or other extra samples are not)
+    bool gray = samplesPerPixel == 1 && (photometric == PHOTOMETRIC_MINISBLACK || photometric == PHOTOMETRIC_MINISWHITE);
+    bool alpha = extraCount == 1 && (extraTypes[0] == EXTRASAMPLE_ASSOCALPHA || extraTypes[0] == EXTRASAMPLE_UNASSALPHA);
+    bool rgb = photometric == PHOTOMETRIC_RGB && (samplesPerPixel == 3 || (samplesPerPixel == 4 && alpha));
+
+    if (imageWidth == 0 || imageHeight == 0 || bitsPerSample != 8 || planarConfig != PLANARCONFIG_CONTIG ||
+        (!gray && !rgb) || !copyable) {
+        TIFFClose(this->input);
+        this->input = NULL;
+        return false;
+    }
+
+    this->width = imageWidth;
+    this->height = imageHeight;
+    this->samples = samplesPerPixel;
+    this->tiled = TIFFIsTiled(this->input);
+    if (this->tiled) {
+        uint32_t tileWidth = 0, tileLength = 0;
+
+        TIFFGetField(this->input, TIFFTAG_TILEWIDTH, &tileWidth);
+        TIFFGetField(this->input, TIFFTAG_TILELENGTH, &tileLength);
+        this->tileWidth = tileWidth;
+        this->chunkRows = tileLength;
+    } else {
+        uint32_t rowsPerStrip = 0;
+
+        TIFFGetFieldDefaulted(this->input, TIFFTAG_ROWSPERSTRIP, &rowsPerStrip);
+        this->chunkRows = MIN(rowsPerStrip, imageHeight);
+    }
+    if (this->chunkRows <= 0 || (this->tiled && this->tileWidth <= 0)) {
+        TIFFClose(this->input);
+        this->input = NULL;
+        return false;
+    }
+
+    // target gets the source layout and descriptive tags
+    this->output = TIFFOpen(target.c_str(), TIFFIsBigTIFF(this->input) ? "w8" : "w");
+    if (this->output == NULL) {
+        TIFFClose(this->input);
+        this->input = NULL;
+        return false;
+    }
+    TIFFSetField(this->output, TIFFTAG_IMAGEWIDTH, imageWidth);
+    TIFFSetField(this->output, TIFFTAG_IMAGELENGTH, imageHeight);
+    TIFFSetField(this->output, TIFFTAG_BITSPERSAMPLE, bitsPerSample);
+    TIFFSetField(this->output, TIFFTAG_SAMPLESPERPIXEL, samplesPerPixel);
+    TIFFSetField(this->output, TIFFTAG_PLANARCONFIG, planarConfig);
+    TIFFSetField(this->output, TIFFTAG_COMPRESSION, compression);
+    if (this->tiled) {
+        TIFFSetField(this->output, TIFFTAG_TILEWIDTH, (uint32_t)this->tileWidth);
+        TIFFSetField(this->output, TIFFTAG_TILELENGTH, (uint32_t)this->chunkRows);
+    } else {
+        TIFFSetField(this->output, TIFFTAG_ROWSPERSTRIP, (uint32_t)this->chunkRows);
+    }
+    copyShort(this->input, this->output, TIFFTAG_PHOTOMETRIC);
+    copyShort(this->input, this->output, TIFFTAG_PREDICTOR);
+    copyShort(this->input, this->output, TIFFTAG_FILLORDER);
+    copyShort(this->input, this->output, TIFFTAG_ORIENTATION);
+    copyShort(this->input, this->output, TIFFTAG_RESOLUTIONUNIT);
+    copyFloat(this->input, this->output, TIFFTAG_XRESOLUTION);
+    copyFloat(this->input, this->output, TIFFTAG_YRESOLUTION);
+    copyString(this->input, this->output, TIFFTAG_IMAGEDESCRIPTION);
+    copyString(this->input, this->output, TIFFTAG_MAKE);
+    copyString(this->input, this->output, TIFFTAG_MODEL);
+    copyString(this->input, this->output, TIFFTAG_SOFTWARE);
+    copyString(this->input, this->output, TIFFTAG_DATETIME);
+    copyString(this->input, this->output, TIFFTAG_ARTIST);
+
+    if (extraCount > 0) {
+        TIFFSetField(this->output, TIFFTAG_EXTRASAMPLES, extraCount, extraTypes);
+    }
+
+    uint32_t profileSize = 0;
+    void *profile = NULL;
+
+    if (TIFFGetField(this->input, TIFFTAG_ICCPROFILE, &profileSize, &profile) && profileSize > 0) {
+        TIFFSetField(this->output, TIFFTAG_ICCPROFILE, profileSize, profile);
+    }
+    return true;
+}
+
+bool TiffRewriter::close() {
+    bool success = this->output != NULL && TIFFWriteDirectory(this->output);
+
+    if (this->output != NULL) {
+        TIFFClose(this->output);
+        this->output = NULL;
+    }
+    if (this->input != NULL) {
+        TIFFClose(this->input);
+        this->input = NULL;
+    }
+    return success;
+}
+
+bool TiffRewriter::read(int begin, int end, cv::Mat &pixels) {
+    begin = MAX(begin, 0);
+    end = MIN(end, this->height);
+    if (this->input == NULL || begin >= end) {
+        return false;
+    }
+
+    std::vector<unsigned char> buffer(this->tiled ? TIFFTileSize(this->input) : TIFFStripSize(this->input));
+    size_t rowSize = (size_t)this->width * this->samples;
+
+    pixels.create(end - begin, this->width, CV_8UC(this->samples));
+    for (int index = begin / this->chunkRows; index * this->chunkRows < end; index++) {
+        int first = index * this->chunkRows;
+        int row0 = MAX(begin, first);
+        int row1 = MIN(end, first + this->chunkRows);
+
+        if (this->tiled) {
+            size_t tileStep = (size_t)this->tileWidth * this->samples;
+
+            for (int x = 0; x < this->width; x += this->tileWidth) {
+                int columns = MIN(this->tileWidth, this->width - x);
+
+                if (TIFFReadEncodedTile(this->input, TIFFComputeTile(this->input, x, first, 0, 0), &buffer[0], buffer.size()) < 0) {
+                    return false;
+                }
+                for (int r = row0; r < row1; r++) {
+                    memcpy(pixels.ptr(r - begin) + x * this->samples, &buffer[(r - first) * tileStep], columns * this->samples);
+                }
+            }
+        } else {
+            if (TIFFReadEncodedStrip(this->input, index, &buffer[0], buffer.size()) < 0) {
+                return false;
+            }
+            for (int r = row0; r < row1; r++) {
+                memcpy(pixels.ptr(r - begin), &buffer[(r - first) * rowSize], rowSize);
+            }
+        }
+    }
+    return true;
+}
+
+bool TiffRewriter::copy(int index) {
+    uint64_t *counts = NULL;
+    std::vector<unsigned char> buffer;
+
+    if (this->input == NULL || this->output == NULL) {
+        return false;
+    }
+
+    // raw bytes of the strip (or of each tile of the row)
+    if (!TIFFGetField(this->input, this->tiled ? TIFFTAG_TILEBYTECOUNTS : TIFFTAG_STRIPBYTECOUNTS, &counts) || counts == NULL) {
+        return false;
+    }
+    if (this->tiled) {
+        for (int x = 0; x < this->width; x += this->tileWidth) {
+            ttile_t tile = TIFFComputeTile(this->input, x, index * this->chunkRows, 0, 0);
+
+            buffer.resize(MAX(counts[tile], (uint64_t)1));
+            if (TIFFReadRawTile(this->input, tile, &buffer[0], counts[tile]) < 0 ||
+                TIFFWriteRawTile(this->output, tile, &buffer[0], counts[tile]) < 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+    buffer.resize(MAX(counts[index], (uint64_t)1));
+    return TIFFReadRawStrip(this->input, index, &buffer[0], counts[index]) >= 0 &&
+        TIFFWriteRawStrip(this->output, index, &buffer[0], counts[index]) >= 0;
+}
+
+bool TiffRewriter::write(int index, const cv::Mat &pixels) {
+    int first = index * this->chunkRows;
+    int rows = MIN(this->chunkRows, this->height - first);
+
+    if (this->output == NULL || pixels.rows != rows || pixels.cols != this->width || pixels.type() != CV_8UC(this->samples)) {
+        return false;
+    }
+    if (this->tiled) {
+        std::vector<unsigned char> tile(TIFFTileSize(this->output), 0);
+        size_t tileStep = (size_t)this->tileWidth * this->samples;
+
+        for (int x = 0; x < this->width; x += this->tileWidth) {
+            int columns = MIN(this->tileWidth, this->width - x);
+
+            for (int r = 0; r < rows; r++) {
+                memcpy(&tile[r * tileStep], pixels.ptr(r) + x * this->samples, columns * this->samples);
+            }
+            if (TIFFWriteEncodedTile(this->output, TIFFComputeTile(this->output, x, first, 0, 0), &tile[0], tile.size()) < 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    cv::Mat strip(pixels.isContinuous() ? pixels : pixels.clone());
+
+    return TIFFWriteEncodedStrip(this->output, index, strip.data, (tmsize_t)strip.total() * strip.elemSize()) >= 0;
+}
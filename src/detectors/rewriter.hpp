@@ -0,0 +1,201 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+
+#ifndef __YAFDB_DETECTORS_REWRITER_H_INCLUDE__
+#define __YAFDB_DETECTORS_REWRITER_H_INCLUDE__
+
+
+#include <string>
+
+#include <opencv2/opencv.hpp>
+
+
+typedef struct tiff TIFF;
+
+
+/**
+ * Copy of a tiff file strip by strip (or row of tiles by row of tiles),
+ * with the same layout and compression. Strips are either copied as they
+ * are, without decoding, or replaced by new pixels encoded in the target.
+ * Strips must be written in order, each one exactly once.
+ *
+ * Supports 8-bit interleaved gray (min-is-black or min-is-white) and rgb
+ * images, with an optional alpha sample, compressed without tables (none,
+ * lzw, deflate, packbits); pixels are handled in file sample order.
+ *
+ */
+class TiffRewriter {
+protected:
+    /** Source file handle */
+    TIFF *input;
+
+    /** Target file handle */
+    TIFF *output;
+
+    /** Image width in pixels */
+    int width;
+
+    /** Image height in pixels */
+    int height;
+
+    /** Number of samples per pixel */
+    int samples;
+
+    /** Tiled file */
+    bool tiled;
+
+    /** Tile width (tiled files) */
+    int tileWidth;
+
+    /** Rows per strip (or tile height) */
+    int chunkRows;
+
+
+private:
+    TiffRewriter(const TiffRewriter &);
+    TiffRewriter &operator=(const TiffRewriter &);
+
+
+public:
+    /**
+     * Default constructor.
+     *
+     */
+    TiffRewriter();
+
+    /**
+     * Close files.
+     */
+    ~TiffRewriter();
+
+
+    /**
+     * Open source file and create target file with the same layout.
+     *
+     * \param source source tiff file path
+     * \param target target tiff file path (must differ from source)
+     * \return true on success, false otherwise (unsupported format, target not created)
+     */
+    bool open(const std::string &source, const std::string &target);
+
+    /**
+     * Write target directory and close files.
+     *
+     * \return true on success, false otherwise
+     */
+    bool close();
+
+
+    /**
+     * Get image width.
+     *
+     * \return width in pixels
+     */
+    int cols() const {
+        return this->width;
+    }
+
+    /**
+     * Get image height.
+     *
+     * \return height in pixels
+     */
+    int rows() const {
+        return this->height;
+    }
+
+    /**
+     * Get pixel type (CV_8UC1, CV_8UC3 or CV_8UC4, file sample order).
+     *
+     * \return opencv type
+     */
+    int type() const {
+        return CV_8UC(this->samples);
+    }
+
+    /**
+     * Get number of strips (or rows of tiles).
+     *
+     * \return number of strips
+     */
+    int chunkCount() const {
+        return (this->height + this->chunkRows - 1) / this->chunkRows;
+    }
+
+    /**
+     * Get number of rows per strip (except last one).
+     *
+     * \return number of rows
+     */
+    int chunkHeight() const {
+        return this->chunkRows;
+    }
+
+
+    /**
+     * Decode rows of source.
+     *
+     * \param begin first row
+     * \param end last row (excluded)
+     * \param pixels output pixels
+     * \return true on success, false otherwise
+     */
+    bool read(int begin, int end, cv::Mat &pixels);
+
+    /**
+     * Copy strip from source to target without decoding it.
+     *
+     * \param index strip index
+     * \return true on success, false otherwise
+     */
+    bool copy(int index);
+
+    /**
+     * Encode strip in target.
+     *
+     * \param index strip index
+     * \param pixels strip pixels (all rows of the strip)
+     * \return true on success, false otherwise
+     */
+    bool write(int index, const cv::Mat &pixels);
+};
+
+
+#endif //__YAFDB_DETECTORS_REWRITER_H_INCLUDE__
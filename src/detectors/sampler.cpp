@@ -0,0 +1,501 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+#include "parallel.hpp"
+#include "sampler.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define YAFDB_SAMPLER_X86
+#include <immintrin.h>
+#endif
+
+
+/**
+ * Bilinear sampling of one pixel, with seam wrapping and pole clamping.
+ *
+ */
+static inline void bilinearPixel(const unsigned char *data, size_t step, int width, int height, int channels, float sx, float sy, unsigned char *dst) {
+    float fx0 = floorf(sx);
+    float fy0 = floorf(sy);
+    int x0 = (int)fx0;
+    int y0 = (int)fy0;
+    int fx = (int)((sx - fx0) * 256.0f);
+    int fy = (int)((sy - fy0) * 256.0f);
+    int y1 = y0 + 1;
+
+    x0 %= width;
+    if (x0 < 0) {
+        x0 += width;
+    }
+    int x1 = x0 + 1 < width ? x0 + 1 : 0;
+
+    y0 = y0 < 0 ? 0 : (y0 >= height ? height - 1 : y0);
+    y1 = y1 < 0 ? 0 : (y1 >= height ? height - 1 : y1);
+
+    const unsigned char *p00 = data + y0 * step + x0 * channels;
+    const unsigned char *p01 = data + y0 * step + x1 * channels;
+    const unsigned char *p10 = data + y1 * step + x0 * channels;
+    const unsigned char *p11 = data + y1 * step + x1 * channels;
+
+    for (int c = 0; c < channels; c++) {
+        int top = p00[c] * (256 - fx) + p01[c] * fx;
+        int bottom = p10[c] * (256 - fx) + p11[c] * fx;
+
+        dst[c] = (unsigned char)((top * (256 - fy) + bottom * fy + (1 << 15)) >> 16);
+    }
+}
+
+/**
+ * Scalar bilinear sampling of a row of pixels.
+ *
+ */
+static void bilinearScalar(const unsigned char *data, size_t step, int width, int height, int channels, const float *x, const float *y, unsigned char *dst, int count) {
+    for (int i = 0; i < count; i++) {
+        bilinearPixel(data, step, width, height, channels, x[i], y[i], dst + i * channels);
+    }
+}
+
+/**
+ * Bilinear sampling of one pixel from blocked storage (same results as
+ * bilinearPixel, seam and pole handled by block borders).
+ *
+ */
+static inline void bilinearBlockPixel(const EqrBlocks &src, float sx, float sy, unsigned char *dst) {
+    float fx0 = floorf(sx);
+    float fy0 = floorf(sy);
+    int x0 = (int)fx0;
+    int y0 = (int)fy0;
+    int fx = (int)((sx - fx0) * 256.0f);
+    int fy = (int)((sy - fy0) * 256.0f);
+    int channels = src.channels();
+
+    x0 %= src.cols();
+    if (x0 < 0) {
+        x0 += src.cols();
+    }
+    if (y0 < 0) {
+        y0 = 0;
+        fy = 0;
+    } else if (y0 >= src.rows() - 1) {
+        y0 = src.rows() - 1;
+        fy = 0;
+    }
+
+    const unsigned char *p00 = src.pixel(x0, y0);
+    const unsigned char *p01 = p00 + channels;
+    const unsigned char *p10 = p00 + src.stride();
+    const unsigned char *p11 = p10 + channels;
+
+    for (int c = 0; c < channels; c++) {
+        int top = p00[c] * (256 - fx) + p01[c] * fx;
+        int bottom = p10[c] * (256 - fx) + p11[c] * fx;
+
+        dst[c] = (unsigned char)((top * (256 - fy) + bottom * fy + (1 << 15)) >> 16);
+    }
+}
+
+/**
+ * Scalar bilinear sampling of a row of pixels from blocked storage.
+ *
+ */
+static void bilinearBlockScalar(const EqrBlocks &src, const float *x, const float *y, unsigned char *dst, int count) {
+    for (int i = 0; i < count; i++) {
+        bilinearBlockPixel(src, x[i], y[i], dst + i * src.channels());
+    }
+}
+
+
+#ifdef YAFDB_SAMPLER_X86
+
+/**
+ * AVX2 bilinear sampling of a row of single channel pixels.
+ *
+ */
+__attribute__((target("avx2")))
+static void bilinearAvx2C1(const unsigned char *data, size_t step, int width, int height, const float *x, const float *y, unsigned char *dst, int count) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i maxX = _mm256_set1_epi32(width - 4);
+    const __m256i maxY = _mm256_set1_epi32(height - 2);
+    const __m256i stride = _mm256_set1_epi32((int)step);
+    const __m256i unit = _mm256_set1_epi32(256);
+    const __m256i half = _mm256_set1_epi32(1 << 15);
+    const __m256i low = _mm256_set1_epi32(0xff);
+    const __m256 scale = _mm256_set1_ps(256.0f);
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 sx = _mm256_loadu_ps(x + i);
+        __m256 sy = _mm256_loadu_ps(y + i);
+        __m256 fx0 = _mm256_floor_ps(sx);
+        __m256 fy0 = _mm256_floor_ps(sy);
+        __m256i x0 = _mm256_cvttps_epi32(fx0);
+        __m256i y0 = _mm256_cvttps_epi32(fy0);
+
+        // pixels near the seam or the poles go through the scalar path
+        __m256i outside = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpgt_epi32(zero, x0), _mm256_cmpgt_epi32(x0, maxX)),
+            _mm256_or_si256(_mm256_cmpgt_epi32(zero, y0), _mm256_cmpgt_epi32(y0, maxY))
+        );
+
+        if (!_mm256_testz_si256(outside, outside)) {
+            bilinearScalar(data, step, width, height, 1, x + i, y + i, dst + i, 8);
+            continue;
+        }
+
+        __m256i fx = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_sub_ps(sx, fx0), scale));
+        __m256i fy = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_sub_ps(sy, fy0), scale));
+        __m256i offset = _mm256_add_epi32(_mm256_mullo_epi32(y0, stride), x0);
+
+        // fetch 2x2 neighbourhoods (4 bytes per row, 2 used)
+        __m256i row0 = _mm256_i32gather_epi32((const int *)data, offset, 1);
+        __m256i row1 = _mm256_i32gather_epi32((const int *)data, _mm256_add_epi32(offset, stride), 1);
+        __m256i p00 = _mm256_and_si256(row0, low);
+        __m256i p01 = _mm256_and_si256(_mm256_srli_epi32(row0, 8), low);
+        __m256i p10 = _mm256_and_si256(row1, low);
+        __m256i p11 = _mm256_and_si256(_mm256_srli_epi32(row1, 8), low);
+
+        __m256i top = _mm256_add_epi32(_mm256_mullo_epi32(p00, _mm256_sub_epi32(unit, fx)), _mm256_mullo_epi32(p01, fx));
+        __m256i bottom = _mm256_add_epi32(_mm256_mullo_epi32(p10, _mm256_sub_epi32(unit, fx)), _mm256_mullo_epi32(p11, fx));
+        __m256i value = _mm256_add_epi32(_mm256_mullo_epi32(top, _mm256_sub_epi32(unit, fy)), _mm256_mullo_epi32(bottom, fy));
+
+        value = _mm256_srli_epi32(_mm256_add_epi32(value, half), 16);
+
+        __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(value), _mm256_extracti128_si256(value, 1));
+
+        _mm_storel_epi64((__m128i *)(dst + i), _mm_packus_epi16(words, words));
+    }
+    bilinearScalar(data, step, width, height, 1, x + i, y + i, dst + i, count - i);
+}
+
+/**
+ * SSE4.1 bilinear sampling of a row of 3 channels pixels.
+ *
+ */
+__attribute__((target("sse4.1")))
+static void bilinearSse41C3(const unsigned char *data, size_t step, int width, int height, const float *x, const float *y, unsigned char *dst, int count) {
+    const __m128i unit = _mm_set1_epi32(256);
+    const __m128i half = _mm_set1_epi32(1 << 15);
+
+    for (int i = 0; i < count; i++) {
+        float fx0 = floorf(x[i]);
+        float fy0 = floorf(y[i]);
+        int x0 = (int)fx0;
+        int y0 = (int)fy0;
+
+        // pixels near the seam or the poles go through the scalar path
+        if (x0 < 0 || x0 > width - 4 || y0 < 0 || y0 > height - 2) {
+            bilinearPixel(data, step, width, height, 3, x[i], y[i], dst + i * 3);
+            continue;
+        }
+
+        __m128i fx = _mm_set1_epi32((int)((x[i] - fx0) * 256.0f));
+        __m128i fy = _mm_set1_epi32((int)((y[i] - fy0) * 256.0f));
+        const unsigned char *p0 = data + y0 * step + x0 * 3;
+
+        // fetch 2 pixels per row (8 bytes, 6 used)
+        __m128i row0 = _mm_loadl_epi64((const __m128i *)p0);
+        __m128i row1 = _mm_loadl_epi64((const __m128i *)(p0 + step));
+        __m128i p00 = _mm_cvtepu8_epi32(row0);
+        __m128i p01 = _mm_cvtepu8_epi32(_mm_srli_si128(row0, 3));
+        __m128i p10 = _mm_cvtepu8_epi32(row1);
+        __m128i p11 = _mm_cvtepu8_epi32(_mm_srli_si128(row1, 3));
+
+        __m128i top = _mm_add_epi32(_mm_mullo_epi32(p00, _mm_sub_epi32(unit, fx)), _mm_mullo_epi32(p01, fx));
+        __m128i bottom = _mm_add_epi32(_mm_mullo_epi32(p10, _mm_sub_epi32(unit, fx)), _mm_mullo_epi32(p11, fx));
+        __m128i value = _mm_add_epi32(_mm_mullo_epi32(top, _mm_sub_epi32(unit, fy)), _mm_mullo_epi32(bottom, fy));
+
+        value = _mm_srli_epi32(_mm_add_epi32(value, half), 16);
+
+        __m128i words = _mm_packus_epi32(value, value);
+        int pixel = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+
+        dst[i * 3 + 0] = (unsigned char)(pixel);
+        dst[i * 3 + 1] = (unsigned char)(pixel >> 8);
+        dst[i * 3 + 2] = (unsigned char)(pixel >> 16);
+    }
+}
+
+/**
+ * AVX2 bilinear sampling of a row of single channel pixels from blocked
+ * storage.
+ *
+ */
+__attribute__((target("avx2")))
+static void bilinearBlockAvx2C1(const EqrBlocks &src, const float *x, const float *y, unsigned char *dst, int count) {
+    const unsigned char *data = src.buffer();
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i maxX = _mm256_set1_epi32(src.cols() - 1);
+    const __m256i maxY = _mm256_set1_epi32(src.rows() - 2);
+    const __m256i mask = _mm256_set1_epi32((1 << src.blockShift()) - 1);
+    const __m256i columns = _mm256_set1_epi32(src.blockColumns());
+    const __m256i blockStep = _mm256_set1_epi32((int)src.blockSize());
+    const __m256i stride = _mm256_set1_epi32((int)src.stride());
+    const __m128i shift = _mm_cvtsi32_si128(src.blockShift());
+    const __m256i unit = _mm256_set1_epi32(256);
+    const __m256i half = _mm256_set1_epi32(1 << 15);
+    const __m256i low = _mm256_set1_epi32(0xff);
+    const __m256 scale = _mm256_set1_ps(256.0f);
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 sx = _mm256_loadu_ps(x + i);
+        __m256 sy = _mm256_loadu_ps(y + i);
+        __m256 fx0 = _mm256_floor_ps(sx);
+        __m256 fy0 = _mm256_floor_ps(sy);
+        __m256i x0 = _mm256_cvttps_epi32(fx0);
+        __m256i y0 = _mm256_cvttps_epi32(fy0);
+
+        // pixels to wrap or near the poles go through the scalar path
+        __m256i outside = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpgt_epi32(zero, x0), _mm256_cmpgt_epi32(x0, maxX)),
+            _mm256_or_si256(_mm256_cmpgt_epi32(zero, y0), _mm256_cmpgt_epi32(y0, maxY))
+        );
+
+        if (!_mm256_testz_si256(outside, outside)) {
+            bilinearBlockScalar(src, x + i, y + i, dst + i, 8);
+            continue;
+        }
+
+        __m256i fx = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_sub_ps(sx, fx0), scale));
+        __m256i fy = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_sub_ps(sy, fy0), scale));
+        __m256i block = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srl_epi32(y0, shift), columns), _mm256_srl_epi32(x0, shift));
+        __m256i offset = _mm256_add_epi32(
+            _mm256_mullo_epi32(block, blockStep),
+            _mm256_add_epi32(_mm256_mullo_epi32(_mm256_and_si256(y0, mask), stride), _mm256_and_si256(x0, mask))
+        );
+
+        // fetch 2x2 neighbourhoods (4 bytes per row, 2 used)
+        __m256i row0 = _mm256_i32gather_epi32((const int *)data, offset, 1);
+        __m256i row1 = _mm256_i32gather_epi32((const int *)data, _mm256_add_epi32(offset, stride), 1);
+        __m256i p00 = _mm256_and_si256(row0, low);
+        __m256i p01 = _mm256_and_si256(_mm256_srli_epi32(row0, 8), low);
+        __m256i p10 = _mm256_and_si256(row1, low);
+        __m256i p11 = _mm256_and_si256(_mm256_srli_epi32(row1, 8), low);
+
+        __m256i top = _mm256_add_epi32(_mm256_mullo_epi32(p00, _mm256_sub_epi32(unit, fx)), _mm256_mullo_epi32(p01, fx));
+        __m256i bottom = _mm256_add_epi32(_mm256_mullo_epi32(p10, _mm256_sub_epi32(unit, fx)), _mm256_mullo_epi32(p11, fx));
+        __m256i value = _mm256_add_epi32(_mm256_mullo_epi32(top, _mm256_sub_epi32(unit, fy)), _mm256_mullo_epi32(bottom, fy));
+
+        value = _mm256_srli_epi32(_mm256_add_epi32(value, half), 16);
+
+        __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(value), _mm256_extracti128_si256(value, 1));
+
+        _mm_storel_epi64((__m128i *)(dst + i), _mm_packus_epi16(words, words));
+    }
+    bilinearBlockScalar(src, x + i, y + i, dst + i, count - i);
+}
+
+/**
+ * SSE4.1 bilinear sampling of a row of 3 channels pixels from blocked
+ * storage.
+ *
+ */
+__attribute__((target("sse4.1")))
+static void bilinearBlockSse41C3(const EqrBlocks &src, const float *x, const float *y, unsigned char *dst, int count) {
+    const __m128i unit = _mm_set1_epi32(256);
+    const __m128i half = _mm_set1_epi32(1 << 15);
+    const size_t stride = src.stride();
+
+    for (int i = 0; i < count; i++) {
+        float fx0 = floorf(x[i]);
+        float fy0 = floorf(y[i]);
+        int x0 = (int)fx0;
+        int y0 = (int)fy0;
+
+        // pixels to wrap or near the poles go through the scalar path
+        if (x0 < 0 || x0 >= src.cols() || y0 < 0 || y0 > src.rows() - 2) {
+            bilinearBlockPixel(src, x[i], y[i], dst + i * 3);
+            continue;
+        }
+
+        __m128i fx = _mm_set1_epi32((int)((x[i] - fx0) * 256.0f));
+        __m128i fy = _mm_set1_epi32((int)((y[i] - fy0) * 256.0f));
+        const unsigned char *p0 = src.pixel(x0, y0);
+
+        // fetch 2 pixels per row (8 bytes, 6 used)
+        __m128i row0 = _mm_loadl_epi64((const __m128i *)p0);
+        __m128i row1 = _mm_loadl_epi64((const __m128i *)(p0 + stride));
+        __m128i p00 = _mm_cvtepu8_epi32(row0);
+        __m128i p01 = _mm_cvtepu8_epi32(_mm_srli_si128(row0, 3));
+        __m128i p10 = _mm_cvtepu8_epi32(row1);
+        __m128i p11 = _mm_cvtepu8_epi32(_mm_srli_si128(row1, 3));
+
+        __m128i top = _mm_add_epi32(_mm_mullo_epi32(p00, _mm_sub_epi32(unit, fx)), _mm_mullo_epi32(p01, fx));
+        __m128i bottom = _mm_add_epi32(_mm_mullo_epi32(p10, _mm_sub_epi32(unit, fx)), _mm_mullo_epi32(p11, fx));
+        __m128i value = _mm_add_epi32(_mm_mullo_epi32(top, _mm_sub_epi32(unit, fy)), _mm_mullo_epi32(bottom, fy));
+
+        value = _mm_srli_epi32(_mm_add_epi32(value, half), 16);
+
+        __m128i words = _mm_packus_epi32(value, value);
+        int pixel = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+
+        dst[i * 3 + 0] = (unsigned char)(pixel);
+        dst[i * 3 + 1] = (unsigned char)(pixel >> 8);
+        dst[i * 3 + 2] = (unsigned char)(pixel >> 16);
+    }
+}
+
+#endif
+
+
+EqrBlocks::EqrBlocks(const cv::Mat &source, int shift) : width(source.cols), height(source.rows), pixelSize(source.channels()), shift(shift) {
+    const int size = 1 << shift;
+    int blockRows = (this->height + size - 1) >> shift;
+
+    this->columns = (this->width + size - 1) >> shift;
+    this->rowStep = (size + 1) * this->pixelSize;
+    this->blockStep = this->rowStep * (size + 1);
+    this->data.resize(this->blockStep * this->columns * blockRows + 8);
+
+    // copy blocks, borders included
+    ThreadPool::instance().parallelFor(0, blockRows, 1, [&] (int begin, int end) {
+        for (int by = begin; by < end; by++) {
+            for (int bx = 0; bx < this->columns; bx++) {
+                unsigned char *block = &this->data[0] + (by * this->columns + bx) * this->blockStep;
+                int x = bx * size;
+
+                for (int r = 0; r <= size; r++) {
+                    const unsigned char *row = source.ptr(MIN(by * size + r, this->height - 1));
+                    unsigned char *target = block + r * this->rowStep;
+                    int n = MIN(size + 1, this->width - x);
+
+                    memcpy(target, row + x * this->pixelSize, n * this->pixelSize);
+                    for (int c = n; c <= size; c++) {
+                        memcpy(target + c * this->pixelSize, row + ((x + c) % this->width) * this->pixelSize, this->pixelSize);
+                    }
+                }
+            }
+        }
+    });
+}
+
+bool EqrBlocks::supports(const cv::Mat &source) {
+    return source.depth() == CV_8U &&
+        (source.channels() == 1 || source.channels() == 3) &&
+        source.cols >= 4 && source.rows >= 2;
+}
+
+
+bool EqrSampler::supports(const cv::Mat &src, const cv::Mat &dst) {
+    return src.depth() == CV_8U && dst.depth() == CV_8U &&
+        src.channels() == dst.channels() &&
+        (src.channels() == 1 || src.channels() == 3) &&
+        src.cols >= 4 && src.rows >= 2;
+}
+
+void EqrSampler::bilinear(const cv::Mat &src, const float *x, const float *y, unsigned char *dst, int count) {
+#ifdef YAFDB_SAMPLER_X86
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    static const bool sse41 = __builtin_cpu_supports("sse4.1");
+
+    // gathers take 32-bit offsets
+    if (src.channels() == 1 && avx2 && (size_t)src.rows * src.step + src.step <= INT_MAX) {
+        bilinearAvx2C1(src.data, (size_t)src.step, src.cols, src.rows, x, y, dst, count);
+        return;
+    }
+    if (src.channels() == 3 && sse41) {
+        bilinearSse41C3(src.data, (size_t)src.step, src.cols, src.rows, x, y, dst, count);
+        return;
+    }
+#endif
+    bilinearScalar(src.data, (size_t)src.step, src.cols, src.rows, src.channels(), x, y, dst, count);
+}
+
+void EqrSampler::nearest(const cv::Mat &src, const float *x, const float *y, unsigned char *dst, int count) {
+    const int channels = src.channels();
+    const size_t step = (size_t)src.step;
+
+    for (int i = 0; i < count; i++) {
+        int sx = (int)floorf(x[i] + 0.5f) % src.cols;
+        int sy = (int)floorf(y[i] + 0.5f);
+
+        if (sx < 0) {
+            sx += src.cols;
+        }
+        sy = sy < 0 ? 0 : (sy >= src.rows ? src.rows - 1 : sy);
+
+        const unsigned char *p = src.data + sy * step + sx * channels;
+
+        for (int c = 0; c < channels; c++) {
+            dst[i * channels + c] = p[c];
+        }
+    }
+}
+
+void EqrSampler::bilinear(const EqrBlocks &src, const float *x, const float *y, unsigned char *dst, int count) {
+#ifdef YAFDB_SAMPLER_X86
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    static const bool sse41 = __builtin_cpu_supports("sse4.1");
+
+    // gathers take 32-bit offsets
+    if (src.channels() == 1 && avx2 && src.bufferSize() <= INT_MAX) {
+        bilinearBlockAvx2C1(src, x, y, dst, count);
+        return;
+    }
+    if (src.channels() == 3 && sse41) {
+        bilinearBlockSse41C3(src, x, y, dst, count);
+        return;
+    }
+#endif
+    bilinearBlockScalar(src, x, y, dst, count);
+}
+
+void EqrSampler::nearest(const EqrBlocks &src, const float *x, const float *y, unsigned char *dst, int count) {
+    const int channels = src.channels();
+
+    for (int i = 0; i < count; i++) {
+        int sx = (int)floorf(x[i] + 0.5f) % src.cols();
+        int sy = (int)floorf(y[i] + 0.5f);
+
+        if (sx < 0) {
+            sx += src.cols();
+        }
+        sy = sy < 0 ? 0 : (sy >= src.rows() ? src.rows() - 1 : sy);
+
+        const unsigned char *p = src.pixel(sx, sy);
+
+        for (int c = 0; c < channels; c++) {
+            dst[i * channels + c] = p[c];
+        }
+    }
+}
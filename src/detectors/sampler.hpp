@@ -0,0 +1,236 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#ifndef __YAFDB_DETECTORS_SAMPLER_H_INCLUDE__
+#define __YAFDB_DETECTORS_SAMPLER_H_INCLUDE__
+
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+
+/**
+ * Cache-blocked copy of an 8-bit eqr image.
+ *
+ * Pixels are stored in square blocks laid out one after the other, each
+ * block with an extra column and row copied from its right and bottom
+ * neighbours (wrapped around the seam, clamped at the south pole), so
+ * that any 2x2 neighbourhood is stored within a single block. Tiles
+ * sweeping diagonally across the eqr (near the poles) touch far fewer
+ * cache lines and pages than with row-major storage.
+ *
+ */
+class EqrBlocks {
+protected:
+    /** Image width in pixels */
+    int width;
+
+    /** Image height in pixels */
+    int height;
+
+    /** Bytes per pixel (number of channels) */
+    int pixelSize;
+
+    /** Block size (log2) */
+    int shift;
+
+    /** Number of blocks per row */
+    int columns;
+
+    /** Bytes per block row */
+    size_t rowStep;
+
+    /** Bytes per block */
+    size_t blockStep;
+
+    /** Blocks storage (padded for vector loads) */
+    std::vector<unsigned char> data;
+
+
+public:
+    /**
+     * Default constructor.
+     *
+     * \param source eqr image (8-bit, 1 or 3 channels)
+     * \param shift block size (log2)
+     */
+    EqrBlocks(const cv::Mat &source, int shift = 6);
+
+
+    /**
+     * Check if blocked storage supports given image.
+     *
+     * \param source eqr image
+     * \return true if supported, false otherwise
+     */
+    static bool supports(const cv::Mat &source);
+
+
+    /** Image width in pixels */
+    int cols() const {
+        return this->width;
+    }
+
+    /** Image height in pixels */
+    int rows() const {
+        return this->height;
+    }
+
+    /** Number of channels */
+    int channels() const {
+        return this->pixelSize;
+    }
+
+    /** Block size (log2) */
+    int blockShift() const {
+        return this->shift;
+    }
+
+    /** Number of blocks per row */
+    int blockColumns() const {
+        return this->columns;
+    }
+
+    /** Bytes between a pixel and the one below */
+    size_t stride() const {
+        return this->rowStep;
+    }
+
+    /** Bytes per block */
+    size_t blockSize() const {
+        return this->blockStep;
+    }
+
+    /** Blocks storage */
+    const unsigned char* buffer() const {
+        return &this->data[0];
+    }
+
+    /** Blocks storage size in bytes */
+    size_t bufferSize() const {
+        return this->data.size();
+    }
+
+    /**
+     * Get pixel address. Its right neighbour is at +channels() bytes and its
+     * bottom neighbour is at +stride() bytes.
+     *
+     * \param x pixel column (0 <= x < cols())
+     * \param y pixel row (0 <= y < rows())
+     * \return pixel address
+     */
+    const unsigned char* pixel(int x, int y) const {
+        const int mask = (1 << this->shift) - 1;
+
+        return &this->data[0] +
+            ((y >> this->shift) * this->columns + (x >> this->shift)) * this->blockStep +
+            (y & mask) * this->rowStep + (x & mask) * this->pixelSize;
+    }
+};
+
+
+/**
+ * Eqr image resampling kernels (8-bit, 1 or 3 channels).
+ *
+ * Source coordinates are given in pixels (pixel centers at integer
+ * positions). The x-axis wraps around the eqr seam and the y-axis is
+ * clamped to the poles. Kernels use 8-bit fixed-point weights and are
+ * vectorized when the processor supports it (AVX2 for 1 channel, SSE4.1
+ * for 3 channels), with identical results on all paths.
+ *
+ */
+class EqrSampler {
+public:
+    /**
+     * Check if kernels support given source and target images.
+     *
+     * \param src eqr source
+     * \param dst target image
+     * \return true if supported, false otherwise
+     */
+    static bool supports(const cv::Mat &src, const cv::Mat &dst);
+
+    /**
+     * Bilinear sampling of a row of pixels.
+     *
+     * \param src eqr source
+     * \param x source x coordinates
+     * \param y source y coordinates
+     * \param dst target pixels
+     * \param count number of pixels
+     */
+    static void bilinear(const cv::Mat &src, const float *x, const float *y, unsigned char *dst, int count);
+
+    /**
+     * Nearest neighbour sampling of a row of pixels.
+     *
+     * \param src eqr source
+     * \param x source x coordinates
+     * \param y source y coordinates
+     * \param dst target pixels
+     * \param count number of pixels
+     */
+    static void nearest(const cv::Mat &src, const float *x, const float *y, unsigned char *dst, int count);
+
+    /**
+     * Bilinear sampling of a row of pixels from blocked storage.
+     *
+     * \param src blocked eqr source
+     * \param x source x coordinates
+     * \param y source y coordinates
+     * \param dst target pixels
+     * \param count number of pixels
+     */
+    static void bilinear(const EqrBlocks &src, const float *x, const float *y, unsigned char *dst, int count);
+
+    /**
+     * Nearest neighbour sampling of a row of pixels from blocked storage.
+     *
+     * \param src blocked eqr source
+     * \param x source x coordinates
+     * \param y source y coordinates
+     * \param dst target pixels
+     * \param count number of pixels
+     */
+    static void nearest(const EqrBlocks &src, const float *x, const float *y, unsigned char *dst, int count);
+};
+
+
+#endif //__YAFDB_DETECTORS_SAMPLER_H_INCLUDE__
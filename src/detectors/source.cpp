@@ -0,0 +1,248 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include <tiffio.h>
+
+#include "source.hpp"
+
+
+TiffSource::TiffSource(size_t memoryLimit) : tiff(NULL), width(0), height(0), samples(0), photometric(0), tiled(false), tileWidth(0), chunkRows(0), grayscale(false), memoryLimit(memoryLimit), cacheSize(0) {
+}
+
+TiffSource::~TiffSource() {
+    if (this->tiff != NULL) {
+        TIFFClose(this->tiff);
+    }
+}
+
+bool TiffSource::isTiff(const std::string &file) {
+    unsigned char magic[4];
+    FILE *stream = fopen(file.c_str(), "rb");
+
+    if (stream == NULL) {
+        return false;
+    }
+
+    bool read = fread(magic, 1, sizeof(magic), stream) == sizeof(magic);
+
+    fclose(stream);
+
+    // byte order mark followed by version 42 (classic) or 43 (BigTIFF)
+    return read && (
+        (magic[0] == 'I' && magic[1] == 'I' && (magic[2] == 42 || magic[2] == 43) && magic[3] == 0) ||
+        (magic[0] == 'M' && magic[1] == 'M' && magic[2] == 0 && (magic[3] == 42 || magic[3] == 43))
+    );
+}
+
+bool TiffSource::open(const std::string &file) {
+    uint32_t imageWidth = 0, imageHeight = 0;
+    uint16_t bitsPerSample = 0, samplesPerPixel = 0, planarConfig = 0, photometric = PHOTOMETRIC_MINISBLACK;
+
+    // other formats are probed too, they must not reach libtiff
+    if (!TiffSource::isTiff(file)) {
+        return false;
+    }
+    this->tiff = TIFFOpen(file.c_str(), "r");
+    if (this->tiff == NULL) {
+        return false;
+    }
+    TIFFGetField(this->tiff, TIFFTAG_IMAGEWIDTH, &imageWidth);
+    TIFFGetField(this->tiff, TIFFTAG_IMAGELENGTH, &imageHeight);
+    TIFFGetFieldDefaulted(this->tiff, TIFFTAG_BITSPERSAMPLE, &bitsPerSample);
+    TIFFGetFieldDefaulted(this->tiff, TIFFTAG_SAMPLESPERPIXEL, &samplesPerPixel);
+    TIFFGetFieldDefaulted(this->tiff, TIFFTAG_PLANARCONFIG, &planarConfig);
+    TIFFGetField(this->tiff, TIFFTAG_PHOTOMETRIC, &photometric);
+
+    // only interleaved 8-bit gray / rgb(a) images are streamed
+    bool gray = samplesPerPixel == 1 && (photometric == PHOTOMETRIC_MINISBLACK || photometric == PHOTOMETRIC_MINISWHITE);
+    bool rgb = (samplesPerPixel == 3 || samplesPerPixel == 4) && photometric == PHOTOMETRIC_RGB;
+
+    if (imageWidth == 0 || imageHeight == 0 || bitsPerSample != 8 || planarConfig != PLANARCONFIG_CONTIG || (!gray && !rgb)) {
+        TIFFClose(this->tiff);
+        this->tiff = NULL;
+        return false;
+    }
+
+    this->width = imageWidth;
+    this->height = imageHeight;
+    this->samples = samplesPerPixel;
+    this->photometric = photometric;
+    this->tiled = TIFFIsTiled(this->tiff);
+    if (this->tiled) {
+        uint32_t tileWidth = 0, tileLength = 0;
+
+        TIFFGetField(this->tiff, TIFFTAG_TILEWIDTH, &tileWidth);
+        TIFFGetField(this->tiff, TIFFTAG_TILELENGTH, &tileLength);
+        this->tileWidth = tileWidth;
+        this->chunkRows = tileLength;
+    } else {
+        uint32_t rowsPerStrip = 0;
+
+        TIFFGetFieldDefaulted(this->tiff, TIFFTAG_ROWSPERSTRIP, &rowsPerStrip);
+        this->chunkRows = MIN(rowsPerStrip, imageHeight);
+    }
+    return this->chunkRows > 0 && (!this->tiled || this->tileWidth > 0);
+}
+
+void TiffSource::setGrayscale(bool grayscale) {
+    if (this->grayscale != grayscale) {
+        this->grayscale = grayscale;
+        this->cache.clear();
+        this->cacheSize = 0;
+        this->current.release();
+    }
+}
+
+cv::Mat TiffSource::band(int begin, int end) {
+    begin = MAX(begin, 0);
+    end = MIN(end, this->height);
+
+    // cache gets what the band leaves of the memory limit (at least one strip)
+    int channels = this->grayscale ? 1 : 3;
+    size_t bandSize = (size_t)(end - begin) * this->width * channels;
+    size_t limit = this->memoryLimit > bandSize ? this->memoryLimit - bandSize : 0;
+
+    this->current.release();
+    this->current.create(end - begin, this->width, CV_8UC(channels));
+    for (int index = begin / this->chunkRows; index * this->chunkRows < end; index++) {
+        cv::Mat pixels(this->chunk(index, limit));
+
+        if (pixels.empty()) {
+            this->current.release();
+            return cv::Mat();
+        }
+
+        int first = MAX(begin, index * this->chunkRows);
+        int last = MIN(end, index * this->chunkRows + pixels.rows);
+        cv::Mat target(this->current.rowRange(first - begin, last - begin));
+
+        pixels.rowRange(first - index * this->chunkRows, last - index * this->chunkRows).copyTo(target);
+    }
+    return this->current;
+}
+
+cv::Mat TiffSource::chunk(int index, size_t limit) {
+    for (auto it = this->cache.begin(); it != this->cache.end(); ++it) {
+        if ((*it).first == index) {
+            this->cache.splice(this->cache.begin(), this->cache, it);
+            return this->cache.front().second;
+        }
+    }
+
+    cv::Mat pixels;
+
+    if (!this->decode(index, pixels)) {
+        return cv::Mat();
+    }
+    this->cache.push_front(std::make_pair(index, pixels));
+    this->cacheSize += pixels.total() * pixels.elemSize();
+
+    // evict least recently used strips
+    while (this->cacheSize > limit && this->cache.size() > 1) {
+        const cv::Mat &last = this->cache.back().second;
+
+        this->cacheSize -= last.total() * last.elemSize();
+        this->cache.pop_back();
+    }
+    return pixels;
+}
+
+bool TiffSource::decode(int index, cv::Mat &pixels) {
+    int first = index * this->chunkRows;
+    int rows = MIN(this->chunkRows, this->height - first);
+    int type = this->grayscale ? CV_8UC1 : CV_8UC3;
+    bool direct = !this->tiled && this->samples == 1 && this->photometric == PHOTOMETRIC_MINISBLACK && this->grayscale;
+    cv::Mat raw;
+
+    // gray strips are decoded straight into the target
+    if (direct && (pixels.empty() || (pixels.rows == rows && pixels.cols == this->width && pixels.type() == type && pixels.isContinuous()))) {
+        pixels.create(rows, this->width, type);
+        return TIFFReadEncodedStrip(this->tiff, index, pixels.data, (tmsize_t)pixels.total()) >= 0;
+    }
+
+    raw.create(rows, this->width, CV_8UC(this->samples));
+    if (this->tiled) {
+        std::vector<unsigned char> tile(TIFFTileSize(this->tiff));
+        size_t tileStep = (size_t)this->tileWidth * this->samples;
+
+        for (int x = 0; x < this->width; x += this->tileWidth) {
+            if (TIFFReadEncodedTile(this->tiff, TIFFComputeTile(this->tiff, x, first, 0, 0), &tile[0], tile.size()) < 0) {
+                return false;
+            }
+
+            int columns = MIN(this->tileWidth, this->width - x);
+
+            for (int r = 0; r < rows; r++) {
+                memcpy(raw.ptr(r) + x * this->samples, &tile[r * tileStep], columns * this->samples);
+            }
+        }
+    } else if (TIFFReadEncodedStrip(this->tiff, index, raw.data, (tmsize_t)raw.total() * raw.elemSize()) < 0) {
+        return false;
+    }
+
+    // convert to bgr or grayscale
+    switch (this->samples) {
+    case 1:
+        if (this->photometric == PHOTOMETRIC_MINISWHITE) {
+            cv::bitwise_not(raw, raw);
+        }
+        if (!this->grayscale) {
+            cv::cvtColor(raw, pixels, cv::COLOR_GRAY2BGR);
+        } else if (pixels.empty()) {
+            pixels = raw;
+        } else {
+            raw.copyTo(pixels);
+        }
+        break;
+
+    case 3:
+        cv::cvtColor(raw, pixels, this->grayscale ? cv::COLOR_RGB2GRAY : cv::COLOR_RGB2BGR);
+        break;
+
+    case 4:
+        cv::cvtColor(raw, pixels, this->grayscale ? cv::COLOR_RGBA2GRAY : cv::COLOR_RGBA2BGR);
+        break;
+    }
+    return true;
+}
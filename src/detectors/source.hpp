@@ -0,0 +1,242 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#ifndef __YAFDB_DETECTORS_SOURCE_H_INCLUDE__
+#define __YAFDB_DETECTORS_SOURCE_H_INCLUDE__
+
+
+#include <list>
+#include <string>
+#include <utility>
+
+#include <opencv2/opencv.hpp>
+
+
+typedef struct tiff TIFF;
+
+
+/**
+ * Eqr image source providing full-width bands of rows on demand.
+ *
+ */
+class EqrSource {
+public:
+    /**
+     * Empty destructor.
+     */
+    virtual ~EqrSource() {
+    }
+
+
+    /**
+     * Get image width.
+     *
+     * \return width in pixels
+     */
+    virtual int cols() const = 0;
+
+    /**
+     * Get image height.
+     *
+     * \return height in pixels
+     */
+    virtual int rows() const = 0;
+
+    /**
+     * Get type of returned images.
+     *
+     * \return opencv image type
+     */
+    virtual int type() const = 0;
+
+    /**
+     * Get band of rows. The returned image is only valid until next call.
+     *
+     * \param begin first row
+     * \param end last row (excluded)
+     * \return image of rows
+     */
+    virtual cv::Mat band(int begin, int end) = 0;
+};
+
+
+/**
+ * Eqr source decoding tiff strips (or rows of tiles) on demand, keeping
+ * decoded strips in a least-recently-used cache of bounded size.
+ *
+ * Supports 8-bit images with 1, 3 or 4 interleaved samples; pixels are
+ * delivered in bgr order or converted to grayscale (like cv::imread).
+ *
+ */
+class TiffSource : public EqrSource {
+protected:
+    /** Tiff file handle */
+    TIFF *tiff;
+
+    /** Image width in pixels */
+    int width;
+
+    /** Image height in pixels */
+    int height;
+
+    /** Number of samples per pixel in file */
+    int samples;
+
+    /** Photometric interpretation in file */
+    int photometric;
+
+    /** Tiled file */
+    bool tiled;
+
+    /** Tile width (tiled files) */
+    int tileWidth;
+
+    /** Rows per strip (or tile height) */
+    int chunkRows;
+
+    /** Deliver grayscale pixels */
+    bool grayscale;
+
+    /** Memory limit in bytes for decoded pixels */
+    size_t memoryLimit;
+
+    /** Decoded strips (index, pixels), most recently used first */
+    std::list< std::pair<int, cv::Mat> > cache;
+
+    /** Decoded strips size in bytes */
+    size_t cacheSize;
+
+    /** Current band */
+    cv::Mat current;
+
+
+    /**
+     * Get decoded strip, from cache or file.
+     *
+     * \param index strip index
+     * \param limit cache size limit in bytes
+     * \return strip pixels (empty on error)
+     */
+    cv::Mat chunk(int index, size_t limit);
+
+
+public:
+    /**
+     * Default constructor.
+     *
+     * \param memoryLimit memory limit in bytes for decoded pixels (band and cache)
+     */
+    TiffSource(size_t memoryLimit);
+
+    /**
+     * Close file.
+     */
+    virtual ~TiffSource();
+
+
+    /**
+     * Check if file starts with a tiff (or BigTIFF) header, without
+     * letting libtiff report errors about other formats.
+     *
+     * \param file file path
+     * \return true if file is a tiff file, false otherwise
+     */
+    static bool isTiff(const std::string &file);
+
+    /**
+     * Open tiff file and read its header.
+     *
+     * \param file tiff file path
+     * \return true on success, false otherwise (unsupported format)
+     */
+    bool open(const std::string &file);
+
+    /**
+     * Select grayscale or bgr pixels (clears cache).
+     *
+     * \param grayscale true for grayscale pixels
+     */
+    void setGrayscale(bool grayscale);
+
+
+    virtual int cols() const {
+        return this->width;
+    }
+
+    virtual int rows() const {
+        return this->height;
+    }
+
+    virtual int type() const {
+        return this->grayscale ? CV_8UC1 : CV_8UC3;
+    }
+
+    virtual cv::Mat band(int begin, int end);
+
+
+    /**
+     * Get number of strips (or rows of tiles).
+     *
+     * \return number of strips
+     */
+    int chunkCount() const {
+        return (this->height + this->chunkRows - 1) / this->chunkRows;
+    }
+
+    /**
+     * Get number of rows per strip (except last one).
+     *
+     * \return number of rows
+     */
+    int chunkHeight() const {
+        return this->chunkRows;
+    }
+
+    /**
+     * Decode strip from file, bypassing the cache.
+     *
+     * \param index strip index
+     * \param pixels output strip pixels (written in place if already of correct size and type)
+     * \return true on success, false otherwise
+     */
+    bool decode(int index, cv::Mat &pixels);
+};
+
+
+#endif //__YAFDB_DETECTORS_SOURCE_H_INCLUDE__
@@ -0,0 +1,216 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+
+#include <math.h>
+
+#include <vector>
+
+#include "parallel.hpp"
+#include "spherical.hpp"
+
+
+SphericalFootprint::SphericalFootprint(const BoundingBox &area, int width, int height, double growth, int halo, double magnify) : phi(0), width(width), height(height), available(false) {
+    if (area.system != BoundingBox::SPHERICAL || width <= 0 || height <= 0) {
+        return;
+    }
+
+    // box border: corners and points along its edges, as parallels curve
+    // and meridians converge near the poles (pole-crossing boxes are left
+    // to the rectangle path)
+    const int samples = 32;
+    double span = area.p2.x - area.p1.x;
+    std::vector<cv::Point2d> border;
+
+    if (area.p1.y > area.p2.y) {
+        return;
+    }
+    if (span < 0) {
+        span += 2.0 * M_PI;
+    }
+    for (int i = 0; i <= samples; i++) {
+        double x = area.p1.x + span * i / samples;
+        double y = area.p1.y + (area.p2.y - area.p1.y) * i / samples;
+
+        border.push_back(cv::Point2d(x, area.p1.y));
+        border.push_back(cv::Point2d(x, area.p2.y));
+        border.push_back(cv::Point2d(area.p1.x, y));
+        border.push_back(cv::Point2d(area.p2.x, y));
+    }
+
+    // patch is centered on the border
+    double c[3] = { 0, 0, 0 };
+
+    for (auto point = border.begin(); point != border.end(); ++point) {
+        c[0] += cos(point->x) * cos(point->y);
+        c[1] += sin(point->x) * cos(point->y);
+        c[2] += sin(point->y);
+    }
+
+    double norm = sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+
+    if (norm < 1e-6) {
+        return;
+    }
+    c[0] /= norm;
+    c[1] /= norm;
+    c[2] /= norm;
+
+    // patch covers the grown border and halo at eqr resolution, and stays
+    // far from the gnomonic horizon
+    double radius = 0;
+
+    for (auto point = border.begin(); point != border.end(); ++point) {
+        double dot = c[0] * cos(point->x) * cos(point->y) + c[1] * sin(point->x) * cos(point->y) + c[2] * sin(point->y);
+
+        radius = MAX(radius, acos(MIN(MAX(dot, -1.0), 1.0)));
+    }
+
+    double pixel = 2.0 * M_PI / width;
+    double extent = tan(radius) * growth + (halo + 2) * pixel;
+
+    if (radius >= M_PI / 3 || extent > tan(M_PI / 3) || extent / pixel > width / 2) {
+        return;
+    }
+
+    int size = 2 * (int)ceil(extent / pixel) + 1;
+    double aperture = 2.0 * atan(extent);
+    double theta = asin(c[2]);
+    int x1 = size, y1 = size, x2 = -1, y2 = -1;
+
+    this->phi = atan2(c[1], c[0]);
+    if (this->phi < 0) {
+        this->phi += 2.0 * M_PI;
+    }
+    this->patch = cv::Size(size, size);
+    this->transform.setup(size, size, aperture, aperture, this->phi, theta);
+
+    // blurred rectangle bounds the projected border (whose inside projects
+    // inside it, coordinates are truncated), any point behind the plane
+    // falls back to the rectangle path
+    for (auto point = border.begin(); point != border.end(); ++point) {
+        int x, y;
+
+        if (!this->transform.toGnomonic(point->x, point->y, x, y)) {
+            return;
+        }
+        x1 = MIN(x1, x);
+        y1 = MIN(y1, y);
+        x2 = MAX(x2, x);
+        y2 = MAX(y2, y);
+    }
+    this->rect = cv::Rect(x1, y1, x2 - x1 + 2, y2 - y1 + 2);
+
+    // written box, magnified around the box center
+    double middle = (area.p1.y + area.p2.y) / 2;
+
+    this->phiSpan = MIN(span * magnify, 2.0 * M_PI);
+    this->phi1 = fmod(area.p1.x + (span - this->phiSpan) / 2 + 4.0 * M_PI, 2.0 * M_PI);
+    this->theta1 = MAX(middle - (area.p2.y - area.p1.y) / 2 * magnify, -M_PI / 2);
+    this->theta2 = MIN(middle + (area.p2.y - area.p1.y) / 2 * magnify, M_PI / 2);
+    this->available = true;
+}
+
+void SphericalFootprint::project(const cv::Mat &eqr, cv::Mat &patch) const {
+    patch.create(this->patch.height, this->patch.width, eqr.type());
+    this->transform.toGnomonic(eqr, patch);
+}
+
+void SphericalFootprint::writeBack(const cv::Mat &patch, const cv::Rect &area, cv::Mat &eqr, cv::Rect &rows) const {
+    cv::Rect output(area & cv::Rect(0, 0, patch.cols, patch.rows));
+
+    rows = cv::Rect(0, 0, 0, 0);
+    if (!this->available || output.width <= 0 || output.height <= 0) {
+        return;
+    }
+
+    // eqr pixels of the written box (pixel centers at half coordinates)
+    int row0 = MAX((int)floor((this->theta1 + M_PI / 2) / M_PI * this->height), 0);
+    int row1 = MIN((int)ceil((this->theta2 + M_PI / 2) / M_PI * this->height), this->height);
+    int column0 = (int)floor(this->phi1 / (2.0 * M_PI) * this->width);
+    int count = MIN((int)ceil(this->phiSpan / (2.0 * M_PI) * this->width) + 1, this->width);
+
+    // pixels whose center lies in the box and projects inside area get the
+    // patch pixels (bilinear), others are left untouched
+    int channels = eqr.channels();
+    float left = output.x, right = output.x + output.width - 1;
+    float top = output.y, bottom = output.y + output.height - 1;
+
+    ThreadPool::instance().parallelFor(row0, row1, 16, [&] (int begin, int end) {
+        std::vector<float> x(count);
+        std::vector<float> y(count);
+
+        for (int row = begin; row < end; row++) {
+            unsigned char *line = eqr.ptr<unsigned char>(row);
+            double theta = (row + 0.5) / this->height * M_PI - M_PI / 2;
+
+            if (theta < this->theta1 || theta > this->theta2) {
+                continue;
+            }
+            this->transform.gnomonicCoordinates(row, column0, count, this->width, this->height, &x[0], &y[0]);
+            for (int i = 0; i < count; i++) {
+                double phi = fmod((column0 + i + 0.5) / this->width * 2.0 * M_PI - this->phi1 + 4.0 * M_PI, 2.0 * M_PI);
+
+                if (phi > this->phiSpan || x[i] < left || x[i] > right || y[i] < top || y[i] > bottom) {
+                    continue;
+                }
+
+                int ix = (int)x[i];
+                int iy = (int)y[i];
+                int ix1 = MIN(ix + 1, patch.cols - 1);
+                int iy1 = MIN(iy + 1, patch.rows - 1);
+                float fx = x[i] - ix;
+                float fy = y[i] - iy;
+                const unsigned char *a = patch.ptr<unsigned char>(iy) + ix * channels;
+                const unsigned char *b = patch.ptr<unsigned char>(iy) + ix1 * channels;
+                const unsigned char *c = patch.ptr<unsigned char>(iy1) + ix * channels;
+                const unsigned char *d = patch.ptr<unsigned char>(iy1) + ix1 * channels;
+                unsigned char *dst = line + (((column0 + i) % this->width + this->width) % this->width) * channels;
+
+                for (int k = 0; k < channels; k++) {
+                    float t = a[k] + fx * (b[k] - a[k]);
+                    float u = c[k] + fx * (d[k] - c[k]);
+
+                    dst[k] = (unsigned char)(t + fy * (u - t) + 0.5f);
+                }
+            }
+        }
+    });
+    rows = cv::Rect(0, row0, this->width, row1 - row0);
+}
@@ -0,0 +1,159 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+
+#ifndef __YAFDB_DETECTORS_SPHERICAL_H_INCLUDE__
+#define __YAFDB_DETECTORS_SPHERICAL_H_INCLUDE__
+
+
+#include <opencv2/opencv.hpp>
+
+#include "detector.hpp"
+
+
+/**
+ * Footprint of a spherical bounding box in a gnomonic patch centered on
+ * the object, at about the eqr resolution. The object rectangle bounds
+ * the gnomonic projection of the box border (corners and edges), so
+ * that objects near the poles or across the seam cover a compact area
+ * instead of wide eqr strips. The patch is blurred in place, then only
+ * the eqr pixels inside the spherical box (and the blurred area) are
+ * written back.
+ *
+ */
+class SphericalFootprint {
+protected:
+    /** Eqr to patch transformation */
+    GnomonicTransform transform;
+
+    /** Patch size */
+    cv::Size patch;
+
+    /** Patch center azimuthal angle (in radian) */
+    double phi;
+
+    /** Object rectangle in patch */
+    cv::Rect rect;
+
+    /** Written box first azimuthal angle (in radian) */
+    double phi1;
+
+    /** Written box azimuthal span (in radian) */
+    double phiSpan;
+
+    /** Written box first polar angle (in radian) */
+    double theta1;
+
+    /** Written box last polar angle (in radian) */
+    double theta2;
+
+    /** Eqr width in pixels */
+    int width;
+
+    /** Eqr height in pixels */
+    int height;
+
+    /** Footprint available */
+    bool available;
+
+
+public:
+    /**
+     * Default constructor.
+     *
+     * \param area spherical bounding box
+     * \param width eqr width in pixels
+     * \param height eqr height in pixels
+     * \param growth patch size relative to the object rectangle (1 = rectangle only)
+     * \param halo pixels around the grown rectangle
+     * \param magnify written box size relative to the spherical box (around its center)
+     */
+    SphericalFootprint(const BoundingBox &area, int width, int height, double growth, int halo, double magnify = 1.0);
+
+
+    /**
+     * Check if footprint is available (spherical box of moderate size).
+     *
+     * \return true if available, false otherwise
+     */
+    bool isAvailable() const {
+        return this->available;
+    }
+
+    /**
+     * Get patch size.
+     *
+     * \return patch size
+     */
+    cv::Size size() const {
+        return this->patch;
+    }
+
+    /**
+     * Get object rectangle in patch.
+     *
+     * \return object rectangle
+     */
+    const cv::Rect &getRect() const {
+        return this->rect;
+    }
+
+
+    /**
+     * Project eqr image to patch.
+     *
+     * \param eqr eqr image
+     * \param patch output patch (allocated to size())
+     */
+    void project(const cv::Mat &eqr, cv::Mat &patch) const;
+
+    /**
+     * Write patch area back to the eqr pixels whose center lies in the
+     * (magnified) spherical box and projects in the area.
+     *
+     * \param patch blurred patch
+     * \param area written patch area
+     * \param eqr eqr image to update
+     * \param rows output range of eqr rows written (as a full width rectangle)
+     */
+    void writeBack(const cv::Mat &patch, const cv::Rect &area, cv::Mat &eqr, cv::Rect &rows) const;
+};
+
+
+#endif //__YAFDB_DETECTORS_SPHERICAL_H_INCLUDE__
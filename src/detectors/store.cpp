@@ -0,0 +1,590 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "binary.hpp"
+#include "grid.hpp"
+#include "store.hpp"
+
+
+/**
+ * Drop container content and memory (arena memory is reclaimed on reset).
+ *
+ * \param container container to release
+ */
+template <typename T> static void release(T &container) {
+    T(container.get_allocator()).swap(container);
+}
+
+
+size_t DetectionStore::SymbolHash::operator()(const char *value) const {
+    size_t hash = 2166136261u;
+
+    for (; *value; value++) {
+        hash = (hash ^ (unsigned char)*value) * 16777619u;
+    }
+    return hash;
+}
+
+
+DetectionStore::DetectionStore() :
+    systems(&this->arena), p1s(&this->arena), p2s(&this->arena),
+    classNames(&this->arena), falsePositives(&this->arena), autoStatuses(&this->arena), manualStatuses(&this->arena),
+    childBegins(&this->arena), childCounts(&this->arena), roots(&this->arena), invalids(&this->arena),
+    symbols(&this->arena), symbolIds(0, SymbolHash(), SymbolEqual(), &this->arena) {
+    this->clear();
+}
+
+DetectionStore::DetectionStore(const std::list<DetectedObject> &objects) : DetectionStore() {
+    this->assign(objects);
+}
+
+void DetectionStore::clear() {
+    static const char *common[] = { "", "No", "Yes", "None", "valid", "invalid" };
+
+    // containers forget their arena memory before it is reset
+    release(this->systems);
+    release(this->p1s);
+    release(this->p2s);
+    release(this->classNames);
+    release(this->falsePositives);
+    release(this->autoStatuses);
+    release(this->manualStatuses);
+    release(this->childBegins);
+    release(this->childCounts);
+    release(this->roots);
+    release(this->invalids);
+    release(this->symbols);
+    release(this->symbolIds);
+    this->arena.reset();
+    this->source.clear();
+    for (unsigned int i = 0; i < sizeof(common) / sizeof(common[0]); i++) {
+        this->intern(common[i]);
+    }
+}
+
+void DetectionStore::reserve(unsigned int count) {
+    this->systems.reserve(count);
+    this->p1s.reserve(count);
+    this->p2s.reserve(count);
+    this->classNames.reserve(count);
+    this->falsePositives.reserve(count);
+    this->autoStatuses.reserve(count);
+    this->manualStatuses.reserve(count);
+    this->childBegins.reserve(count);
+    this->childCounts.reserve(count);
+    this->roots.reserve(count);
+    this->invalids.reserve(count);
+}
+
+unsigned int DetectionStore::allocate(unsigned int count) {
+    unsigned int first = this->systems.size();
+    unsigned int size = first + count;
+
+    this->systems.resize(size, BoundingBox::CARTESIAN);
+    this->p1s.resize(size);
+    this->p2s.resize(size);
+    this->classNames.resize(size, SYMBOL_EMPTY);
+    this->falsePositives.resize(size, SYMBOL_EMPTY);
+    this->autoStatuses.resize(size, SYMBOL_EMPTY);
+    this->manualStatuses.resize(size, SYMBOL_EMPTY);
+    this->childBegins.resize(size, size);
+    this->childCounts.resize(size, 0);
+    return first;
+}
+
+DetectionStore::Symbol DetectionStore::intern(const std::string &value) {
+    auto it = this->symbolIds.find(value.c_str());
+
+    if (it != this->symbolIds.end()) {
+        return it->second;
+    }
+
+    Symbol symbol = this->symbols.size();
+    char *copy = (char*)this->arena.allocate(value.size() + 1, 1);
+
+    memcpy(copy, value.c_str(), value.size() + 1);
+    this->symbols.push_back(copy);
+    this->symbolIds[copy] = symbol;
+    return symbol;
+}
+
+void DetectionStore::setArea(unsigned int entry, const BoundingBox &area) {
+    this->systems[entry] = area.system;
+    this->p1s[entry] = area.p1;
+    this->p2s[entry] = area.p2;
+}
+
+void DetectionStore::setStatus(unsigned int entry, Symbol falsePositive, Symbol autoStatus, Symbol manualStatus) {
+    this->falsePositives[entry] = falsePositive;
+    this->autoStatuses[entry] = autoStatus;
+    this->manualStatuses[entry] = manualStatus;
+}
+
+void DetectionStore::set(unsigned int entry, const DetectedObject &object) {
+    this->setArea(entry, object.area);
+    this->classNames[entry] = this->intern(object.className);
+    this->setStatus(entry, this->intern(object.falsePositive), this->intern(object.autoStatus), this->intern(object.manualStatus));
+    if (object.children.empty()) {
+        return;
+    }
+
+    // children are allocated as one block so that they form a range
+    unsigned int child = this->allocate(object.children.size());
+
+    this->childBegins[entry] = child;
+    this->childCounts[entry] = object.children.size();
+    for (auto it = object.children.begin(); it != object.children.end(); ++it) {
+        this->set(child++, *it);
+    }
+}
+
+void DetectionStore::set(unsigned int entry, const cv::FileNode &node) {
+    this->setArea(entry, BoundingBox(node["area"]));
+    this->classNames[entry] = this->intern(node["className"]);
+    this->setStatus(entry, this->intern(node["falsePositive"]), this->intern(node["autoStatus"]), this->intern(node["manualStatus"]));
+
+    auto childrenNode = node["children"];
+
+    if (childrenNode.size() == 0) {
+        return;
+    }
+
+    unsigned int child = this->allocate(childrenNode.size());
+
+    this->childBegins[entry] = child;
+    this->childCounts[entry] = childrenNode.size();
+    for (auto it = childrenNode.begin(); it != childrenNode.end(); ++it) {
+        this->set(child++, *it);
+    }
+}
+
+unsigned int DetectionStore::add(const DetectedObject &object, bool invalid) {
+    unsigned int entry = this->allocate(1);
+
+    this->roots.push_back(entry);
+    this->invalids.push_back(invalid);
+    this->set(entry, object);
+    return entry;
+}
+
+void DetectionStore::assign(const std::list<DetectedObject> &objects) {
+    this->clear();
+    for (auto it = objects.begin(); it != objects.end(); ++it) {
+        this->add(*it);
+    }
+}
+
+void DetectionStore::filter(const std::function<bool(unsigned int)> &keep) {
+    unsigned int count = 0;
+
+    for (unsigned int i = 0; i < this->roots.size(); i++) {
+        if (keep(this->roots[i])) {
+            this->roots[count] = this->roots[i];
+            this->invalids[count] = this->invalids[i];
+            count++;
+        }
+    }
+    this->roots.resize(count);
+    this->invalids.resize(count);
+}
+
+void DetectionStore::merge(int minOverlap) {
+    std::vector<unsigned int> entries(this->roots.begin(), this->roots.end());
+    unsigned int first, count;
+
+    this->mergeEntries(entries, minOverlap, first, count);
+    this->roots.resize(count);
+    this->invalids.assign(count, 0);
+    for (unsigned int i = 0; i < count; i++) {
+        this->roots[i] = first + i;
+    }
+}
+
+void DetectionStore::mergeEntries(const std::vector<unsigned int> &entries, int minOverlap, unsigned int &first, unsigned int &count) {
+    std::vector<BoundingBox> boxes;
+    std::vector<unsigned int> candidates;
+    std::vector<bool> used(entries.size(), false);
+    std::vector<std::vector<unsigned int> > groups;
+    std::vector<BoundingBox> areas;
+
+    boxes.reserve(entries.size());
+    for (unsigned int i = 0; i < entries.size(); i++) {
+        boxes.push_back(this->area(entries[i]));
+    }
+
+    BoxGrid grid(boxes);
+
+    // group entries exactly as ObjectDetector::merge groups objects
+    for (unsigned int i = 0; i < entries.size(); i++) {
+        if (used[i]) {
+            continue;
+        }
+        used[i] = true;
+        grid.remove(i);
+
+        std::vector<unsigned int> members(1, entries[i]);
+        BoundingBox area(boxes[i]);
+        unsigned int total = 1 + this->descendants(entries[i]);
+
+        for (bool merged = true; merged; ) {
+            merged = false;
+            grid.query(area, candidates);
+            for (auto it = candidates.begin(); it != candidates.end(); ++it) {
+                unsigned int j = *it;
+
+                if (used[j]) {
+                    continue;
+                }
+                if (area.mergeIfOverlap(boxes[j])) {
+                    members.push_back(entries[j]);
+                    total += 1 + this->descendants(entries[j]);
+                    used[j] = true;
+                    grid.remove(j);
+                    merged = true;
+                    break;
+                }
+            }
+        }
+        if ((int)total >= minOverlap) {
+            groups.push_back(std::move(members));
+            areas.push_back(area);
+        }
+    }
+
+    // merged entries form a range, their children are merged after them
+    first = this->allocate(groups.size());
+    count = groups.size();
+    for (unsigned int g = 0; g < groups.size(); g++) {
+        unsigned int entry = first + g;
+        std::vector<Symbol> classNames, falsePositives, autoStatuses, manualStatuses;
+        std::vector<unsigned int> children;
+
+        for (auto member = groups[g].begin(); member != groups[g].end(); ++member) {
+            classNames.push_back(this->classNames[*member]);
+            falsePositives.push_back(this->falsePositives[*member]);
+            autoStatuses.push_back(this->autoStatuses[*member]);
+            manualStatuses.push_back(this->manualStatuses[*member]);
+            for (unsigned int child = this->childBegin(*member); child < this->childEnd(*member); child++) {
+                children.push_back(child);
+            }
+        }
+        this->setArea(entry, areas[g]);
+        this->classNames[entry] = this->join(classNames);
+        this->setStatus(entry, this->join(falsePositives), this->join(autoStatuses), this->join(manualStatuses));
+        if (!children.empty()) {
+            unsigned int childFirst, childCount;
+
+            this->mergeEntries(children, 1, childFirst, childCount);
+            this->childBegins[entry] = childFirst;
+            this->childCounts[entry] = childCount;
+        }
+    }
+}
+
+unsigned int DetectionStore::descendants(unsigned int entry) const {
+    unsigned int count = this->childCounts[entry];
+
+    for (unsigned int child = this->childBegin(entry); child < this->childEnd(entry); child++) {
+        count += this->descendants(child);
+    }
+    return count;
+}
+
+DetectionStore::Symbol DetectionStore::join(std::vector<Symbol> &symbols) {
+    std::sort(symbols.begin(), symbols.end());
+    symbols.erase(std::unique(symbols.begin(), symbols.end()), symbols.end());
+    if (symbols.size() == 1) {
+        return symbols[0];
+    }
+
+    std::vector<std::string> values;
+    std::string value;
+
+    for (auto it = symbols.begin(); it != symbols.end(); ++it) {
+        values.push_back(this->symbol(*it));
+    }
+    std::sort(values.begin(), values.end());
+    for (auto it = values.begin(); it != values.end(); ++it) {
+        if (!value.empty()) {
+            value.append(":");
+        }
+        value.append(*it);
+    }
+    return this->intern(value);
+}
+
+DetectedObject DetectionStore::object(unsigned int entry) const {
+    DetectedObject object(
+        this->symbol(this->classNames[entry]),
+        this->area(entry),
+        this->symbol(this->falsePositives[entry]),
+        this->symbol(this->autoStatuses[entry]),
+        this->symbol(this->manualStatuses[entry])
+    );
+
+    for (unsigned int child = this->childBegin(entry); child < this->childEnd(entry); child++) {
+        object.addChild(this->object(child));
+    }
+    return object;
+}
+
+void DetectionStore::toList(std::list<DetectedObject> &objects) const {
+    for (auto it = this->roots.begin(); it != this->roots.end(); ++it) {
+        objects.push_back(this->object(*it));
+    }
+}
+
+bool DetectionStore::load(const std::string &file) {
+    if (DetectionFile::isBinary(file)) {
+        return this->loadBinary(file);
+    }
+
+    cv::FileStorage fs(file, cv::FileStorage::READ);
+
+    if (!fs.isOpened()) {
+        return false;
+    }
+
+    const char *keys[] = { "objects", "invalidObjects" };
+
+    for (int i = 0; i < 2; i++) {
+        auto objectsNode = fs[keys[i]];
+
+        this->reserve(this->entries() + objectsNode.size());
+        for (auto it = objectsNode.begin(); it != objectsNode.end(); ++it) {
+            unsigned int entry = this->allocate(1);
+
+            this->roots.push_back(entry);
+            this->invalids.push_back(i == 1);
+            this->set(entry, *it);
+        }
+    }
+    if (!fs["source"].empty()) {
+        this->source = (std::string)fs["source"];
+    }
+    return true;
+}
+
+bool DetectionStore::loadBinary(const std::string &file) {
+    DetectionFile binary;
+
+    if (!binary.open(file)) {
+        return false;
+    }
+
+    // map file symbols to store symbols
+    std::vector<Symbol> mapping(binary.symbols());
+
+    for (unsigned int i = 0; i < binary.symbols(); i++) {
+        mapping[i] = this->intern(binary.symbol(i));
+    }
+
+    unsigned int base = this->allocate(binary.entries());
+
+    for (unsigned int i = 0; i < binary.entries(); i++) {
+        const DetectionRecord &record = binary.record(i);
+        unsigned int entry = base + i;
+
+        this->systems[entry] = record.system;
+        this->p1s[entry] = cv::Point2d(record.box[0], record.box[1]);
+        this->p2s[entry] = cv::Point2d(record.box[2], record.box[3]);
+        this->classNames[entry] = mapping[record.className];
+        this->falsePositives[entry] = mapping[record.falsePositive];
+        this->autoStatuses[entry] = mapping[record.autoStatus];
+        this->manualStatuses[entry] = mapping[record.manualStatus];
+        this->childBegins[entry] = base + record.childBegin;
+        this->childCounts[entry] = record.childCount;
+    }
+    for (unsigned int i = 0; i < binary.size(); i++) {
+        unsigned int entry = binary.root(i);
+
+        this->roots.push_back(base + entry);
+        this->invalids.push_back((binary.record(entry).flags & DetectionFile::FLAG_INVALID) != 0);
+    }
+    if (binary.source()[0] != 0) {
+        this->source = binary.source();
+    }
+    return true;
+}
+
+bool DetectionStore::save(const std::string &file) const {
+    if (DetectionFile::isBinaryName(file)) {
+        return this->saveBinary(file);
+    }
+
+    cv::FileStorage fs(file, cv::FileStorage::WRITE);
+
+    if (!fs.isOpened()) {
+        return false;
+    }
+    if (!this->source.empty()) {
+        fs << "source" << this->source;
+    }
+    fs << "objects";
+    this->write(fs, false);
+    if (std::find(this->invalids.begin(), this->invalids.end(), 1) != this->invalids.end()) {
+        fs << "invalidObjects";
+        this->write(fs, true);
+    }
+    return true;
+}
+
+bool DetectionStore::saveBinary(const std::string &file) const {
+    FILE *fp = fopen(file.c_str(), "wb");
+
+    if (!fp) {
+        return false;
+    }
+
+    // string table (source filename appended as last symbol if needed)
+    std::vector<uint32_t> offsets;
+    std::string strings;
+
+    for (unsigned int i = 0; i < this->symbols.size(); i++) {
+        offsets.push_back(strings.size());
+        strings.append(this->symbols[i], strlen(this->symbols[i]) + 1);
+    }
+
+    uint32_t source = SYMBOL_EMPTY;
+
+    if (!this->source.empty()) {
+        source = offsets.size();
+        offsets.push_back(strings.size());
+        strings.append(this->source.c_str(), this->source.size() + 1);
+    }
+
+    DetectionFileHeader header;
+    uint32_t entries = this->entries();
+    uint32_t roots = this->roots.size();
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "YFDB", 4);
+    header.version = DetectionFile::VERSION;
+    header.byteOrder = 0x01020304;
+    header.entryCount = entries;
+    header.rootCount = roots;
+    header.symbolCount = offsets.size();
+    header.stringSize = strings.size();
+    header.source = source;
+    header.entryOffset = sizeof(header);
+    header.rootOffset = header.entryOffset + (uint64_t)entries * sizeof(DetectionRecord);
+    header.symbolOffset = header.rootOffset + (uint64_t)roots * sizeof(uint32_t);
+    header.stringOffset = header.symbolOffset + (uint64_t)offsets.size() * sizeof(uint32_t);
+
+    std::vector<uint32_t> flags(entries, 0);
+
+    for (uint32_t i = 0; i < roots; i++) {
+        if (this->invalids[i]) {
+            flags[this->roots[i]] |= DetectionFile::FLAG_INVALID;
+        }
+    }
+
+    bool success = fwrite(&header, sizeof(header), 1, fp) == 1;
+
+    for (uint32_t i = 0; success && i < entries; i++) {
+        DetectionRecord record;
+
+        memset(&record, 0, sizeof(record));
+        record.box[0] = this->p1s[i].x;
+        record.box[1] = this->p1s[i].y;
+        record.box[2] = this->p2s[i].x;
+        record.box[3] = this->p2s[i].y;
+        record.system = this->systems[i];
+        record.className = this->classNames[i];
+        record.falsePositive = this->falsePositives[i];
+        record.autoStatus = this->autoStatuses[i];
+        record.manualStatus = this->manualStatuses[i];
+        record.childBegin = this->childCounts[i] > 0 ? this->childBegins[i] : 0;
+        record.childCount = this->childCounts[i];
+        record.flags = flags[i];
+        success = fwrite(&record, sizeof(record), 1, fp) == 1;
+    }
+    success = success && (roots == 0 || fwrite(&this->roots[0], sizeof(uint32_t), roots, fp) == roots);
+    success = success && fwrite(&offsets[0], sizeof(uint32_t), offsets.size(), fp) == offsets.size();
+    success = success && fwrite(strings.data(), 1, strings.size(), fp) == strings.size();
+    if (fclose(fp) != 0) {
+        success = false;
+    }
+    return success;
+}
+
+void DetectionStore::write(cv::FileStorage &fs) const {
+    fs << "[";
+        for (auto it = this->roots.begin(); it != this->roots.end(); ++it) {
+            this->writeEntry(fs, *it);
+        }
+    fs << "]";
+}
+
+void DetectionStore::write(cv::FileStorage &fs, bool invalid) const {
+    fs << "[";
+        for (unsigned int i = 0; i < this->roots.size(); i++) {
+            if ((this->invalids[i] != 0) == invalid) {
+                this->writeEntry(fs, this->roots[i]);
+            }
+        }
+    fs << "]";
+}
+
+void DetectionStore::writeEntry(cv::FileStorage &fs, unsigned int entry) const {
+    Symbol falsePositive = this->falsePositives[entry];
+    Symbol autoStatus = this->autoStatuses[entry];
+    Symbol manualStatus = this->manualStatuses[entry];
+
+    fs << "{";
+        fs << "className" << this->symbol(this->classNames[entry]);
+        fs << "area";
+        this->area(entry).write(fs);
+        fs << "falsePositive" << this->symbol(falsePositive != SYMBOL_EMPTY ? falsePositive : SYMBOL_NO);
+        fs << "autoStatus"    << this->symbol(autoStatus != SYMBOL_EMPTY ? autoStatus : SYMBOL_NONE);
+        fs << "manualStatus"  << this->symbol(manualStatus != SYMBOL_EMPTY ? manualStatus : SYMBOL_NONE);
+        if (this->childCounts[entry] > 0) {
+            fs << "children" << "[";
+                for (unsigned int child = this->childBegin(entry); child < this->childEnd(entry); child++) {
+                    this->writeEntry(fs, child);
+                }
+            fs << "]";
+        }
+    fs << "}";
+}
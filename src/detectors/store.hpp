@@ -0,0 +1,517 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#ifndef __YAFDB_DETECTORS_STORE_H_INCLUDE__
+#define __YAFDB_DETECTORS_STORE_H_INCLUDE__
+
+
+#include <string.h>
+
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "arena.hpp"
+#include "detector.hpp"
+
+
+/**
+ * Contiguous storage of detected objects. Fields are kept in flat arrays
+ * indexed by entry, strings (class names and statuses) are interned once
+ * as symbols and children of an entry occupy a contiguous range of
+ * entries.
+ *
+ * Arrays and interned strings are allocated from an arena owned by the
+ * store, so the objects of one image are held in a few large blocks.
+ * clear() drops them all at once and keeps the blocks for the next image.
+ *
+ */
+class DetectionStore {
+public:
+    /** Interned string identifier */
+    typedef unsigned int Symbol;
+
+    /** Symbols of common values, always interned */
+    enum { SYMBOL_EMPTY = 0, SYMBOL_NO, SYMBOL_YES, SYMBOL_NONE, SYMBOL_VALID, SYMBOL_INVALID };
+
+    /** Array allocated from store arena */
+    template <typename T> using Array = std::vector<T, ArenaAllocator<T> >;
+
+
+protected:
+    /** Hash of interned strings */
+    struct SymbolHash {
+        size_t operator()(const char *value) const;
+    };
+
+    /** Equality of interned strings */
+    struct SymbolEqual {
+        bool operator()(const char *a, const char *b) const {
+            return strcmp(a, b) == 0;
+        }
+    };
+
+    /** Memory of entry arrays and interned strings */
+    Arena arena;
+
+    /** Coordinate system of entries */
+    Array<unsigned char> systems;
+
+    /** Top-left / north-west point of entries */
+    Array<cv::Point2d> p1s;
+
+    /** Bottom-right / south-east point of entries */
+    Array<cv::Point2d> p2s;
+
+    /** Class name of entries */
+    Array<Symbol> classNames;
+
+    /** False positive status of entries */
+    Array<Symbol> falsePositives;
+
+    /** Automatic detection status of entries */
+    Array<Symbol> autoStatuses;
+
+    /** Manual validation status of entries */
+    Array<Symbol> manualStatuses;
+
+    /** First child entry of entries */
+    Array<unsigned int> childBegins;
+
+    /** Number of children of entries */
+    Array<unsigned int> childCounts;
+
+    /** Top-level entries */
+    Array<unsigned int> roots;
+
+    /** Top-level objects listed as invalid objects */
+    Array<unsigned char> invalids;
+
+    /** Source image filename */
+    std::string source;
+
+    /** Interned strings */
+    Array<const char*> symbols;
+
+    /** Symbol of interned strings */
+    std::unordered_map<const char*, Symbol, SymbolHash, SymbolEqual, ArenaAllocator<std::pair<const char* const, Symbol> > > symbolIds;
+
+
+    /**
+     * Append blank entries.
+     *
+     * \param count number of entries
+     * \return index of first entry
+     */
+    unsigned int allocate(unsigned int count);
+
+    /**
+     * Fill entry (and its children) from detected object.
+     *
+     * \param entry entry index
+     * \param object detected object
+     */
+    void set(unsigned int entry, const DetectedObject &object);
+
+    /**
+     * Fill entry (and its children) from storage node.
+     *
+     * \param entry entry index
+     * \param node storage node to read from
+     */
+    void set(unsigned int entry, const cv::FileNode &node);
+
+    /**
+     * Write entry (and its children) to storage.
+     *
+     * \param fs storage to write to
+     * \param entry entry index
+     */
+    void writeEntry(cv::FileStorage &fs, unsigned int entry) const;
+
+    /**
+     * Merge overlapping entries (see ObjectDetector::merge) into a range of
+     * new entries, allocated before their own (merged) children.
+     *
+     * \param entries entries to merge
+     * \param minOverlap minimum number of entries (with descendants) merged into a kept entry
+     * \param first output first merged entry
+     * \param count output number of merged entries
+     */
+    void mergeEntries(const std::vector<unsigned int> &entries, int minOverlap, unsigned int &first, unsigned int &count);
+
+    /**
+     * Count descendants of entry.
+     *
+     * \param entry entry index
+     * \return number of entries below entry
+     */
+    unsigned int descendants(unsigned int entry) const;
+
+    /**
+     * Join distinct symbols as merged objects do (sorted strings separated
+     * by ':').
+     *
+     * \param symbols symbols to join (sorted and made unique)
+     * \return symbol of joined string
+     */
+    Symbol join(std::vector<Symbol> &symbols);
+
+    /**
+     * Append objects from binary detection file.
+     *
+     * \param file binary detection filename
+     * \return true on success, false otherwise
+     */
+    bool loadBinary(const std::string &file);
+
+    /**
+     * Write objects to binary detection file.
+     *
+     * \param file binary detection filename
+     * \return true on success, false otherwise
+     */
+    bool saveBinary(const std::string &file) const;
+
+
+public:
+    /**
+     * Empty constructor.
+     */
+    DetectionStore();
+
+    /**
+     * Adapter constructor.
+     *
+     * \param objects detected objects to store
+     */
+    DetectionStore(const std::list<DetectedObject> &objects);
+
+
+    /**
+     * Get number of top-level objects.
+     *
+     * \return number of objects
+     */
+    unsigned int size() const {
+        return this->roots.size();
+    }
+
+    /**
+     * Get number of entries (objects and their children).
+     *
+     * \return number of entries
+     */
+    unsigned int entries() const {
+        return this->systems.size();
+    }
+
+    /**
+     * Get entry of top-level object.
+     *
+     * \param index object index
+     * \return entry index
+     */
+    unsigned int root(unsigned int index) const {
+        return this->roots[index];
+    }
+
+    /**
+     * Check if top-level object is listed as invalid object.
+     *
+     * \param index object index
+     * \return true if invalid object
+     */
+    bool isInvalid(unsigned int index) const {
+        return this->invalids[index] != 0;
+    }
+
+    /**
+     * Get source image filename.
+     *
+     * \return source filename (empty if unknown)
+     */
+    const std::string& sourceFile() const {
+        return this->source;
+    }
+
+    /**
+     * Set source image filename.
+     *
+     * \param source source filename
+     */
+    void setSourceFile(const std::string &source) {
+        this->source = source;
+    }
+
+    /**
+     * Remove all objects and release their memory at once (arena blocks
+     * are kept for the next objects).
+     */
+    void clear();
+
+    /**
+     * Reserve memory for entries.
+     *
+     * \param count number of entries
+     */
+    void reserve(unsigned int count);
+
+
+    /**
+     * Intern string.
+     *
+     * \param value string value
+     * \return symbol of string
+     */
+    Symbol intern(const std::string &value);
+
+    /**
+     * Get interned string.
+     *
+     * \param symbol symbol of string
+     * \return string value
+     */
+    const char* symbol(Symbol symbol) const {
+        return this->symbols[symbol];
+    }
+
+    /**
+     * Get number of interned strings.
+     *
+     * \return number of symbols
+     */
+    unsigned int symbolCount() const {
+        return this->symbols.size();
+    }
+
+
+    /**
+     * Get bounding area of entry.
+     *
+     * \param entry entry index
+     * \return bounding area
+     */
+    BoundingBox area(unsigned int entry) const {
+        return BoundingBox((BoundingBox::CoordinateSystem)this->systems[entry], this->p1s[entry], this->p2s[entry]);
+    }
+
+    /**
+     * Set bounding area of entry.
+     *
+     * \param entry entry index
+     * \param area bounding area
+     */
+    void setArea(unsigned int entry, const BoundingBox &area);
+
+    /**
+     * Get class name of entry.
+     *
+     * \param entry entry index
+     * \return class name symbol
+     */
+    Symbol className(unsigned int entry) const {
+        return this->classNames[entry];
+    }
+
+    /**
+     * Get false positive status of entry.
+     *
+     * \param entry entry index
+     * \return status symbol
+     */
+    Symbol falsePositive(unsigned int entry) const {
+        return this->falsePositives[entry];
+    }
+
+    /**
+     * Get automatic detection status of entry.
+     *
+     * \param entry entry index
+     * \return status symbol
+     */
+    Symbol autoStatus(unsigned int entry) const {
+        return this->autoStatuses[entry];
+    }
+
+    /**
+     * Get manual validation status of entry.
+     *
+     * \param entry entry index
+     * \return status symbol
+     */
+    Symbol manualStatus(unsigned int entry) const {
+        return this->manualStatuses[entry];
+    }
+
+    /**
+     * Set statuses of entry.
+     *
+     * \param entry entry index
+     * \param falsePositive false positive status symbol
+     * \param autoStatus automatic detection status symbol
+     * \param manualStatus manual validation status symbol
+     */
+    void setStatus(unsigned int entry, Symbol falsePositive, Symbol autoStatus, Symbol manualStatus);
+
+    /**
+     * Check if entry is marked as false positive.
+     *
+     * \param entry entry index
+     * \return true if false positive
+     */
+    bool isFalsePositive(unsigned int entry) const {
+        return this->falsePositives[entry] == SYMBOL_YES;
+    }
+
+    /**
+     * Get first child entry of entry.
+     *
+     * \param entry entry index
+     * \return first child entry index
+     */
+    unsigned int childBegin(unsigned int entry) const {
+        return this->childBegins[entry];
+    }
+
+    /**
+     * Get end of children entries of entry.
+     *
+     * \param entry entry index
+     * \return index after last child entry
+     */
+    unsigned int childEnd(unsigned int entry) const {
+        return this->childBegins[entry] + this->childCounts[entry];
+    }
+
+
+    /**
+     * Append top-level object (and its children).
+     *
+     * \param object detected object
+     * \param invalid list object as invalid object
+     * \return entry index of object
+     */
+    unsigned int add(const DetectedObject &object, bool invalid = false);
+
+    /**
+     * Replace stored objects.
+     *
+     * \param objects detected objects
+     */
+    void assign(const std::list<DetectedObject> &objects);
+
+    /**
+     * Keep only top-level objects accepted by predicate. Entries of
+     * removed objects are released by clear() only.
+     *
+     * \param keep predicate called with entry index of each object
+     */
+    void filter(const std::function<bool(unsigned int)> &keep);
+
+    /**
+     * Merge overlapping top-level objects (and their children) in place,
+     * with the same result as ObjectDetector::merge. Entries of merged
+     * objects are released by clear() only.
+     *
+     * \param minOverlap minimum number of objects merged into a kept object
+     */
+    void merge(int minOverlap = 1);
+
+    /**
+     * Convert entry to detected object.
+     *
+     * \param entry entry index
+     * \return detected object (with its children)
+     */
+    DetectedObject object(unsigned int entry) const;
+
+    /**
+     * Convert top-level objects to list.
+     *
+     * \param objects output list of detected objects (appended)
+     */
+    void toList(std::list<DetectedObject> &objects) const;
+
+
+    /**
+     * Append objects from yaml or binary detection file (valid and invalid
+     * objects).
+     *
+     * \param file yaml or binary detection filename
+     * \return true on success, false otherwise
+     */
+    bool load(const std::string &file);
+
+    /**
+     * Write objects to file, in binary format if filename ends with '.ydb'
+     * and in yaml otherwise.
+     *
+     * \param file target filename
+     * \return true on success, false otherwise
+     */
+    bool save(const std::string &file) const;
+
+    /**
+     * Write top-level objects to storage as a sequence.
+     *
+     * \param fs storage to write to
+     */
+    void write(cv::FileStorage &fs) const;
+
+    /**
+     * Write top-level objects of one list to storage as a sequence.
+     *
+     * \param fs storage to write to
+     * \param invalid write invalid objects instead of objects
+     */
+    void write(cv::FileStorage &fs, bool invalid) const;
+
+
+private:
+    DetectionStore(const DetectionStore &);
+    DetectionStore& operator=(const DetectionStore &);
+};
+
+
+#endif //__YAFDB_DETECTORS_STORE_H_INCLUDE__
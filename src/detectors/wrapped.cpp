@@ -0,0 +1,87 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#include "wrapped.hpp"
+
+
+WrappedEqr::WrappedEqr(const cv::Mat &source, int margin) {
+    margin = MIN(MAX(margin, 0), source.cols);
+    if (margin > 0) {
+        cv::copyMakeBorder(source, this->buffer, 0, 0, 0, margin, cv::BORDER_WRAP);
+    } else {
+        this->buffer = source;
+    }
+    this->eqr = cv::Mat(this->buffer, cv::Rect(0, 0, source.cols, source.rows));
+}
+
+WrappedEqr::WrappedEqr(int rows, int cols, int type, int margin) {
+    margin = MIN(MAX(margin, 0), cols);
+    this->buffer.create(rows, cols + margin, type);
+    this->eqr = cv::Mat(this->buffer, cv::Rect(0, 0, cols, rows));
+}
+
+void WrappedEqr::written(const cv::Rect &area) {
+    cv::Rect rect(area & cv::Rect(0, 0, this->buffer.cols, this->buffer.rows));
+    int width = this->eqr.cols;
+    int margin = this->margin();
+
+    if (margin <= 0 || rect.width <= 0 || rect.height <= 0) {
+        return;
+    }
+
+    // columns written past the seam go back to the image start
+    if (rect.x + rect.width > width) {
+        int x = MAX(rect.x, width);
+        cv::Mat target(this->buffer, cv::Rect(x - width, rect.y, rect.x + rect.width - x, rect.height));
+
+        cv::Mat(this->buffer, cv::Rect(x, rect.y, target.cols, rect.height)).copyTo(target);
+    }
+
+    // columns written at the image start are duplicated past the seam
+    if (rect.x < margin) {
+        int x2 = MIN(rect.x + rect.width, margin);
+        cv::Mat target(this->buffer, cv::Rect(rect.x + width, rect.y, x2 - rect.x, rect.height));
+
+        cv::Mat(this->buffer, cv::Rect(rect.x, rect.y, target.cols, rect.height)).copyTo(target);
+    }
+}
+
+int WrappedEqr::marginFor(const cv::Rect &rect, int width, int border) {
+    return MAX(rect.x + rect.width + border - width, 0);
+}
@@ -0,0 +1,154 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#ifndef __YAFDB_DETECTORS_WRAPPED_H_INCLUDE__
+#define __YAFDB_DETECTORS_WRAPPED_H_INCLUDE__
+
+
+#include <opencv2/opencv.hpp>
+
+
+/**
+ * Eqr image padded on its right side with a copy of its first columns, so
+ * that areas crossing the 0/2pi seam are contiguous views of the buffer.
+ *
+ * The padded buffer can be allocated first and the eqr image decoded
+ * straight into its view, so that only the margin columns are copied.
+ * Pixels written through a view must be propagated to their duplicate
+ * with written() before being read again through the other copy.
+ *
+ */
+class WrappedEqr {
+protected:
+    /** Padded buffer (source width + margin columns) */
+    cv::Mat buffer;
+
+    /** View of the eqr image in padded buffer */
+    cv::Mat eqr;
+
+
+public:
+    /**
+     * Default constructor. Source is copied only if margin is not empty.
+     *
+     * \param source eqr image
+     * \param margin number of columns duplicated past the seam
+     */
+    WrappedEqr(const cv::Mat &source, int margin);
+
+    /**
+     * Allocate padded buffer. The eqr image must be written in image() and
+     * its first columns duplicated with wrap() before use.
+     *
+     * \param rows eqr image height
+     * \param cols eqr image width
+     * \param type eqr image type
+     * \param margin number of columns duplicated past the seam
+     */
+    WrappedEqr(int rows, int cols, int type, int margin);
+
+
+    /**
+     * Get eqr image (view of the padded buffer).
+     *
+     * \return eqr image
+     */
+    const cv::Mat& image() const {
+        return this->eqr;
+    }
+
+    /**
+     * Get padded buffer.
+     *
+     * \return padded buffer
+     */
+    const cv::Mat& padded() const {
+        return this->buffer;
+    }
+
+    /**
+     * Get number of columns duplicated past the seam.
+     *
+     * \return margin in pixels
+     */
+    int margin() const {
+        return this->buffer.cols - this->eqr.cols;
+    }
+
+    /**
+     * Check if rectangle (in padded coordinates) is a valid view.
+     *
+     * \param rect rectangle in padded buffer
+     * \return true if rectangle fits in padded buffer
+     */
+    bool contains(const cv::Rect &rect) const {
+        return rect.x >= 0 && rect.y >= 0 && rect.x + rect.width <= this->buffer.cols && rect.y + rect.height <= this->buffer.rows;
+    }
+
+    /**
+     * Propagate pixels written in rectangle (in padded coordinates) to
+     * their duplicate columns.
+     *
+     * \param rect modified rectangle in padded buffer
+     */
+    void written(const cv::Rect &rect);
+
+    /**
+     * Duplicate first columns of eqr image past the seam (after the whole
+     * image is written).
+     *
+     */
+    void wrap() {
+        this->written(cv::Rect(0, 0, this->margin(), this->eqr.rows));
+    }
+
+
+    /**
+     * Compute margin needed to view a rectangle as a contiguous area.
+     *
+     * \param rect rectangle in eqr image (may extend past its right side)
+     * \param width eqr image width
+     * \param border extra border size around rectangle
+     * \return needed margin in pixels
+     */
+    static int marginFor(const cv::Rect &rect, int width, int border = 0);
+};
+
+
+#endif //__YAFDB_DETECTORS_WRAPPED_H_INCLUDE__
@@ -0,0 +1,218 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "writer.hpp"
+
+
+DetectionWriter::DetectionWriter() : fp(NULL), format(YAML), count(0) {
+}
+
+DetectionWriter::~DetectionWriter() {
+    if (this->fp && this->fp != stdout) {
+        fclose(this->fp);
+    }
+}
+
+bool DetectionWriter::open(const std::string &file, Format format, const std::string &source) {
+    this->fp = file == "-" ? stdout : fopen(file.c_str(), "w");
+    this->format = format;
+    this->count = 0;
+    if (!this->fp) {
+        return false;
+    }
+    if (this->format == YAML) {
+        fputs("%YAML:1.0\n", this->fp);
+        if (!source.empty()) {
+            fputs("source: ", this->fp);
+            this->writeString(source);
+            fputs("\n", this->fp);
+        }
+    }
+    return fflush(this->fp) == 0;
+}
+
+void DetectionWriter::writeString(const std::string &value) {
+    // double-quoted in both formats, escaping quotes and control characters
+    fputc('"', this->fp);
+    for (auto it = value.begin(); it != value.end(); ++it) {
+        unsigned char c = *it;
+
+        if (c == '"' || c == '\\') {
+            fputc('\\', this->fp);
+            fputc(c, this->fp);
+        } else if (c < 0x20) {
+            fprintf(this->fp, this->format == YAML ? "\\x%02x" : "\\u%04x", c);
+        } else {
+            fputc(c, this->fp);
+        }
+    }
+    fputc('"', this->fp);
+}
+
+void DetectionWriter::writeNumber(double value) {
+    if (isnan(value)) {
+        fputs(this->format == YAML ? ".Nan" : "null", this->fp);
+    } else if (isinf(value)) {
+        fputs(this->format == YAML ? (value > 0 ? ".Inf" : "-.Inf") : "null", this->fp);
+    } else {
+        fprintf(this->fp, "%.17g", value);
+    }
+}
+
+void DetectionWriter::writeYaml(const DetectedObject &object, int indent) {
+    std::string item(indent, ' ');
+    std::string field(indent + 3, ' ');
+
+    fprintf(this->fp, "%s-\n", item.c_str());
+    fprintf(this->fp, "%sclassName: ", field.c_str());
+    this->writeString(object.className);
+    fprintf(this->fp, "\n%sarea:\n", field.c_str());
+    fprintf(this->fp, "%s   system: %d\n", field.c_str(), (int)object.area.system);
+    fprintf(this->fp, "%s   p1: [ ", field.c_str());
+    this->writeNumber(object.area.p1.x);
+    fputs(", ", this->fp);
+    this->writeNumber(object.area.p1.y);
+    fprintf(this->fp, " ]\n%s   p2: [ ", field.c_str());
+    this->writeNumber(object.area.p2.x);
+    fputs(", ", this->fp);
+    this->writeNumber(object.area.p2.y);
+    fprintf(this->fp, " ]\n%sfalsePositive: ", field.c_str());
+    this->writeString(object.falsePositive.length() > 0 ? object.falsePositive : "No");
+    fprintf(this->fp, "\n%sautoStatus: ", field.c_str());
+    this->writeString(object.autoStatus.length() > 0 ? object.autoStatus : "None");
+    fprintf(this->fp, "\n%smanualStatus: ", field.c_str());
+    this->writeString(object.manualStatus.length() > 0 ? object.manualStatus : "None");
+    fputs("\n", this->fp);
+    if (!object.children.empty()) {
+        fprintf(this->fp, "%schildren:\n", field.c_str());
+        for (auto it = object.children.begin(); it != object.children.end(); ++it) {
+            this->writeYaml(*it, indent + 6);
+        }
+    }
+}
+
+void DetectionWriter::writeJson(const DetectedObject &object) {
+    fputs("{\"className\":", this->fp);
+    this->writeString(object.className);
+    fprintf(this->fp, ",\"area\":{\"system\":%d,\"p1\":[", (int)object.area.system);
+    this->writeNumber(object.area.p1.x);
+    fputs(",", this->fp);
+    this->writeNumber(object.area.p1.y);
+    fputs("],\"p2\":[", this->fp);
+    this->writeNumber(object.area.p2.x);
+    fputs(",", this->fp);
+    this->writeNumber(object.area.p2.y);
+    fputs("]},\"falsePositive\":", this->fp);
+    this->writeString(object.falsePositive.length() > 0 ? object.falsePositive : "No");
+    fputs(",\"autoStatus\":", this->fp);
+    this->writeString(object.autoStatus.length() > 0 ? object.autoStatus : "None");
+    fputs(",\"manualStatus\":", this->fp);
+    this->writeString(object.manualStatus.length() > 0 ? object.manualStatus : "None");
+    if (!object.children.empty()) {
+        fputs(",\"children\":[", this->fp);
+        for (auto it = object.children.begin(); it != object.children.end(); ++it) {
+            if (it != object.children.begin()) {
+                fputs(",", this->fp);
+            }
+            this->writeJson(*it);
+        }
+        fputs("]", this->fp);
+    }
+    fputs("}", this->fp);
+}
+
+bool DetectionWriter::write(const DetectedObject &object) {
+    if (!this->fp) {
+        return true;
+    }
+    if (this->format == YAML) {
+        if (this->count == 0) {
+            fputs("objects:\n", this->fp);
+        }
+        this->writeYaml(object, 3);
+    } else {
+        this->writeJson(object);
+        fputs("\n", this->fp);
+    }
+    this->count++;
+    return fflush(this->fp) == 0 && !ferror(this->fp);
+}
+
+bool DetectionWriter::write(const std::list<DetectedObject> &objects) {
+    return std::all_of(objects.begin(), objects.end(), [&] (const DetectedObject &object) {
+        return this->write(object);
+    });
+}
+
+bool DetectionWriter::close(const std::string &trailer) {
+    if (!this->fp) {
+        return false;
+    }
+    if (this->format == YAML) {
+        if (this->count == 0) {
+            fputs("objects: []\n", this->fp);
+        }
+        fputs(trailer.c_str(), this->fp);
+    }
+
+    bool success = fflush(this->fp) == 0 && !ferror(this->fp);
+
+    if (this->fp != stdout && fclose(this->fp) != 0) {
+        success = false;
+    }
+    this->fp = NULL;
+    return success;
+}
+
+std::string DetectionWriter::trailer(cv::FileStorage &fs) {
+    std::string content(fs.releaseAndGetString());
+
+    // drop yaml directive, entries are appended to an open document
+    if (content.compare(0, 1, "%") == 0) {
+        size_t end = content.find('\n');
+
+        content = end == std::string::npos ? std::string() : content.substr(end + 1);
+    }
+    return content;
+}
@@ -0,0 +1,179 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#ifndef __YAFDB_DETECTORS_WRITER_H_INCLUDE__
+#define __YAFDB_DETECTORS_WRITER_H_INCLUDE__
+
+
+#include <stdio.h>
+
+#include <list>
+#include <string>
+
+#include "detector.hpp"
+
+
+/**
+ * Streaming writer of detected objects. Each object is written and flushed
+ * as soon as it is given, so that consumers can read results while
+ * detection is running and a crash keeps what was already written.
+ *
+ * Yaml output stays readable by cv::FileStorage (and ObjectDetector::load).
+ * NDJSON output holds one json object per line.
+ *
+ */
+class DetectionWriter {
+public:
+    /** Output formats */
+    enum Format { YAML = 1, NDJSON };
+
+
+protected:
+    /** Output stream */
+    FILE *fp;
+
+    /** Output format */
+    Format format;
+
+    /** Number of objects written */
+    int count;
+
+
+    /**
+     * Write yaml string scalar.
+     *
+     * \param value string value
+     */
+    void writeString(const std::string &value);
+
+    /**
+     * Write number scalar.
+     *
+     * \param value number value
+     */
+    void writeNumber(double value);
+
+    /**
+     * Write detected object in yaml block style.
+     *
+     * \param object detected object
+     * \param indent indentation of sequence item
+     */
+    void writeYaml(const DetectedObject &object, int indent);
+
+    /**
+     * Write detected object as json object.
+     *
+     * \param object detected object
+     */
+    void writeJson(const DetectedObject &object);
+
+
+public:
+    /**
+     * Empty constructor.
+     */
+    DetectionWriter();
+
+    /**
+     * Destructor (closes output without trailer).
+     */
+    ~DetectionWriter();
+
+
+    /**
+     * Open output.
+     *
+     * \param file output filename ('-' for standard output)
+     * \param format output format
+     * \param source source image filename (yaml only, omitted if empty)
+     * \return true on success, false otherwise
+     */
+    bool open(const std::string &file, Format format, const std::string &source = std::string());
+
+    /**
+     * Check if output is open.
+     *
+     * \return true if open
+     */
+    bool isOpened() const {
+        return this->fp != NULL;
+    }
+
+    /**
+     * Write and flush detected object (no-op if output is not open).
+     *
+     * \param object detected object
+     * \return true on success, false otherwise
+     */
+    bool write(const DetectedObject &object);
+
+    /**
+     * Write and flush detected objects (no-op if output is not open).
+     *
+     * \param objects detected objects
+     * \return true on success, false otherwise
+     */
+    bool write(const std::list<DetectedObject> &objects);
+
+    /**
+     * Terminate and close output.
+     *
+     * \param trailer extra top-level yaml entries appended after objects
+     * \return true on success, false otherwise
+     */
+    bool close(const std::string &trailer = std::string());
+
+
+    /**
+     * Convert storage content to yaml entries suitable as trailer.
+     *
+     * \param fs memory storage opened for writing ('.yml', WRITE + MEMORY)
+     * \return top-level yaml entries
+     */
+    static std::string trailer(cv::FileStorage &fs);
+
+
+private:
+    DetectionWriter(const DetectionWriter &);
+    DetectionWriter& operator=(const DetectionWriter &);
+};
+
+
+#endif //__YAFDB_DETECTORS_WRITER_H_INCLUDE__
@@ -47,6 +47,7 @@
 #include <sys/stat.h>
 
 #include "detectors/detector.hpp"
+#include "detectors/reader.hpp"
 
 
 /*
@@ -164,7 +165,7 @@ int main(int argc, char **argv) {
     }
 
     // read source file
-    cv::Mat source = cv::imread(source_file);
+    cv::Mat source = ImageReader::read(source_file);
 
     if (source.rows <= 0 || source.cols <= 0) {
         fprintf(stderr, "Error: cannot read image in source file: %s\n", source_file);
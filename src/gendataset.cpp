@@ -56,6 +56,8 @@
 
 #include <opencv2/opencv.hpp>
 
+#include "detectors/reader.hpp"
+
 
 /*
  * Program arguments.
@@ -117,7 +119,7 @@ static bool parseFiles(const std::string &input, std::vector<std::string> &outpu
                 return false;
             }
 
-            cv::Mat image = cv::imread(path);
+            cv::Mat image = ImageReader::read(path);
 
             if (image.rows > 0 && image.cols > 0) {
                 output.push_back(path);
@@ -321,7 +323,7 @@ int main(int argc, char **argv) {
 
         // read sample image
         auto const &sample_file(samples[idx % samples.size()]);
-        cv::Mat sample = cv::imread(sample_file);
+        cv::Mat sample = ImageReader::read(sample_file);
         double sampleRatio = (double)sample.cols / (double)sample.rows;
         double outputRatio = (double)sample_width / (double)sample_height;
 
@@ -465,7 +467,7 @@ int main(int argc, char **argv) {
 
             if (backgrounds.size() > 0) {
                 auto const &background_file(backgrounds[i % backgrounds.size()]);
-                cv::Mat background = cv::imread(background_file);
+                cv::Mat background = ImageReader::read(background_file);
 
                 // normalize background image
                 if (background.channels() != 1) {
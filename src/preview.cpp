@@ -46,6 +46,8 @@
 #include <getopt.h>
 
 #include "detectors/detector.hpp"
+#include "detectors/reader.hpp"
+#include "detectors/store.hpp"
 
 
 /*
@@ -143,7 +145,7 @@ int main(int argc, char **argv) {
     }
 
     // read source file
-    cv::Mat source = cv::imread(source_file);
+    cv::Mat source = ImageReader::read(source_file);
 
     if (source.rows <= 0 || source.cols <= 0) {
         fprintf(stderr, "Error: cannot read image in source file: %s\n", source_file);
@@ -151,16 +153,16 @@ int main(int argc, char **argv) {
     }
 
     // read detected objects
-    std::list<DetectedObject> objects;
+    DetectionStore objects;
 
-    if (!ObjectDetector::load(objects_file, objects)) {
+    if (!objects.load(objects_file)) {
         fprintf(stderr, "Error: cannot read objects in file: %s\n", objects_file);
         return 2;
     }
 
     // merge detected objects
     if (merge_enabled) {
-        ObjectDetector::merge(objects, merge_min_overlap);
+        objects.merge(merge_min_overlap);
     }
 
     // draw detected objects
@@ -173,28 +175,27 @@ int main(int argc, char **argv) {
         cv::Scalar(0, 255, 0),
         cv::Scalar(255, 0, 0)
     };
-    std::function<void(const DetectedObject&, int)> drawObjectWithDepth = [&] (const DetectedObject &object, int depth) {
-        std::vector<cv::Rect> rects = object.area.rects(source.cols, source.rows);
+    std::function<void(unsigned int, int)> drawObjectWithDepth = [&] (unsigned int entry, int depth) {
+        std::vector<cv::Rect> rects = objects.area(entry).rects(source.cols, source.rows);
 
         for (auto it = rects.begin(); it != rects.end(); ++it) {
-            putText(source, object.className, (*it).tl(), CV_FONT_HERSHEY_SIMPLEX, 3, cv::Scalar(255, 255, 255), 3);
+            putText(source, objects.symbol(objects.className(entry)), (*it).tl(), CV_FONT_HERSHEY_SIMPLEX, 3, cv::Scalar(255, 255, 255), 3);
 
-            if(object.falsePositive == "Yes")
+            if(objects.isFalsePositive(entry))
             {
                 rectangle(source, *it, colors[3], borderSize);
             } else {
                 rectangle(source, *it, colors[depth], borderSize);
             }
         }
-        for (auto it = object.children.begin(); it != object.children.end(); ++it) {
-            drawObjectWithDepth(*it, MAX(depth + 1, 5));
+        for (unsigned int child = objects.childBegin(entry); child < objects.childEnd(entry); child++) {
+            drawObjectWithDepth(child, MAX(depth + 1, 5));
         }
     };
-    auto drawObject = [&] (const DetectedObject &object) {
-        drawObjectWithDepth(object, 0);
-    };
 
-    std::for_each(objects.begin(), objects.end(), drawObject);
+    for (unsigned int i = 0; i < objects.size(); i++) {
+        drawObjectWithDepth(objects.root(i), 0);
+    }
 
     if (export_file != NULL) {
         cv::imwrite(export_file, source);
@@ -0,0 +1,230 @@
+/*
+ * yafdb - Yet Another Face Detection and Bluring
+ *
+ * Copyright (c) 2014 FOXEL SA - http://foxel.ch
+ * Please read <http://foxel.ch/license> for more information.
+ *
+ *
+ * Author(s):
+ *
+ *      Antony Ducommun <nitro@tmsrv.org>
+ *
+ *
+ * This file is part of the FOXEL project <http://foxel.ch>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Additional Terms:
+ *
+ *      You are required to preserve legal notices and author attributions in
+ *      that material or in the Appropriate Legal Notices displayed by works
+ *      containing it.
+ *
+ *      You are required to attribute the work as explained in the "Usage and
+ *      Attribution" section of <http://foxel.ch/license>.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <sstream>
+
+#include "detectors/detector.hpp"
+#include "detectors/prior.hpp"
+
+
+/*
+ * Program arguments.
+ *
+ */
+
+#define OPTION_GNOMONIC_APERTURE_X    0
+#define OPTION_GNOMONIC_APERTURE_Y    1
+#define OPTION_UPDATE                 2
+#define OPTION_GNOMONIC_BAND          3
+
+
+static double gnomonic_aperture_x = 60.0 / 180.0 * M_PI;
+static double gnomonic_aperture_y = 60.0 / 180.0 * M_PI;
+static std::vector<cv::Point2d> gnomonic_bands;
+static int update = 0;
+static const char *prior_file = NULL;
+
+
+static struct option options[] = {
+    {"gnomonic-aperture-x",  required_argument, 0,                  0 },
+    {"gnomonic-aperture-y",  required_argument, 0,                  0 },
+    {"update",               no_argument,       &update,            1 },
+    {"gnomonic-band",        required_argument, 0,                  0 },
+    {0, 0, 0, 0}
+};
+
+
+/**
+ * Display program usage.
+ *
+ */
+void usage() {
+    printf("yafdb-prior output-prior.yaml input-objects.yaml [input-objects.yaml ...]\n\n");
+
+    printf("Aggregate detected or validated objects of many images into a per-tile\n");
+    printf("hit-rate map of the gnomonic scan grid (see yafdb-detect --prior).\n\n");
+
+    printf("General options:\n\n");
+    printf("--gnomonic-aperture-x 60 : horizontal projection aperture of the scan grid\n");
+    printf("--gnomonic-aperture-y 60 : vertical projection aperture of the scan grid\n");
+    printf("--gnomonic-band width:apertureX:apertureY[:minSize:maxSize] : scan grid of a yafdb-detect scale band (allowed multiple times, replaces aperture, only apertures are used)\n");
+    printf("--update : accumulate into existing output prior\n");
+    printf("\n");
+}
+
+
+/**
+ * Program entry-point.
+ *
+ */
+int main(int argc, char **argv) {
+    // parse arguments
+    while (true) {
+        int index = -1;
+
+        getopt_long(argc, argv, "", options, &index);
+        if (index == -1) {
+            if (argc < optind + 2) {
+                usage();
+                return 1;
+            }
+
+            prior_file = argv[optind++];
+            if (access(prior_file, W_OK) && errno == EACCES) {
+                fprintf(stderr, "Error: prior file not writable: %s\n", prior_file);
+                return 2;
+            }
+            break;
+        }
+
+        switch (index) {
+        case OPTION_GNOMONIC_APERTURE_X:
+            gnomonic_aperture_x = atof(optarg) / 180.0 * M_PI;
+            break;
+
+        case OPTION_GNOMONIC_APERTURE_Y:
+            gnomonic_aperture_y = atof(optarg) / 180.0 * M_PI;
+            break;
+
+        case OPTION_UPDATE:
+            break;
+
+        case OPTION_GNOMONIC_BAND:
+        {
+            std::stringstream stream(optarg);
+            std::vector<std::string> items;
+
+            for (std::string item; std::getline(stream, item, ':'); ) {
+                items.push_back(item);
+            }
+            if ((items.size() != 3 && items.size() != 5) || atof(items[1].c_str()) <= 0 || atof(items[2].c_str()) <= 0) {
+                fprintf(stderr, "Error: invalid gnomonic band given: %s\n", optarg);
+                return 2;
+            }
+            gnomonic_bands.push_back(cv::Point2d(atof(items[1].c_str()) / 180.0 * M_PI, atof(items[2].c_str()) / 180.0 * M_PI));
+        }
+        break;
+
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    // one prior per scan grid (bands sharing apertures share their grid)
+    std::vector<std::shared_ptr<TilePrior>> priors;
+
+    if (gnomonic_bands.empty()) {
+        gnomonic_bands.push_back(cv::Point2d(gnomonic_aperture_x, gnomonic_aperture_y));
+    }
+    std::for_each(gnomonic_bands.begin(), gnomonic_bands.end(), [&] (const cv::Point2d &aperture) {
+        bool known = std::any_of(priors.begin(), priors.end(), [&] (const std::shared_ptr<TilePrior> &prior) {
+            return prior->matches(aperture.x, aperture.y);
+        });
+
+        if (!known) {
+            priors.push_back(std::shared_ptr<TilePrior>(new TilePrior(aperture.x, aperture.y)));
+        }
+    });
+
+    // read existing prior (its scan grids must match)
+    if (update && !access(prior_file, R_OK)) {
+        std::vector<std::shared_ptr<TilePrior>> existing;
+
+        if (!TilePrior::load(prior_file, existing)) {
+            fprintf(stderr, "Error: cannot read tile prior in file: %s\n", prior_file);
+            return 2;
+        }
+        for (auto prior = priors.begin(); prior != priors.end(); ++prior) {
+            auto match = std::find_if(existing.begin(), existing.end(), [&] (const std::shared_ptr<TilePrior> &other) {
+                return other->matches((*prior)->apertureX(), (*prior)->apertureY());
+            });
+
+            if (match == existing.end() || existing.size() != priors.size()) {
+                fprintf(stderr, "Error: tile prior scan grids do not match given apertures: %s\n", prior_file);
+                return 2;
+            }
+            *prior = *match;
+        }
+    }
+
+    // aggregate detected objects (one store reused for all images)
+    DetectionStore objects;
+
+    for (; optind < argc; optind++) {
+        const char *objects_file = argv[optind];
+
+        objects.clear();
+        if (!objects.load(objects_file)) {
+            fprintf(stderr, "Error: cannot read objects in file: %s\n", objects_file);
+            return 2;
+        }
+
+        // ignore false positives and filtered objects
+        objects.filter([&] (unsigned int entry) {
+            DetectionStore::Symbol autoStatus = objects.autoStatus(entry);
+
+            return !objects.isFalsePositive(entry) && strncmp(objects.symbol(autoStatus), "filtered", 8) != 0 && autoStatus != DetectionStore::SYMBOL_INVALID;
+        });
+
+        // tiles which were not scanned must not lower their hit-rate (each
+        // scan grid only accounts for its own skipped tiles)
+        cv::FileStorage fs(objects_file, cv::FileStorage::READ);
+
+        std::for_each(priors.begin(), priors.end(), [&] (const std::shared_ptr<TilePrior> &prior) {
+            std::vector<cv::Point2d> skipped;
+
+            TilePrior::readSkipped(fs["skipped_tiles"], prior->apertureX(), prior->apertureY(), skipped);
+            prior->add(objects, skipped);
+        });
+    }
+
+    // save prior
+    cv::FileStorage fs(prior_file, cv::FileStorage::WRITE);
+
+    TilePrior::save(fs, priors);
+    printf("images: %d\n", priors[0]->count());
+    return 0;
+}
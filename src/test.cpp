@@ -45,6 +45,8 @@
 #include <getopt.h>
 
 #include "detectors/detector.hpp"
+#include "detectors/reader.hpp"
+#include "detectors/store.hpp"
 
 
 /*
@@ -142,7 +144,7 @@ int main(int argc, char **argv) {
     }
 
     // read mask file
-    cv::Mat mask = cv::imread(mask_file);
+    cv::Mat mask = ImageReader::read(mask_file);
 
     if (mask.rows <= 0 || mask.cols <= 0) {
         fprintf(stderr, "Error: cannot read image in mask file: %s\n", mask_file);
@@ -156,28 +158,28 @@ int main(int argc, char **argv) {
     }
 
     // read detected objects
-    std::list<DetectedObject> objects;
+    DetectionStore objects;
 
-    if (!ObjectDetector::load(objects_file, objects)) {
+    if (!objects.load(objects_file)) {
         fprintf(stderr, "Error: cannot read objects in file: %s\n", objects_file);
         return 2;
     }
 
     // merge detected objects
     if (merge_enabled) {
-        ObjectDetector::merge(objects, merge_min_overlap);
+        objects.merge(merge_min_overlap);
     }
 
     // compute detected mask
     cv::Mat detected(mask.rows, mask.cols, CV_8UC1, cv::Scalar(0));
 
-    std::for_each(objects.begin(), objects.end(), [&] (const DetectedObject &object) {
-        auto rects = object.area.rects(mask.cols, mask.rows);
+    for (unsigned int i = 0; i < objects.size(); i++) {
+        auto rects = objects.area(objects.root(i)).rects(mask.cols, mask.rows);
 
         std::for_each(rects.begin(), rects.end(), [&] (const cv::Rect &rect) {
             rectangle(detected, rect, cv::Scalar(255), CV_FILLED);
         });
-    });
+    }
 
     // compute false positive mask (type I error)
     cv::Mat falsePositives(mask.rows, mask.cols, CV_8UC1);
@@ -217,7 +219,7 @@ int main(int argc, char **argv) {
         falseNegatives.release();
 
         // read source file
-        cv::Mat source = cv::imread(source_file);
+        cv::Mat source = ImageReader::read(source_file);
 
         if (source.rows != mask.rows || source.cols != mask.cols) {
             fprintf(stderr, "Error: cannot read image in source file or incompatible with mask size: %s\n", source_file);
@@ -47,6 +47,7 @@
 
 #include "detectors/detector.hpp"
 #include "detectors/gnomonic.hpp"
+#include "detectors/reader.hpp"
 
 
 /*
@@ -315,7 +316,7 @@ int main(int argc, char **argv) {
     }
 
     // read source file
-    cv::Mat source = cv::imread(source_file);
+    cv::Mat source = ImageReader::read(source_file);
 
     if (source.rows <= 0 || source.cols <= 0) {
         fprintf(stderr, "Error: cannot read image in source file: %s\n", source_file);
@@ -341,6 +342,7 @@ int main(int argc, char **argv) {
     // object editors
     int eqrWidth = image_width;
     int eqrHeight = eqrWidth * source.rows / source.cols;
+    EqrPyramid pyramid(source);
     std::list<DetectedObject> validObjects;
     std::list<DetectedObject> invalidObjects;
     std::list<DetectedObject> userObjects;
@@ -355,7 +357,7 @@ int main(int argc, char **argv) {
         cv::Rect rect;
 
         if (gnomonic_enabled) {
-            validationRegion = object.getGnomonicRegion(source, transform, rect, 1024, 4.0 * M_PI / 180.0);
+            validationRegion = object.getGnomonicRegion(pyramid, transform, rect, 1024, 4.0 * M_PI / 180.0);
         } else {
             validationRegion = object.getRegion(source, offset, rect, 200);
         }
@@ -490,7 +492,7 @@ int main(int argc, char **argv) {
         auto draw = [&] () {
             cv::Mat preview(eqrWidth, eqrHeight, source.type());
 
-            cv::resize(source, preview, cv::Size(eqrWidth, eqrHeight));
+            cv::resize(pyramid.level(pyramid.levelFor(2.0 * M_PI / eqrWidth)), preview, cv::Size(eqrWidth, eqrHeight));
 
             if(show_invalid_objects)
             {
@@ -685,12 +687,53 @@ int main(int argc, char **argv) {
 
         fs << "algorithm" << (std::string)fsr["algorithm"];
         if (fsr["gnomonic"].isMap()) {
+            cv::FileNode bands = fsr["gnomonic"]["bands"];
+
             fs << "gnomonic" << "{";
-            fs << "width" << (int)fsr["gnomonic"]["width"];
-            fs << "aperture_x" << (int)fsr["gnomonic"]["aperture_x"];
-            fs << "aperture_y" << (int)fsr["gnomonic"]["aperture_y"];
+            if (bands.isSeq()) {
+                fs << "bands" << "[";
+                for (auto it = bands.begin(); it != bands.end(); ++it) {
+                    fs << "{";
+                    fs << "width" << (int)(*it)["width"];
+                    fs << "aperture_x" << (double)(*it)["aperture_x"];
+                    fs << "aperture_y" << (double)(*it)["aperture_y"];
+                    fs << "min_size" << (int)(*it)["min_size"];
+                    fs << "max_size" << (int)(*it)["max_size"];
+                    fs << "}";
+                }
+                fs << "]";
+            } else {
+                fs << "width" << (int)fsr["gnomonic"]["width"];
+                fs << "aperture_x" << (double)fsr["gnomonic"]["aperture_x"];
+                fs << "aperture_y" << (double)fsr["gnomonic"]["aperture_y"];
+            }
             fs << "}";
         }
+        if (fsr["skipped_tiles"].isSeq()) {
+            cv::FileNode skippedNode = fsr["skipped_tiles"];
+
+            fs << "skipped_tiles" << "[";
+            for (auto it = skippedNode.begin(); it != skippedNode.end(); ++it) {
+                if ((*it).isMap()) {
+                    cv::FileNode tiles = (*it)["tiles"];
+
+                    fs << "{" << "aperture_x" << (double)(*it)["aperture_x"] << "aperture_y" << (double)(*it)["aperture_y"] << "tiles" << "[";
+                    for (auto tile = tiles.begin(); tile != tiles.end(); ++tile) {
+                        cv::Point2d center;
+
+                        (*tile) >> center;
+                        fs << center;
+                    }
+                    fs << "]" << "}";
+                } else {
+                    cv::Point2d center;
+
+                    (*it) >> center;
+                    fs << center;
+                }
+            }
+            fs << "]";
+        }
 
         writeObjects(fs, validObjects, userObjects, invalidObjects);
 